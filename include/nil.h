@@ -5,10 +5,17 @@
 #include "nilComponents.h"
 #include "nilException.h"
 #include "nilCommon.h"
+#include "nilRegistry.h"
+#include "nilVirtual.h"
+#include "nilCapture.h"
+#include "nilEvents.h"
+#include "nilHotkeys.h"
 
 #ifdef NIL_PLATFORM_WINDOWS
 # include "nilWindows.h"
 # include "nilWindowsPNP.h"
+#elif defined( NIL_PLATFORM_LINUX )
+# include "nilLinux.h"
 #endif
 
 namespace nil {
@@ -49,39 +56,60 @@ namespace nil {
     virtual void onControllerDisabled( Device* device, Controller* instance ) = 0;
   };
 
-#ifdef NIL_PLATFORM_WINDOWS
-
   //! \class System
   //! The Nil input system root.
   //! Create one to get started.
   //! \sa PnPListener
   //! \sa RawListener
-  class System: public windows::PnPListener, public windows::RawListener, public std::enable_shared_from_this<System> {
+  class System:
+#ifdef NIL_PLATFORM_WINDOWS
+  public windows::PnPListener, public windows::RawListener,
+#elif defined( NIL_PLATFORM_LINUX )
+  public posix::HotplugListener,
+#endif
+  public std::enable_shared_from_this<System> {
   friend class Device;
+  friend class DeviceInstance;
+  friend class VirtualDevice;
+  friend class CaptureReplay;
+  friend class Mouse;
+#ifdef NIL_PLATFORM_WINDOWS
   friend class DirectInputController;
   friend class RawInputKeyboard;
   friend class RawInputMouse;
   friend class RawInputController;
+#elif defined( NIL_PLATFORM_LINUX )
+  friend class EvdevMouse;
+  friend class EvdevKeyboard;
+  friend class EvdevController;
+  friend class HidrawController;
+#endif
   private:
     DeviceID idPool_ = 0; //!< Device indexing pool
     int mouseIdPool_ = 0; //!< Mouse indexing pool
     int keyboardIdPool_ = 0; //!< Keyboard indexing pool
     int controllerIdPool_ = 0; //!< Controller indexing pool
-    vector<DeviceID> xinputIds_; //!< XInput device ID mapping
+    DeviceRegistry devices_; //!< Known devices, indexed
+    bool initializing_ = true; //!< Are we initializing?
+    SystemListener* listener_; //!< Our single event listener
+    const Cooperation coop_; //!< Cooperation mode
+    unique_ptr<CaptureWriter> capture_; //!< Capture in progress, if any
+    unique_ptr<EventQueue> eventQueue_; //!< Event queue for polling, if enabled
+    EventSink eventSink_; //!< Event handler, if set
+    utf8String probeCachePath_; //!< Device probe cache file, if any
+#ifdef NIL_PLATFORM_WINDOWS
     set<uint32_t> specialHandlingDeviceIDs_; //!< Device VID/PID identifiers that will be ignored by DirectInput
     IDirectInput8W* dinput_ = nullptr; //!< Our DirectInput instance
     HINSTANCE instance_; //!< Host application instance handle
     HWND window_; //!< Host application window handle
     unique_ptr<windows::EventMonitor> eventMonitor_; //!< Our Plug-n-Play & raw input event monitor
-    DeviceList devices_; //!< List of known devices
     unique_ptr<windows::HIDManager> hidManager_; //!< Our HID manager
-    bool initializing_ = true; //!< Are we initializing?
+    windows::RefreshScheduler refreshScheduler_; //!< Device refreshes waiting for Plug-n-Play to settle
     RawMouseMap mouseMap_; //!< Raw mouse events mapping
     RawKeyboardMap keyboardMap_; //!< Raw keyboard events mapping
     RawControllerMap controllerMap_; //!< Raw controller events mapping
-    SystemListener* listener_; //!< Our single event listener
     unique_ptr<XInput> xinput_; //!< XInput module handler
-    const Cooperation coop_; //!< Cooperation mode
+    unique_ptr<XInputSampler> xinputSampler_; //!< XInput sampling thread, if enabled
     struct Internals {
       bool swapMouseButtons;
       STICKYKEYS storedStickyKeys;
@@ -91,22 +119,18 @@ namespace nil {
       void disableHotkeyHelpers();
       void restore();
     } internals_;
-    void initializeDevices();
-    void refreshDevices();
+    //! \b Internal Refresh the device lists of some handlers.
+    //! \param targets A combination of RefreshScheduler::Target flags.
+    void refreshDevices( uint32_t targets = windows::RefreshScheduler::Target_All );
+    //! \b Internal Enumerate DirectInput devices, connecting & disconnecting as needed.
+    void refreshDirectInputDevices();
+    //! \b Internal Poll XInput slots, connecting & disconnecting as needed.
+    void refreshXInputDevices();
     void identifySpecialHandlingDevices();
-    DeviceID getNextID();
-    int getNextMouseIndex();
-    int getNextKeyboardIndex();
-    int getNextControllerIndex();
-    bool getDefaultMouseButtonSwapping();
-    void deviceConnect( DevicePtr device );
-    void deviceDisconnect( DevicePtr device );
-    void mouseEnabled( DevicePtr device, MousePtr instance );
-    void keyboardEnabled( DevicePtr device, KeyboardPtr instance );
-    void controllerEnabled( DevicePtr device, ControllerPtr instance );
-    void mouseDisabled( DevicePtr device, MousePtr instance );
-    void keyboardDisabled( DevicePtr device, KeyboardPtr instance );
-    void controllerDisabled( DevicePtr device, ControllerPtr instance );
+    //! \b Internal Hand states sampled by the input thread to the XInput controllers.
+    void dispatchXInputSamples();
+    //! \b Internal Tell the input thread which XInput slots we have connected.
+    void watchXInputDevices();
     void mapMouse( HANDLE handle, RawInputMouse* mouse );
     void unmapMouse( HANDLE handle );
     void mapKeyboard( HANDLE handle, RawInputKeyboard* keyboard );
@@ -120,29 +144,97 @@ namespace nil {
     //! \b Internal My Raw arrival callback.
     void onRawArrival( HANDLE handle ) override;
     //! \b Internal My Raw mouse input callback.
-    void onRawMouseInput( HANDLE handle, const RAWMOUSE& input, const bool sinked ) override;
+    void onRawMouseInput( HANDLE handle, const RAWMOUSE& input, const bool sinked, const Timestamp timestamp ) override;
     //! \b Internal My Raw keyboard input callback.
-    void onRawKeyboardInput( HANDLE handle, const RAWKEYBOARD& input, const bool sinked ) override;
+    void onRawKeyboardInput( HANDLE handle, const RAWKEYBOARD& input, const bool sinked, const Timestamp timestamp ) override;
     //! \b Internal My Raw HID input callback.
-    void onRawHIDInput( HANDLE handle, const RAWHID& input, const bool sinked ) override;
+    void onRawHIDInput( HANDLE handle, const RAWHID& input, const bool sinked, const Timestamp timestamp ) override;
     //! \b Internal My Raw removal callback.
     void onRawRemoval( HANDLE handle ) override;
     //! \b Internal My DirectInput device enumeration callback.
     static BOOL CALLBACK diDeviceEnumCallback(
       LPCDIDEVICEINSTANCEW instance, LPVOID referer );
+#elif defined( NIL_PLATFORM_LINUX )
+    unique_ptr<posix::EventMonitor> eventMonitor_; //!< Our epoll-based input & hotplug event monitor
+    //! \b Internal Probe an input device node, adding it if we support it.
+    void probeDevice( const utf8String& path );
+    //! \b Internal Probe a hidraw node, adding it if we have a parser for it.
+    void probeHidraw( const utf8String& path );
+    //! \b Internal Open an input device node & find out what it is.
+    //! Touches nothing but the node, so it's safe to call from any thread.
+    //! \return The node, if it's a device we support.
+    static std::optional<EvdevNode> inspectDevice( const utf8String& path );
+    //! \b Internal Open a hidraw node & find out what it is.
+    //! Touches nothing but the node, so it's safe to call from any thread.
+    //! \return The node, if it's a known device we have a parser for.
+    static std::optional<HidrawNode> inspectHidraw( const utf8String& path );
+    //! \b Internal Add the device at a probed input device node, or reconnect it.
+    void addDevice( const EvdevNode& node );
+    //! \b Internal Add the device at a probed hidraw node, or reconnect it.
+    void addHidraw( const HidrawNode& node );
+    //! \b Internal Is a known HID device at this physical path being read through hidraw?
+    bool isHidrawHandled( const utf8String& physPath );
+    //! \b Internal Find the connected device currently using a node, if any.
+    DevicePtr findNodeDevice( const utf8String& path );
+    void onHotplugArrival( const utf8String& path ) override;
+    void onHotplugRemoval( const utf8String& path ) override;
+#endif
+    void initializeDevices();
+    DeviceID getNextID();
+    int getNextMouseIndex();
+    int getNextKeyboardIndex();
+    int getNextControllerIndex();
+    bool getDefaultMouseButtonSwapping();
+    void deviceConnect( DevicePtr device );
+    void deviceDisconnect( DevicePtr device );
+    void mouseEnabled( DevicePtr device, MousePtr instance );
+    void keyboardEnabled( DevicePtr device, KeyboardPtr instance );
+    void controllerEnabled( DevicePtr device, ControllerPtr instance );
+    void mouseDisabled( DevicePtr device, MousePtr instance );
+    void keyboardDisabled( DevicePtr device, KeyboardPtr instance );
+    void controllerDisabled( DevicePtr device, ControllerPtr instance );
+    //! \b Internal Add or remove internal listeners on every enabled instance.
+    void attachInstanceListeners( MouseListener* mouse, KeyboardListener* keyboard,
+      ControllerListener* controller, bool attach );
+    //! \b Internal Record a raw HID report, if capturing.
+    void captureReport( Device* device, const uint8_t* data, size_t length );
+    //! \b Internal Record raw mouse motion, if capturing.
+    void captureMotion( Mouse* mouse, const Vector2i& movement, int wheel );
 
   private:
+#ifdef NIL_PLATFORM_WINDOWS
     //! Private constructor.
     System( HINSTANCE instance, HWND window, const Cooperation coop, SystemListener* listener );
+#elif defined( NIL_PLATFORM_LINUX )
+    //! Private constructor.
+    System( const Cooperation coop, SystemListener* listener );
+#endif
     System() = default;
 
   public:
+#ifdef NIL_PLATFORM_WINDOWS
     //! Factory function. Use this to construct your instance.
     //! \param  instance  Handle of the host instance.
     //! \param  window    Handle of the host window.
     //! \param  coop      Cooperation mode.
     //! \param  listener  Listener for system events.
     [[nodiscard]] static SystemPtr create( HINSTANCE instance, HWND window, const Cooperation coop, SystemListener* listener );
+#elif defined( NIL_PLATFORM_LINUX )
+    //! Factory function. Use this to construct your instance.
+    //! \param  coop      Cooperation mode. Evdev has no notion of window focus,
+    //!                   so input is always received as if in the background.
+    //! \param  listener  Listener for system events.
+    [[nodiscard]] static SystemPtr create( const Cooperation coop, SystemListener* listener );
+#endif
+
+    //! Keep what probing devices finds out in a cache file, so that repeat
+    //! launches can skip asking devices they have seen before.
+    //! On Windows this saves each HID device's string & feature report queries.
+    //! On Linux probing only asks the kernel, which is quick, so nothing is cached.
+    //! A missing, stale or damaged cache file is no error.
+    //! Call before initialize().
+    //! \param path Path of the cache file.
+    void setProbeCache( const utf8String& path );
 
     //! Initialize this system.
     //! Call only once after constructing, before the first update().
@@ -156,7 +248,88 @@ namespace nil {
     //! \return The devices.
     DeviceList& getDevices();
 
+    //! Get currently known devices, indexed for lookups
+    //! by static ID or USB vendor & product IDs.
+    //! \return The device registry.
+    const DeviceRegistry& getDeviceRegistry() const;
+
+    //! Create a virtual device, for injecting synthetic input.
+    //! The device is connected right away and shows up like any other;
+    //! enable it to get a VirtualMouse, VirtualKeyboard or VirtualController instance.
+    //! \param  type   Device type.
+    //! \param  name   Device name. Autogenerated if empty.
+    //! \param  layout Component counts for the instance.
+    //! \param  staticId Static ID to use, or 0 to derive one from type & name.
+    //! \return The device.
+    VirtualDevicePtr createVirtualDevice( Device::Type type, const utf8String& name = utf8String(),
+      const VirtualDevice::Layout& layout = VirtualDevice::Layout(), DeviceID staticId = 0 );
+
+    //! Start capturing input into a file, for later replay with CaptureReplay.
+    //! Everything the listeners get to see is recorded, along with raw HID reports.
+    //! Devices enabled after this are picked up automatically.
+    //! \param  path Path of the capture file to create.
+    void startCapture( const utf8String& path );
+
+    //! Stop capturing, writing out anything still buffered.
+    void stopCapture();
+
+    //! Query if this System is capturing.
+    bool isCapturing() const;
+
+    //! Start queueing all input events for pollEvents, alongside the listeners.
+    //! The queue is allocated once, here; when it is full, new events are dropped.
+    //! \param  capacity Minimum number of events to hold between polls.
+    void enableEventQueue( size_t capacity = 4096 );
+
+    //! Stop queueing input events, discarding any still queued.
+    void disableEventQueue();
+
+    //! Hand every input event to a handler as it happens, alongside the listeners.
+    //! Instances call a plain function made for the handler's type, which calls
+    //! its methods directly, so that the compiler can inline them; no virtual
+    //! calls, and nothing is queued or copied in between.
+    //! Any of these can be defined, each taking a const Event&:
+    //! onMouseMoved, onMouseButtonPressed, onMouseButtonReleased, onMouseWheelMoved,
+    //! onKeyPressed, onKeyRepeat, onKeyReleased,
+    //! onControllerButtonPressed, onControllerButtonReleased, onControllerAxisMoved,
+    //! onControllerSliderMoved & onControllerPOVMoved.
+    //! Replaces any handler set before.
+    //! \param  handler The handler, which must stay alive until cleared.
+    template <class Handler>
+    void setEventHandler( Handler& handler );
+
+    //! Stop handing input events to the handler.
+    void clearEventHandler();
+
+    //! Move queued input events out, oldest first.
+    //! Call after update(), and again while it fills the whole span.
+    //! \param  events Where to put the events.
+    //! \return Number of events written; 0 if the queue is not enabled.
+    size_t pollEvents( std::span<Event> events );
+
+    //! Get the number of events dropped so far because the queue was full.
+    size_t getDroppedEventCount() const;
+
+    //! Start sampling input on a thread of nil's own, so that sampling no longer
+    //! depends on how often update() gets called. Raw input is handed over to
+    //! update() through a lock-free ring, and decoded & dispatched there as usual;
+    //! listeners are still only ever called from inside update().
+    //! On Linux every device node is read on the thread. On Windows, raw input
+    //! and DirectInput are already buffered by the OS, so the thread polls XInput.
+    //! Call after initialize().
+    //! \param  bufferSize Bytes of raw input to hold between updates.
+    //!                    When full, the thread waits & lets the OS buffer instead.
+    void enableInputThread( size_t bufferSize = 1024 * 1024 );
+
+    //! Stop the input thread, handing whatever it had sampled to the next update().
+    void disableInputThread();
+
+    //! Query if input is being sampled on a thread of its own.
+    bool isInputThreaded() const;
+
+#ifdef NIL_PLATFORM_WINDOWS
     XInput* getXInput();
+#endif
 
     //! Query if this System is initializing.
     //! \return true if initializing, false if not.
@@ -168,7 +341,15 @@ namespace nil {
     ~System();
   };
 
-#endif
+  template <class Handler>
+  void System::setEventHandler( Handler& handler )
+  {
+    eventSink_.target = &handler;
+    eventSink_.function = []( void* target, const Event& event )
+    {
+      dispatchEvent( *static_cast<Handler*>( target ), event );
+    };
+  }
 
   //! @}
 
@@ -0,0 +1,232 @@
+#pragma once
+#include "nilConfig.h"
+
+#include "nilTypes.h"
+#include "nilComponents.h"
+#include "nilException.h"
+#include "nilCommon.h"
+#include "nilVirtual.h"
+
+namespace nil {
+
+  //! \addtogroup Nil
+  //! @{
+
+  //! \addtogroup Capture
+  //! @{
+
+  //! Capture file magic, "NILCAP" followed by the format version.
+  const char c_captureMagic[8] = { 'N', 'I', 'L', 'C', 'A', 'P', 0, 1 };
+
+  //! Capture record types.
+  enum CaptureRecordType: uint16_t
+  {
+    Capture_DeviceConnected = 0, //!< CaptureDeviceRecord, followed by the name
+    Capture_DeviceDisconnected, //!< No payload
+    Capture_DeviceEnabled, //!< CaptureLayoutRecord
+    Capture_MouseMove, //!< CaptureVectorRecord, relative movement
+    Capture_MouseButton, //!< CaptureIndexRecord, value is pushed state
+    Capture_MouseWheel, //!< CaptureIndexRecord, value is the signed delta
+    Capture_KeyPressed, //!< CaptureIndexRecord, index is the key code
+    Capture_KeyRepeat, //!< CaptureIndexRecord, index is the key code
+    Capture_KeyReleased, //!< CaptureIndexRecord, index is the key code
+    Capture_ControllerButton, //!< CaptureIndexRecord, value is pushed state
+    Capture_ControllerAxis, //!< CaptureRealRecord
+    Capture_ControllerSlider, //!< CaptureRealRecord, with both slider components
+    Capture_ControllerPOV, //!< CaptureIndexRecord, value is the direction
+    Capture_HIDReport //!< Raw report bytes, as read from the device
+  };
+
+  //! Header in front of every record in a capture file.
+  //! Records are padded to 8 bytes, so that headers stay aligned when mapped.
+  //! Everything is stored in native byte order.
+  struct CaptureRecordHeader
+  {
+    uint64_t timestamp; //!< Nanoseconds since capture start, by the input's own timestamp
+    DeviceID device; //!< Static ID of the device
+    CaptureRecordType type; //!< Record type
+    uint16_t length; //!< Payload length, not including padding
+  };
+
+  //! Device connection payload.
+  struct CaptureDeviceRecord
+  {
+    uint8_t type; //!< Device::Type
+    uint8_t handler; //!< Device::Handler
+    uint16_t nameLength; //!< Length of the UTF-8 name that follows
+  };
+
+  //! Device enabling payload; the instance's component counts.
+  struct CaptureLayoutRecord
+  {
+    uint16_t buttons;
+    uint16_t axes;
+    uint16_t sliders;
+    uint16_t povs;
+  };
+
+  //! Payload for events on an indexed component, and key events.
+  struct CaptureIndexRecord
+  {
+    uint32_t index;
+    int32_t value;
+  };
+
+  //! Payload for mouse movement.
+  struct CaptureVectorRecord
+  {
+    int32_t x;
+    int32_t y;
+  };
+
+  //! Payload for analog controller components.
+  struct CaptureRealRecord
+  {
+    uint32_t index;
+    Real x;
+    Real y;
+  };
+
+  //! \class CaptureWriter
+  //! Records everything the listeners of a System get to see, plus raw HID reports,
+  //! into a compact binary capture file.
+  //! \sa System::startCapture
+  class CaptureWriter: public MouseListener, public KeyboardListener, public ControllerListener {
+  private:
+    std::ofstream file_; //!< Output file
+    vector<uint8_t> buffer_; //!< Records waiting to be written
+    Timestamp start_; //!< When capture started
+
+    //! \b Internal Append a record to the buffer.
+    void write( Timestamp timestamp, DeviceID device, CaptureRecordType type, const void* payload, size_t length,
+      const void* extra = nullptr, size_t extraLength = 0 );
+
+    //! \b Internal Write out the buffer.
+    void flush();
+  public:
+    //! Constructor.
+    //! \param path Path of the capture file to create.
+    explicit CaptureWriter( const utf8String& path );
+
+    //! Record a device connection.
+    void deviceConnected( Device* device );
+
+    //! Record a device disconnection.
+    void deviceDisconnected( Device* device );
+
+    //! Record a device being enabled, with its instance's layout,
+    //! and start listening to the instance.
+    void mouseEnabled( Device* device, Mouse* instance );
+    void keyboardEnabled( Device* device, Keyboard* instance );
+    void controllerEnabled( Device* device, Controller* instance );
+
+    //! Record a raw HID report.
+    void hidReport( Device* device, const uint8_t* data, size_t length );
+
+    //! Record relative mouse motion as it comes in, ahead of any coalescing,
+    //! so that replays move along the same path.
+    void mouseMotion( Mouse* mouse, const Vector2i& movement, int wheel );
+
+    void onMouseMoved( Mouse* mouse, const MouseState& state ) override;
+    void onMouseButtonPressed( Mouse* mouse, const MouseState& state, size_t button ) override;
+    void onMouseButtonReleased( Mouse* mouse, const MouseState& state, size_t button ) override;
+    void onMouseWheelMoved( Mouse* mouse, const MouseState& state ) override;
+    void onKeyPressed( Keyboard* keyboard, const VirtualKeyCode keycode ) override;
+    void onKeyRepeat( Keyboard* keyboard, const VirtualKeyCode keycode ) override;
+    void onKeyReleased( Keyboard* keyboard, const VirtualKeyCode keycode ) override;
+    void onControllerButtonPressed( Controller* controller, const ControllerState& state, size_t button ) override;
+    void onControllerButtonReleased( Controller* controller, const ControllerState& state, size_t button ) override;
+    void onControllerAxisMoved( Controller* controller, const ControllerState& state, size_t axis ) override;
+    void onControllerSliderMoved( Controller* controller, const ControllerState& state, size_t slider ) override;
+    void onControllerPOVMoved( Controller* controller, const ControllerState& state, size_t pov ) override;
+
+    //! Destructor. Writes out anything still buffered.
+    ~CaptureWriter();
+  };
+
+  //! \class MappedFile
+  //! A whole file mapped read-only into memory.
+  class MappedFile {
+  private:
+    const uint8_t* data_ = nullptr; //!< Mapped view
+    size_t size_ = 0; //!< Size of the file
+#ifdef NIL_PLATFORM_WINDOWS
+    HANDLE file_ = INVALID_HANDLE_VALUE; //!< File handle
+    HANDLE mapping_ = nullptr; //!< File mapping handle
+#endif
+  public:
+    //! Constructor.
+    //! \param path Path of the file to map.
+    explicit MappedFile( const utf8String& path );
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator = ( const MappedFile& ) = delete;
+
+    //! Get the mapped data.
+    const uint8_t* data() const { return data_; }
+
+    //! Get the size of the mapped data.
+    size_t size() const { return size_; }
+
+    ~MappedFile();
+  };
+
+  //! \class CaptureReplay
+  //! Replays a capture file through a System, mapping the file and streaming records
+  //! straight from the mapping. Recorded devices come back as virtual devices with
+  //! their original names & static IDs, and go through the regular connection &
+  //! listener path; it is up to the application to enable them, as usual.
+  //! Raw HID reports are skipped, since the events they caused were recorded too.
+  class CaptureReplay {
+  private:
+    //! What we know of a recorded device.
+    struct ReplayDevice {
+      Device::Type type = Device::Device_Controller;
+      utf8String name;
+      VirtualDevice::Layout layout;
+      VirtualDevicePtr device; //!< Our stand-in, once connected
+    };
+    SystemPtr system_; //!< The system to replay into
+    MappedFile file_; //!< The capture file
+    size_t position_; //!< Offset of the next record
+    map<DeviceID, ReplayDevice> devices_; //!< Recorded devices by static ID
+    Timestamp start_ = 0; //!< When replay started; recorded times are rebased onto it
+    bool started_ = false; //!< Has replay started?
+
+    //! \b Internal Note when replay starts, on the first call that replays anything.
+    void start();
+
+    //! \b Internal Replay a single record.
+    void replay( const CaptureRecordHeader& header, const uint8_t* payload );
+  public:
+    //! Constructor.
+    //! \param system The system to replay into.
+    //! \param path   Path of the capture file.
+    CaptureReplay( SystemPtr system, const utf8String& path );
+
+    //! Replay records up to a point in capture time.
+    //! \param until Nanoseconds since capture start.
+    //! \return false once all records have been replayed.
+    bool advance( uint64_t until );
+
+    //! Replay whatever was recorded up to now, pacing by wall clock time
+    //! since the first call. Call once per frame, like System::update.
+    //! \return false once all records have been replayed.
+    bool update();
+
+    //! Replay everything right away, as fast as possible.
+    void runToEnd();
+
+    //! Has everything been replayed?
+    bool isFinished() const;
+
+    //! Destructor.
+    ~CaptureReplay();
+  };
+
+  using CaptureReplayPtr = unique_ptr<CaptureReplay>;
+
+  //! @}
+
+  //! @}
+
+}
\ No newline at end of file
@@ -13,6 +13,10 @@ namespace nil {
   class System;
   class DeviceInstance;
 
+  struct Event;
+  struct EventSink;
+  enum EventType: uint16_t;
+
   class Mouse;
   class Keyboard;
   class Controller;
@@ -21,7 +25,12 @@ namespace nil {
   //! A generic input device in the system.
   class Device {
   friend class System;
+  friend class DeviceInstance;
   friend class XInputController;
+  friend class EvdevMouse;
+  friend class EvdevKeyboard;
+  friend class EvdevController;
+  friend class HidrawController;
   public:
     //! Device handler types.
     enum Handler: int
@@ -29,7 +38,9 @@ namespace nil {
       Handler_DirectInput = 0, //!< Implemented by DirectInput
       Handler_XInput, //!< Implemented by XInput
       Handler_RawInput, //!< Implemented by Raw Input API
-      Handler_HID //!< Implemented by direct HID
+      Handler_HID, //!< Implemented by direct HID
+      Handler_Evdev, //!< Implemented by Linux evdev
+      Handler_Virtual //!< Implemented in software, driven by injected input
     };
     //! Device types.
     enum Type: int
@@ -47,7 +58,7 @@ namespace nil {
     };
   protected:
     Type type_; //!< Device type
-    SystemPtr system_; //!< My owner
+    System* system_; //!< My owner, which outlives me
     DeviceID id_; //!< Unique identifier, only valid per session
     Status status_ = Status_Pending; //!< Current status
     Status savedStatus_ = Status_Pending; //!< Status backup when updating
@@ -56,7 +67,7 @@ namespace nil {
     bool disconnectFlag_ = false; //!< Whether I am flagged for disconnection or not
     int typedIndex_; //!< This is a device-type-specific index for the device
 
-    explicit Device( SystemPtr system, DeviceID id, Type type );
+    explicit Device( System* system, DeviceID id, Type type );
     virtual ~Device() = default;
     virtual void update(); //!< Update our instance
     virtual void setStatus( Status status ); //!< Set status
@@ -75,7 +86,7 @@ namespace nil {
     virtual Type getType() const; //!< Get my type
     virtual Status getStatus() const; //!< Get my status
     virtual const utf8String& getName() const; //!< Get my name
-    virtual System* getSystem(); //!< Get my owning system
+    virtual System* getSystem(); //!< Get my owning system. Devices must not be used past its lifetime
     virtual bool isDisconnectFlagged() const; //!< Am I flagged for disconnection?
     virtual shared_ptr<Device> ptr() = 0;
   };
@@ -87,24 +98,43 @@ namespace nil {
 
   //! \class DeviceInstance
   //! Device instance base class.
+  //! Owned by its device, which is owned by its system; the references back
+  //! up that chain don't own anything, so that a System is freed as soon as
+  //! the application lets go of it, and using them costs no reference counting.
   class DeviceInstance {
   protected:
-    SystemPtr system_; //!< The system
-    DevicePtr device_; //!< The device
+    System* system_; //!< The system
+    Device* device_; //!< The device
+    Timestamp timestamp_ = 0; //!< When the latest input happened
+    const EventSink* eventSink_; //!< The system's event handler
+
+    //! \b Internal Start an event from the input currently being reported.
+    inline Event makeEvent( EventType type, uint32_t index ) const;
   public:
     //! Constructor.
     //! \param system The system.
     //! \param device The device.
-    DeviceInstance( SystemPtr system, DevicePtr device );
+    DeviceInstance( System* system, Device* device );
 
     //! Update this DeviceInstance.
     //! \note This is called by System, no need to do it yourself.
     virtual void update() = 0;
 
+    //! Publish the state as it stands after update() for other threads to read.
+    //! \note This is called by System, no need to do it yourself.
+    virtual void publishSnapshot();
+
     virtual shared_ptr<DeviceInstance> ptr() = 0;
 
     //! Get the device that owns me.
-    virtual const DevicePtr getDevice() const;
+    virtual Device* getDevice() const;
+
+    //! Get when the input currently being reported happened.
+    //! Call this from listener callbacks; outside them it is the time of the latest input.
+    //! Taken as close to the source as the backend allows: the kernel's event time on evdev,
+    //! the message time on Raw Input, and the poll time on XInput & DirectInput.
+    //! \return The time, comparable to currentTimestamp().
+    virtual Timestamp getTimestamp() const;
 
     //! Destructor.
     virtual ~DeviceInstance();
@@ -127,6 +157,42 @@ namespace nil {
     Movement movement; //!< My movement
   };
 
+  //! \struct MouseSnapshot
+  //! Mouse state as of the latest System::update(), in plain old data.
+  //! \sa Mouse::getSnapshot
+  struct MouseSnapshot
+  {
+    Timestamp timestamp; //!< When the latest input happened
+    Vector2i movement; //!< Relative movement over the update
+    int32_t wheel; //!< Relative wheel rotation over the update
+    uint32_t buttons; //!< Pushed buttons, one bit each, button 0 being the lowest
+  };
+
+  //! Reader's handle on published Mouse snapshots.
+  //! \sa Mouse::getSnapshotSource
+  using MouseSnapshotSource = shared_ptr<const SeqLock<MouseSnapshot>>;
+
+  //! \struct MouseSample
+  //! A single report from a mouse, as it came in, in plain old data.
+  //! \sa Mouse::getSamples
+  struct MouseSample
+  {
+    Timestamp timestamp; //!< When the report happened
+    Vector2i movement; //!< Relative movement in the report
+    int32_t wheel; //!< Relative wheel rotation in the report
+    uint32_t buttons; //!< Pushed buttons after the report, one bit each, button 0 being the lowest
+  };
+
+  //! Mouse event kinds, for subscribing listeners to.
+  //! \sa Subscription
+  enum MouseEvent: uint32_t
+  {
+    MouseEvent_Moved = 1 << 0, //!< onMouseMoved
+    MouseEvent_ButtonPressed = 1 << 1, //!< onMouseButtonPressed; the component is the button
+    MouseEvent_ButtonReleased = 1 << 2, //!< onMouseButtonReleased; the component is the button
+    MouseEvent_WheelMoved = 1 << 3 //!< onMouseWheelMoved
+  };
+
   //! \class MouseListener
   //! Mouse event listener base class.
   //! Derive your own listener from this class.
@@ -145,7 +211,7 @@ namespace nil {
     virtual void onMouseWheelMoved( Mouse* mouse, const MouseState& state ) = 0;
   };
 
-  using MouseListenerList = list<MouseListener*>;
+  using MouseListenerList = ListenerList<MouseListener>;
 
   //! \class Mouse
   //! Mouse device instance base class.
@@ -156,26 +222,105 @@ namespace nil {
     Vector2i lastPosition_; //!< Previous position when mouse gives absolutes
     MouseListenerList listeners_; //!< Registered event listeners
     bool swapButtons_; //!< Whether first & second buttons are swapped
+    bool coalescing_ = false; //!< Whether motion is summed up over each update
+    Vector2i coalescedMovement_; //!< Movement not yet fired, when coalescing
+    int coalescedWheel_ = 0; //!< Wheel rotation not yet fired, when coalescing
+    Timestamp coalescedTimestamp_ = 0; //!< Time of the latest movement not yet fired
+    Vector2i frameMovement_; //!< Movement fired during this update
+    int frameWheel_ = 0; //!< Wheel rotation fired during this update
+    shared_ptr<SeqLock<MouseSnapshot>> snapshot_; //!< Published state, for other threads
+    uint32_t buttonMask_ = 0; //!< Pushed buttons, one bit each
+    size_t sampleCapacity_ = 0; //!< Samples recorded per update at most, 0 when not recording
+    vector<MouseSample> samples_; //!< Samples recorded during this update
+    vector<MouseSample> frameSamples_; //!< Samples recorded during the latest update
+    size_t droppedSamples_ = 0; //!< Samples dropped for lack of room
+
+    //! Report relative movement; fired right away, or held back when coalescing.
+    void fireMovement( const Vector2i& delta );
+
+    //! Report wheel rotation; fired right away, or held back when coalescing.
+    void fireWheel( int delta );
+
+    //! Report a button press or release. Anything held back goes out first.
+    void fireButton( size_t button, bool pushed );
+
+    //! Fire movement & wheel rotation held back so far.
+    void flushCoalesced();
+
+    //! Record one report into the sample history, if it's on.
+    //! Backends call this once per report, after firing its contents.
+    void recordSample( const Vector2i& movement, int wheel );
   public:
     //! Constructor.
     //! \param system The system.
     //! \param device The device.
     //! \param swapButtons Whether to swap first & second buttons.
-    Mouse( SystemPtr system, DevicePtr device, const bool swapButtons );
+    Mouse( System* system, Device* device, const bool swapButtons );
 
-    //! Add a mouse input listener.
+    //! Add a mouse input listener. Safe to call from inside a callback.
     //! \param listener The listener.
-    virtual void addListener( MouseListener* listener );
+    //! \param subscription MouseEvent kinds & buttons to call it for.
+    //! \return Token for removing the listener with.
+    virtual ListenerToken addListener( MouseListener* listener,
+      const Subscription& subscription = Subscription() );
+
+    //! Change what a mouse input listener is called for.
+    //! \param token The token it was added with.
+    //! \param subscription MouseEvent kinds & buttons to call it for.
+    virtual void setSubscription( ListenerToken token, const Subscription& subscription );
 
-    //! Remove a mouse input listener.
+    //! Remove a mouse input listener. Safe to call from inside a callback.
     //! \param listener The listener.
     virtual void removeListener( MouseListener* listener );
 
-    void update() override = 0;
+    //! Remove a mouse input listener by the token it was added with.
+    //! \param token The token.
+    virtual void removeListener( ListenerToken token );
+
+    //! Finishes the update; when coalescing, fires what was held back
+    //! and makes the update's sums the state. Backends call this last.
+    void update() override;
+
+    void publishSnapshot() override;
 
     //! Get the Mouse state.
+    //! When coalescing, movement & wheel are the sums over the latest update.
     virtual const MouseState& getState() const;
 
+    //! Get the Mouse state as of the latest update, without locking.
+    //! Movement & wheel are always the sums over that update.
+    //! Zeroed until the first update. Call on the update thread, or while
+    //! the Mouse is sure to stay alive; other threads use getSnapshotSource.
+    virtual MouseSnapshot getSnapshot() const;
+
+    //! Get the block the state is published through after each update.
+    //! Take it once, on enable; it can then be loaded from any thread, without
+    //! locking, for as long as it's held. Once the Mouse is gone, it keeps
+    //! the final state.
+    virtual MouseSnapshotSource getSnapshotSource() const;
+
+    //! Set whether to coalesce movement & wheel rotation over each System::update().
+    //! When on, onMouseMoved & onMouseWheelMoved fire at most once per update,
+    //! plus once before every button change, so that the order of events holds.
+    //! Off by default.
+    virtual void setCoalescing( bool coalesce );
+
+    //! Query if movement & wheel rotation are being coalesced.
+    virtual bool isCoalescing() const;
+
+    //! Set how many reports to keep as samples over each System::update().
+    //! Samples are kept as the reports came in, whether coalescing or not.
+    //! Reports beyond the capacity are dropped until the next update.
+    //! \param capacity Samples to keep per update, or 0 to stop recording. 0 by default.
+    virtual void setSampleHistory( size_t capacity );
+
+    //! Get the samples recorded during the latest System::update(), oldest first.
+    //! Stays valid until the next update.
+    virtual std::span<const MouseSample> getSamples() const;
+
+    //! Get the number of samples dropped so far for lack of room.
+    virtual size_t getDroppedSamples() const;
+
     //! Destructor.
     virtual ~Mouse();
   };
@@ -187,6 +332,108 @@ namespace nil {
   //! \addtogroup Keyboard
   //! @{
 
+  //! Keyboard event kinds, for subscribing listeners to.
+  //! \sa Subscription
+  enum KeyboardEvent: uint32_t
+  {
+    KeyboardEvent_KeyPressed = 1 << 0, //!< onKeyPressed; the component is the key code
+    KeyboardEvent_KeyRepeat = 1 << 1, //!< onKeyRepeat; the component is the key code
+    KeyboardEvent_KeyReleased = 1 << 2 //!< onKeyReleased; the component is the key code
+  };
+
+  //! \struct KeyMask
+  //! A set of virtual key codes, one bit each, in plain old data.
+  //! Make one to test several keys at once: KeyMask { Keyboard::Key_LeftControl, 'C' }
+  struct KeyMask
+  {
+    static const size_t c_keyCount = 256; //!< Key codes covered, from 0 up
+
+    uint64_t words[c_keyCount / 64] = {}; //!< The keys, one bit each
+
+    constexpr KeyMask() = default;
+
+    //! Constructor.
+    //! \param keys The keys in the set.
+    constexpr KeyMask( std::initializer_list<VirtualKeyCode> keys )
+    {
+      for ( auto key : keys )
+        set( key );
+    }
+
+    //! Add a key to the set, or remove it. Key codes out of range are ignored.
+    constexpr void set( VirtualKeyCode key, bool in = true )
+    {
+      if ( key >= c_keyCount )
+        return;
+
+      if ( in )
+        words[key / 64] |= ( 1ULL << ( key % 64 ) );
+      else
+        words[key / 64] &= ~( 1ULL << ( key % 64 ) );
+    }
+
+    //! Query if a key is in the set.
+    constexpr bool test( VirtualKeyCode key ) const
+    {
+      return ( key < c_keyCount && ( words[key / 64] >> ( key % 64 ) ) & 1 );
+    }
+
+    //! Query if any key of another set is in this one.
+    constexpr bool any( const KeyMask& keys ) const
+    {
+      for ( size_t i = 0; i < c_keyCount / 64; i++ )
+        if ( words[i] & keys.words[i] )
+          return true;
+      return false;
+    }
+
+    //! Query if every key of another set is in this one.
+    constexpr bool all( const KeyMask& keys ) const
+    {
+      for ( size_t i = 0; i < c_keyCount / 64; i++ )
+        if ( ( words[i] & keys.words[i] ) != keys.words[i] )
+          return false;
+      return true;
+    }
+
+    //! Query if the set is empty.
+    constexpr bool empty() const
+    {
+      for ( auto word : words )
+        if ( word )
+          return false;
+      return true;
+    }
+
+    //! Get the number of keys in the set.
+    constexpr size_t count() const
+    {
+      size_t count = 0;
+      for ( auto word : words )
+        count += static_cast<size_t>( std::popcount( word ) );
+      return count;
+    }
+
+    constexpr bool operator == ( const KeyMask& other ) const = default;
+  };
+
+  //! \struct KeyboardSnapshot
+  //! Keyboard state as of the latest System::update(), in plain old data.
+  //! \sa Keyboard::getSnapshot
+  struct KeyboardSnapshot
+  {
+    Timestamp timestamp; //!< When the latest input happened
+    KeyMask keys; //!< Keys held down
+    Timestamp pressTimes[KeyMask::c_keyCount]; //!< When each key held down went down; 0 for the rest
+
+    //! Query if a key is held down.
+    inline bool isKeyDown( VirtualKeyCode key ) const { return keys.test( key ); }
+  };
+
+  //! Reader's handle on published Keyboard snapshots.
+  //! \sa Keyboard::getSnapshotSource
+  using KeyboardSnapshotSource = shared_ptr<const SeqLock<KeyboardSnapshot>>;
+
   //! \class KeyboardListener
   //! Keyboard event listener base class.
   //! Derive your own listener from this class.
@@ -202,7 +449,7 @@ namespace nil {
     virtual void onKeyReleased( Keyboard* keyboard, const VirtualKeyCode keycode ) = 0;
   };
 
-  using KeyboardListenerList = list<KeyboardListener*>;
+  using KeyboardListenerList = ListenerList<KeyboardListener>;
 
   //! \class Keyboard
   //! Keyboard device instance base class.
@@ -210,6 +457,19 @@ namespace nil {
   class Keyboard: public DeviceInstance {
   protected:
     KeyboardListenerList listeners_; //!< Registered event listeners
+    KeyMask keys_; //!< Keys held down
+    Timestamp pressTimes_[KeyMask::c_keyCount] = {}; //!< When each key held down went down
+    bool snapshotPending_ = false; //!< Whether anything happened since the latest snapshot
+    shared_ptr<SeqLock<KeyboardSnapshot>> snapshot_; //!< Published state, for other threads
+
+    //! Report a key press, marking the key held down.
+    void fireKeyPressed( VirtualKeyCode keycode );
+
+    //! Report a key repeat.
+    void fireKeyRepeat( VirtualKeyCode keycode );
+
+    //! Report a key release, marking the key up.
+    void fireKeyReleased( VirtualKeyCode keycode );
   public:
     //! KeyCode values.
     enum KeyCode : VirtualKeyCode {
@@ -219,24 +479,66 @@ namespace nil {
       Key_RightControl,
       Key_LeftAlt,
       Key_RightAlt,
-      Key_NumpadEnter = 0xD8 // Random unused code for our repurposing
+      Key_NumpadEnter = 0xD8, // Random unused code for our repurposing
+      Key_Invalid = 0xFF // Not a key, never reported
     };
 
     //! Constructor.
     //! \param system The system.
     //! \param device The device.
-    Keyboard( SystemPtr system, DevicePtr device );
+    Keyboard( System* system, Device* device );
 
-    //! Add a keyboard input listener.
+    //! Add a keyboard input listener. Safe to call from inside a callback.
     //! \param listener The listener.
-    virtual void addListener( KeyboardListener *listener );
+    //! \param subscription KeyboardEvent kinds & key codes to call it for.
+    //! \return Token for removing the listener with.
+    virtual ListenerToken addListener( KeyboardListener *listener,
+      const Subscription& subscription = Subscription() );
 
-    //! Remove a keyboard input listener.
+    //! Change what a keyboard input listener is called for.
+    //! \param token The token it was added with.
+    //! \param subscription KeyboardEvent kinds & key codes to call it for.
+    virtual void setSubscription( ListenerToken token, const Subscription& subscription );
+
+    //! Remove a keyboard input listener. Safe to call from inside a callback.
     //! \param listener The listener.
     virtual void removeListener( KeyboardListener *listener );
 
+    //! Remove a keyboard input listener by the token it was added with.
+    //! \param token The token.
+    virtual void removeListener( ListenerToken token );
+
     void update() override = 0;
 
+    void publishSnapshot() override;
+
+    //! Query if a key is held down.
+    inline bool isKeyDown( VirtualKeyCode keycode ) const { return keys_.test( keycode ); }
+
+    //! Query if any of the given keys is held down.
+    inline bool isAnyKeyDown( const KeyMask& keys ) const { return keys_.any( keys ); }
+
+    //! Query if all of the given keys are held down.
+    inline bool areAllKeysDown( const KeyMask& keys ) const { return keys_.all( keys ); }
+
+    //! Get the keys held down.
+    inline const KeyMask& getKeys() const { return keys_; }
+
+    //! Get when a key held down went down.
+    //! \return The time, comparable to currentTimestamp(), or 0 if the key is up.
+    virtual Timestamp getKeyPressTime( VirtualKeyCode keycode ) const;
+
+    //! Get the Keyboard state as of the latest update, without locking.
+    //! Zeroed until the first update. Call on the update thread, or while
+    //! the Keyboard is sure to stay alive; other threads use getSnapshotSource.
+    virtual KeyboardSnapshot getSnapshot() const;
+
+    //! Get the block the state is published through after each update.
+    //! Take it once, on enable; it can then be loaded from any thread, without
+    //! locking, for as long as it's held. Once the Keyboard is gone, it keeps
+    //! the final state.
+    virtual KeyboardSnapshotSource getSnapshotSource() const;
+
     //! Destructor.
     virtual ~Keyboard();
   };
@@ -260,6 +562,50 @@ namespace nil {
     vector<POV> povs; //!< My POVs
   };
 
+  //! Components beyond these counts are left out of a ControllerSnapshot.
+  const size_t c_snapshotButtons = 128;
+  const size_t c_snapshotAxes = 16;
+  const size_t c_snapshotSliders = 4;
+  const size_t c_snapshotPOVs = 4;
+
+  //! \struct ControllerSnapshot
+  //! Controller state as of the latest System::update(), in plain old data.
+  //! \sa Controller::getSnapshot
+  struct ControllerSnapshot
+  {
+    Timestamp timestamp; //!< When the latest input happened
+    uint32_t buttonCount; //!< Buttons present, up to c_snapshotButtons
+    uint32_t axisCount; //!< Axes present, up to c_snapshotAxes
+    uint32_t sliderCount; //!< Sliders present, up to c_snapshotSliders
+    uint32_t povCount; //!< POVs present, up to c_snapshotPOVs
+    uint64_t buttons[c_snapshotButtons / 64]; //!< Pushed buttons, one bit each
+    Real axes[c_snapshotAxes]; //!< Axis values
+    Vector2f sliders[c_snapshotSliders]; //!< Slider values
+    POVDirection povs[c_snapshotPOVs]; //!< POV directions
+
+    //! Query if a button is pushed.
+    inline bool isPushed( size_t button ) const
+    {
+      return ( button < buttonCount && ( buttons[button / 64] >> ( button % 64 ) ) & 1 );
+    }
+  };
+
+  //! Reader's handle on published Controller snapshots.
+  //! \sa Controller::getSnapshotSource
+  using ControllerSnapshotSource = shared_ptr<const SeqLock<ControllerSnapshot>>;
+
+  //! Controller event kinds, for subscribing listeners to.
+  //! The component is the index of the button, axis, slider or POV.
+  //! \sa Subscription
+  enum ControllerEvent: uint32_t
+  {
+    ControllerEvent_ButtonPressed = 1 << 0, //!< onControllerButtonPressed
+    ControllerEvent_ButtonReleased = 1 << 1, //!< onControllerButtonReleased
+    ControllerEvent_AxisMoved = 1 << 2, //!< onControllerAxisMoved
+    ControllerEvent_SliderMoved = 1 << 3, //!< onControllerSliderMoved
+    ControllerEvent_POVMoved = 1 << 4 //!< onControllerPOVMoved
+  };
+
   //! \class ControllerListener
   //! Game controller event listener base class.
   //! Derive your own listener from this class.
@@ -286,7 +632,7 @@ namespace nil {
       const ControllerState& state, size_t pov ) = 0;
   };
 
-  using ControllerListenerList = list<ControllerListener*>;
+  using ControllerListenerList = ListenerList<ControllerListener>;
 
   //! \class Controller
   //! Game controller device instance base class.
@@ -311,6 +657,7 @@ namespace nil {
     Type type_; //!< The type of controller I am
     ControllerState state_; //!< Current controls state
     ControllerListenerList listeners_; //!< Registered state change listeners
+    shared_ptr<SeqLock<ControllerSnapshot>> snapshot_; //!< Published state, for other threads
 
     //! Figure out changes in state and fire change events accordingly.
     virtual void fireChanges( const ControllerState& lastState );
@@ -318,24 +665,49 @@ namespace nil {
     //! Constructor.
     //! \param system The system.
     //! \param device The device.
-    Controller( SystemPtr system, DevicePtr device );
+    Controller( System* system, Device* device );
 
     //! Destructor.
     virtual ~Controller();
 
-    //! Add a controller input listener.
-    virtual void addListener( ControllerListener* listener );
+    //! Add a controller input listener. Safe to call from inside a callback.
+    //! \param listener The listener.
+    //! \param subscription ControllerEvent kinds & component indices to call it for.
+    //! \return Token for removing the listener with.
+    virtual ListenerToken addListener( ControllerListener* listener,
+      const Subscription& subscription = Subscription() );
+
+    //! Change what a controller input listener is called for.
+    //! \param token The token it was added with.
+    //! \param subscription ControllerEvent kinds & component indices to call it for.
+    virtual void setSubscription( ListenerToken token, const Subscription& subscription );
 
-    //! Remove a controller input listener.
+    //! Remove a controller input listener. Safe to call from inside a callback.
     virtual void removeListener( ControllerListener* listener );
 
+    //! Remove a controller input listener by the token it was added with.
+    virtual void removeListener( ListenerToken token );
+
     void update() override = 0;
 
+    void publishSnapshot() override;
+
     //! Get the Controller type.
     virtual Type getType() const;
 
     //! Get the Controller state.
     virtual const ControllerState& getState() const;
+
+    //! Get the Controller state as of the latest update, without locking.
+    //! Zeroed until the first update. Call on the update thread, or while
+    //! the Controller is sure to stay alive; other threads use getSnapshotSource.
+    virtual ControllerSnapshot getSnapshot() const;
+
+    //! Get the block the state is published through after each update.
+    //! Take it once, on enable; it can then be loaded from any thread, without
+    //! locking, for as long as it's held. Once the Controller is gone, it keeps
+    //! the final state.
+    virtual ControllerSnapshotSource getSnapshotSource() const;
   };
 
   using ControllerPtr = shared_ptr<Controller>;
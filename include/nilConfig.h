@@ -2,6 +2,8 @@
 
 #ifdef _MSC_VER
 # define NIL_PLATFORM_WINDOWS
+#elif defined( __linux__ )
+# define NIL_PLATFORM_LINUX
 #else
 # error Unknown platform!
 #endif
@@ -26,4 +28,26 @@
 # define DIRECTINPUT_VERSION 0x0800
 # include <dinput.h>
 # include <xinput.h>
+#endif
+
+#ifdef NIL_PLATFORM_LINUX
+# include <cstdlib>
+# include <cstdio>
+# include <cstring>
+# include <cerrno>
+# include <cassert>
+# include <cwchar>
+# include <cwctype>
+
+# include <unistd.h>
+# include <fcntl.h>
+# include <dirent.h>
+# include <sys/ioctl.h>
+# include <sys/epoll.h>
+# include <sys/inotify.h>
+# include <sys/mman.h>
+# include <sys/eventfd.h>
+# include <sys/stat.h>
+# include <linux/input.h>
+# include <linux/hidraw.h>
 #endif
\ No newline at end of file
@@ -0,0 +1,246 @@
+#pragma once
+#include "nilConfig.h"
+
+#include "nilTypes.h"
+#include "nilComponents.h"
+#include "nilCommon.h"
+
+namespace nil {
+
+  //! \addtogroup Nil
+  //! @{
+
+  //! \addtogroup Events
+  //! @{
+
+  //! Event types.
+  enum EventType: uint16_t
+  {
+    Event_MouseMove = 0, //!< Mouse moved; movement is set
+    Event_MouseButton, //!< Mouse button pressed or released; index & pushed are set
+    Event_MouseWheel, //!< Mouse wheel moved; wheel is set
+    Event_KeyPressed, //!< Key pressed; index is the key code
+    Event_KeyRepeat, //!< Key repeated; index is the key code
+    Event_KeyReleased, //!< Key released; index is the key code
+    Event_ControllerButton, //!< Controller button pressed or released; index & pushed are set
+    Event_ControllerAxis, //!< Controller axis moved; index & axis are set
+    Event_ControllerSlider, //!< Controller slider moved; index & slider are set
+    Event_ControllerPOV //!< Controller POV moved; index & direction are set
+  };
+
+  //! \struct Event
+  //! A single input event, as returned by System::pollEvents.
+  //! Plain old data; 32 bytes, two to a cache line.
+  struct Event
+  {
+    //! Plain integer pair, since Vector2i can't live in a union.
+    struct IntPair {
+      int32_t x;
+      int32_t y;
+    };
+    //! Plain real number pair, since Vector2f can't live in a union.
+    struct RealPair {
+      Real x;
+      Real y;
+    };
+    Timestamp timestamp; //!< When the input happened
+    DeviceID device; //!< Session-specific ID of the source device
+    EventType type; //!< What happened
+    uint32_t index; //!< Component index, or key code for key events
+    union {
+      IntPair movement; //!< Relative mouse movement
+      int32_t wheel; //!< Relative wheel movement
+      bool pushed; //!< New button state
+      Real axis; //!< New axis value
+      RealPair slider; //!< New slider value
+      POVDirection direction; //!< New POV direction
+    };
+  };
+
+  inline Event DeviceInstance::makeEvent( EventType type, uint32_t index ) const
+  {
+    Event event {};
+    event.timestamp = timestamp_;
+    event.device = device_->id_;
+    event.type = type;
+    event.index = index;
+    return event;
+  }
+
+  //! \struct EventSink
+  //! Where the instances of a System hand events to its event handler:
+  //! the handler, and a plain function made for its type that calls it.
+  //! \sa System::setEventHandler
+  struct EventSink
+  {
+    void* target = nullptr; //!< The handler
+    void ( *function )( void* target, const Event& event ) = nullptr; //!< Calls the handler
+    //! Query if there is a handler.
+    inline explicit operator bool() const { return ( function != nullptr ); }
+    //! Hand an event to the handler.
+    inline void operator()( const Event& event ) const { function( target, event ); }
+  };
+
+  //! \class EventQueue
+  //! Preallocated ring of events, filled from the instances of a System.
+  //! Once full, further events are dropped until there's room again.
+  //! \sa System::enableEventQueue
+  class EventQueue: public MouseListener, public KeyboardListener, public ControllerListener {
+  private:
+    vector<Event> events_; //!< Ring storage, a power of two in size
+    size_t mask_; //!< Index mask for the ring
+    size_t head_ = 0; //!< Running count of events read
+    size_t tail_ = 0; //!< Running count of events written
+    size_t dropped_ = 0; //!< Events dropped for lack of room
+
+    //! \b Internal Claim the next slot, or nullptr if full.
+    Event* push( DeviceInstance* instance, EventType type, uint32_t index );
+  public:
+    //! Constructor.
+    //! \param capacity Minimum number of events to hold; rounded up to a power of two.
+    explicit EventQueue( size_t capacity );
+
+    //! Move queued events out, oldest first.
+    //! \param events Where to put them.
+    //! \return Number of events written.
+    size_t poll( std::span<Event> events );
+
+    //! Get the number of queued events.
+    size_t size() const;
+
+    //! Get the number of events held at most.
+    size_t capacity() const;
+
+    //! Get the number of events dropped so far because the queue was full.
+    size_t dropped() const;
+
+    void onMouseMoved( Mouse* mouse, const MouseState& state ) override;
+    void onMouseButtonPressed( Mouse* mouse, const MouseState& state, size_t button ) override;
+    void onMouseButtonReleased( Mouse* mouse, const MouseState& state, size_t button ) override;
+    void onMouseWheelMoved( Mouse* mouse, const MouseState& state ) override;
+    void onKeyPressed( Keyboard* keyboard, const VirtualKeyCode keycode ) override;
+    void onKeyRepeat( Keyboard* keyboard, const VirtualKeyCode keycode ) override;
+    void onKeyReleased( Keyboard* keyboard, const VirtualKeyCode keycode ) override;
+    void onControllerButtonPressed( Controller* controller, const ControllerState& state, size_t button ) override;
+    void onControllerButtonReleased( Controller* controller, const ControllerState& state, size_t button ) override;
+    void onControllerAxisMoved( Controller* controller, const ControllerState& state, size_t axis ) override;
+    void onControllerSliderMoved( Controller* controller, const ControllerState& state, size_t slider ) override;
+    void onControllerPOVMoved( Controller* controller, const ControllerState& state, size_t pov ) override;
+  };
+
+  // Calls the handler method, if the handler has one by that name
+# define NIL_DISPATCH_EVENT( method ) \
+  if constexpr ( requires { handler.method( event ); } ) \
+    handler.method( event );
+
+  //! Hand an event to the matching method of a handler, resolved at compile time.
+  //! Methods the handler lacks are skipped; see System::setEventHandler for the names.
+  template <class Handler>
+  inline void dispatchEvent( Handler& handler, const Event& event )
+  {
+    switch ( event.type )
+    {
+      case Event_MouseMove:
+        NIL_DISPATCH_EVENT( onMouseMoved )
+      break;
+      case Event_MouseButton:
+        if ( event.pushed )
+        {
+          NIL_DISPATCH_EVENT( onMouseButtonPressed )
+        }
+        else
+        {
+          NIL_DISPATCH_EVENT( onMouseButtonReleased )
+        }
+      break;
+      case Event_MouseWheel:
+        NIL_DISPATCH_EVENT( onMouseWheelMoved )
+      break;
+      case Event_KeyPressed:
+        NIL_DISPATCH_EVENT( onKeyPressed )
+      break;
+      case Event_KeyRepeat:
+        NIL_DISPATCH_EVENT( onKeyRepeat )
+      break;
+      case Event_KeyReleased:
+        NIL_DISPATCH_EVENT( onKeyReleased )
+      break;
+      case Event_ControllerButton:
+        if ( event.pushed )
+        {
+          NIL_DISPATCH_EVENT( onControllerButtonPressed )
+        }
+        else
+        {
+          NIL_DISPATCH_EVENT( onControllerButtonReleased )
+        }
+      break;
+      case Event_ControllerAxis:
+        NIL_DISPATCH_EVENT( onControllerAxisMoved )
+      break;
+      case Event_ControllerSlider:
+        NIL_DISPATCH_EVENT( onControllerSliderMoved )
+      break;
+      case Event_ControllerPOV:
+        NIL_DISPATCH_EVENT( onControllerPOVMoved )
+      break;
+    }
+  }
+
+# undef NIL_DISPATCH_EVENT
+
+  //! \class PacketRing
+  //! Lock-free ring of variable-length packets, for handing raw input over
+  //! from exactly one producer thread to exactly one consumer thread.
+  //! Neither side ever blocks; a full ring simply refuses more packets.
+  //! \sa System::enableInputThread
+  class PacketRing {
+  public:
+    //! \struct Packet
+    //! Packet header. The payload follows right after it.
+    struct Packet
+    {
+      uint64_t source; //!< Producer-defined packet source
+      Timestamp timestamp; //!< When the payload was read
+      uint32_t length; //!< Payload length in bytes
+      int32_t error; //!< Error code, if this reports a failure instead
+      uint32_t slots; //!< Ring slots taken, header included
+      uint32_t reserved;
+      //! Get the payload.
+      inline const uint8_t* data() const { return reinterpret_cast<const uint8_t*>( this + 1 ); }
+    };
+  private:
+    // Each side's index lives a cache line away from the other's,
+    // so that neither thread's writes keep stealing the other's line.
+    vector<Packet> slots_; //!< Ring storage, in header-sized slots; a power of two in count
+    size_t mask_; //!< Index mask for the ring
+    uint8_t padding0_[c_cacheLineSize];
+    std::atomic<size_t> head_ = 0; //!< Running count of slots read
+    size_t cachedTail_ = 0; //!< Consumer's last look at tail_
+    uint8_t padding1_[c_cacheLineSize - sizeof( size_t ) * 2];
+    std::atomic<size_t> tail_ = 0; //!< Running count of slots written
+    size_t cachedHead_ = 0; //!< Producer's last look at head_
+    uint8_t padding2_[c_cacheLineSize - sizeof( size_t ) * 2];
+  public:
+    //! Constructor.
+    //! \param capacity Minimum number of bytes to hold, headers included; rounded up to a power of two.
+    explicit PacketRing( size_t capacity );
+
+    //! Producer side. Append a packet.
+    //! A packet may take up at most half of the ring.
+    //! \return false if there is no room for it right now.
+    bool write( uint64_t source, Timestamp timestamp, const void* data, size_t length, int32_t error = 0 );
+
+    //! Consumer side. Get the oldest packet, or nullptr if empty.
+    //! It stays valid until pop().
+    const Packet* front();
+
+    //! Consumer side. Discard the packet returned by front().
+    void pop();
+  };
+
+  //! @}
+
+  //! @}
+
+}
\ No newline at end of file
@@ -14,6 +14,12 @@ namespace nil {
     wideString description;
   };
 
+  struct POSIXError
+  {
+    int code;
+    utf8String description;
+  };
+
   //! \class Exception
   //! Main Nil exception class.
   //! \sa std::exception
@@ -24,7 +30,8 @@ namespace nil {
     {
       Generic = 0,  //!< An enum constant representing the generic option
       WinAPI, //!< Windows API-specific error
-      DirectInput //!< DirectInput-specific error
+      DirectInput, //!< DirectInput-specific error
+      POSIX //!< POSIX/Linux system call error
     };
   private:
     Exception() = default;
@@ -33,10 +40,15 @@ namespace nil {
     Type type_; //!< Exception type
     utf8String source_; //!< Exception source
     mutable utf8String fullDescription_; //!< Full, extended description
-    variant<WinAPIError> additional_; //!< \b Internal Additional exception data
+    variant<WinAPIError, POSIXError> additional_; //!< \b Internal Additional exception data
 
+#ifdef NIL_PLATFORM_WINDOWS
     //! \b Internal Handle additional exception data for WinAPI/DI exceptions.
     void handleAdditional( HRESULT hr = 0 );
+#else
+    //! \b Internal Handle additional exception data for POSIX exceptions.
+    void handleAdditional();
+#endif
   public:
     //! Generic constructor.
     Exception( const utf8String& description, Type type = Generic );
@@ -45,9 +57,11 @@ namespace nil {
     Exception( const utf8String& description, const utf8String& source,
       Type type = Generic );
 
+#ifdef NIL_PLATFORM_WINDOWS
     //! Constructor with source and a WinAPI/DirectInput error code.
     Exception( const utf8String& description, const utf8String& source,
       HRESULT hr, Type type = Generic );
+#endif
 
     //! Get the full, extended description of the exception.
     virtual const utf8String& getFullDescription() const;
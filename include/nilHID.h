@@ -0,0 +1,46 @@
+#pragma once
+#include "nilConfig.h"
+
+#include "nilTypes.h"
+#include "nilCommon.h"
+#include "nilPredefs.h"
+
+namespace nil {
+
+  //! \addtogroup Nil
+  //! @{
+
+  //! \namespace hid
+  //! Platform-neutral handling of known HID devices and their raw reports.
+  //! Fed by whichever transport a platform has; Raw Input on Windows, hidraw on Linux.
+  namespace hid {
+
+    //! Full DualSense input report length over USB, including the report ID.
+    const size_t c_dualSenseUSBReportLength = 64;
+
+    //! Full DualSense input report length over Bluetooth (report 0x31), including the report ID.
+    const size_t c_dualSenseBluetoothReportLength = 78;
+
+    //! Find a known device record by USB vendor & product IDs.
+    //! \return The record, or nullptr if we know nothing special about the device.
+    const KnownDeviceRecord* resolveKnownDevice( uint16_t vid, uint16_t pid );
+
+    //! Does the given known device type have a report parser?
+    bool hasReportParser( KnownDeviceType type );
+
+    //! Size a controller state for DualSense reports.
+    void setupDualSense( ControllerState& state );
+
+    //! Parse a DualSense input report straight into a controller state.
+    //! \param  report     The report, starting with the report ID.
+    //! \param  length     Length of the report in bytes.
+    //! \param  connection How the controller is connected, which decides the layout.
+    //! \param  state      State to update, as set up by setupDualSense.
+    //! \return false if this was not a full input report, leaving state untouched.
+    bool parseDualSense( const uint8_t* report, size_t length, HIDConnectionType connection, ControllerState& state );
+
+  }
+
+  //! @}
+
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+#include "nilConfig.h"
+
+#include "nilTypes.h"
+#include "nilCommon.h"
+
+namespace nil {
+
+  //! \addtogroup Nil
+  //! @{
+
+  //! \addtogroup Keyboard
+  //! @{
+
+  using HotkeyID = uint32_t; //!< A registered hotkey. Never 0.
+
+  //! Modifier keys, for chords. Either side's key counts.
+  enum Modifier: uint32_t
+  {
+    Modifier_None = 0, //!< No modifiers
+    Modifier_Control = 1 << 0, //!< Left or right Control
+    Modifier_Shift = 1 << 1, //!< Left or right Shift
+    Modifier_Alt = 1 << 2, //!< Left or right Alt
+    Modifier_Super = 1 << 3 //!< Left or right Windows key
+  };
+
+  //! \struct Chord
+  //! A key pressed while holding down exactly the given modifiers,
+  //! such as Chord { Modifier_Control | Modifier_Shift, 0x7B } for Ctrl+Shift+F12.
+  struct Chord
+  {
+    uint32_t modifiers = Modifier_None; //!< Modifiers held down, as Modifier flags
+    VirtualKeyCode key = Keyboard::Key_Invalid; //!< The key pressed, which is not a modifier itself
+  };
+
+  //! \class HotkeyListener
+  //! Hotkey listener base class.
+  //! Derive your own listener from this class.
+  class HotkeyListener {
+  public:
+    //! Called when a hotkey is matched.
+    //! \param keyboard The keyboard its final chord was pressed on.
+    //! \param hotkey The hotkey, as returned on registration.
+    virtual void onHotkey( Keyboard* keyboard, HotkeyID hotkey ) = 0;
+  };
+
+  //! \class HotkeyRegistry
+  //! Hotkeys matched as keys are pressed, whether single chords such as
+  //! Ctrl+Shift+F12 or sequences of them such as Ctrl+K, Ctrl+C.
+  //! Chords are kept in a hash keyed by modifiers & key, so that matching a
+  //! key press costs one lookup however many hotkeys there are.
+  //! Add it as a listener to the keyboards it should watch, from
+  //! SystemListener::onKeyboardEnabled for example; key repeats never match.
+  class HotkeyRegistry: public KeyboardListener {
+  public:
+    //! Default time allowed between the chords of a sequence: one second.
+    static const Timestamp c_defaultSequenceTimeout = 1000000000;
+  private:
+    //! A chord within a sequence, or a whole hotkey.
+    struct Node {
+      HotkeyID hotkey = 0; //!< The hotkey ending here, or 0
+      uint32_t parent = 0; //!< The node before, 0 being the start
+      uint64_t edge = 0; //!< My key in edges_
+      size_t children = 0; //!< Number of chords that can follow
+    };
+    //! A keyboard partway through a sequence.
+    struct Pending {
+      const Keyboard* keyboard; //!< The keyboard
+      uint32_t node; //!< The sequence matched so far
+      Timestamp time; //!< When the latest chord of that sequence was pressed
+    };
+    HotkeyListener* listener_; //!< The listener
+    vector<Node> nodes_; //!< Chords, the first being the start of every hotkey
+    vector<uint32_t> freeNodes_; //!< Unused chords, for reuse
+    std::unordered_map<uint64_t, uint32_t> edges_; //!< Chords by the node before, modifiers & key
+    std::unordered_map<HotkeyID, uint32_t> hotkeys_; //!< Final chords by hotkey
+    HotkeyID nextID_ = 1; //!< ID for the next hotkey
+    vector<Pending> pending_; //!< Keyboards partway through a sequence, each on its own
+    Timestamp sequenceTimeout_ = c_defaultSequenceTimeout; //!< Time allowed between chords
+
+    //! Make a key into edges_.
+    static uint64_t makeEdge( uint32_t node, const Chord& chord );
+
+    //! Find the chord following a node.
+    //! \return The chord, or 0 if there is none.
+    uint32_t findNode( uint32_t node, const Chord& chord ) const;
+  public:
+    //! Constructor.
+    //! \param listener The listener to call for matched hotkeys.
+    explicit HotkeyRegistry( HotkeyListener* listener );
+
+    //! Register a hotkey of one chord.
+    //! \return The hotkey.
+    HotkeyID add( const Chord& chord );
+
+    //! Register a hotkey of a sequence of chords, pressed one after another.
+    //! No hotkey may be the start of another.
+    //! \return The hotkey.
+    HotkeyID add( std::span<const Chord> sequence );
+
+    //! Unregister a hotkey. Safe to call from inside a callback.
+    void remove( HotkeyID hotkey );
+
+    //! Unregister every hotkey.
+    void clear();
+
+    //! Get the number of hotkeys registered.
+    size_t size() const;
+
+    //! Set the time allowed between the chords of a sequence, after which it starts over.
+    void setSequenceTimeout( Timestamp timeout );
+
+    //! Get the modifiers a keyboard has held down.
+    //! \return Modifier flags.
+    static uint32_t getModifiers( const Keyboard* keyboard );
+
+    //! Query if a key is a modifier, which never ends a chord.
+    static bool isModifierKey( VirtualKeyCode key );
+
+    void onKeyPressed( Keyboard* keyboard, const VirtualKeyCode keycode ) override;
+    void onKeyRepeat( Keyboard* keyboard, const VirtualKeyCode keycode ) override;
+    void onKeyReleased( Keyboard* keyboard, const VirtualKeyCode keycode ) override;
+  };
+
+  //! @}
+
+  //! @}
+
+}
\ No newline at end of file
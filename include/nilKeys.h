@@ -0,0 +1,54 @@
+#pragma once
+#include "nilConfig.h"
+
+#include "nilTypes.h"
+#include "nilCommon.h"
+
+namespace nil {
+
+  //! \addtogroup Nil
+  //! @{
+
+  //! \namespace keys
+  //! Platform-neutral key code translation, shared by the keyboard backends.
+  //! Every backend reports Windows virtual key codes, telling apart left &
+  //! right modifiers and the numpad as Keyboard::KeyCode does.
+  namespace keys {
+
+    //! Scan code prefixes, as sent by keyboards ahead of extended keys.
+    enum ScanCodePrefix: int
+    {
+      Prefix_None = 0, //!< A plain key
+      Prefix_E0, //!< An extended key, such as the right-hand modifiers and the arrows
+      Prefix_E1 //!< Pause, the only key sent with an E1 prefix
+    };
+
+    //! Number of set 1 scan codes, without the prefix.
+    const size_t c_scanCodeCount = 0x80;
+
+    //! Number of Linux evdev key codes that are translated; the rest never map to anything.
+    const size_t c_evdevCodeCount = 0x100;
+
+    //! Translate a set 1 scan code to a key code by the position of the key,
+    //! as labeled on a US layout.
+    //! \param scanCode The scan code, without the prefix.
+    //! \param prefix The prefix it came with.
+    //! \return The key code, or Keyboard::Key_Invalid for keys we don't report.
+    VirtualKeyCode translateScanCode( unsigned int scanCode, ScanCodePrefix prefix );
+
+    //! Translate a Linux evdev key code to a key code.
+    //! Evdev codes are positional, so these too are as labeled on a US layout.
+    //! \param code The evdev key code, KEY_*.
+    //! \return The key code, or Keyboard::Key_Invalid for keys we don't report.
+    VirtualKeyCode translateEvdevCode( unsigned int code );
+
+    //! Query if a key code is for a key that sits in the same place on every layout:
+    //! the modifiers and the numpad. For these, translating the scan code is
+    //! both right and more telling than the layout's own virtual key code.
+    bool isLayoutIndependent( VirtualKeyCode key );
+
+  }
+
+  //! @}
+
+}
\ No newline at end of file
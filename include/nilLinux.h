@@ -0,0 +1,507 @@
+#pragma once
+#include "nilConfig.h"
+
+#include "nilTypes.h"
+#include "nilComponents.h"
+#include "nilException.h"
+#include "nilCommon.h"
+#include "nilPredefs.h"
+
+#ifdef NIL_PLATFORM_LINUX
+
+namespace nil {
+
+  //! \addtogroup Nil
+  //! @{
+
+  class System;
+  class DeviceInstance;
+  class PacketRing;
+
+  class Mouse;
+  class Keyboard;
+  class Controller;
+
+  namespace posix {
+
+    //! \class EvdevListener
+    //! Evdev input event listener base class.
+    class EvdevListener {
+    public:
+      //! A batch of input events was read from the device node.
+      virtual void onEvdevInput( const input_event* events, size_t count ) = 0;
+
+      //! Reading the device node failed, usually because it was unplugged.
+      virtual void onEvdevError( int error ) = 0;
+    };
+
+    using EvdevListenerPtr = EvdevListener*;
+
+    //! \class HidrawListener
+    //! Hidraw input report listener base class.
+    class HidrawListener {
+    public:
+      //! Input reports were read from the device node.
+      //! A real hidraw node hands over one report per read,
+      //! but a stand-in such as a pipe may deliver several at once.
+      //! \param timestamp When the read happened, as reports carry no time of their own.
+      virtual void onHidrawInput( const uint8_t* data, size_t length, Timestamp timestamp ) = 0;
+
+      //! Reading the device node failed, usually because it was unplugged.
+      virtual void onHidrawError( int error ) = 0;
+    };
+
+    using HidrawListenerPtr = HidrawListener*;
+
+    //! \class HotplugListener
+    //! Input device node hotplug listener base class.
+    class HotplugListener {
+    public:
+      //! An event node appeared, or became accessible to us.
+      virtual void onHotplugArrival( const utf8String& path ) = 0;
+
+      //! An event node was removed.
+      virtual void onHotplugRemoval( const utf8String& path ) = 0;
+    };
+
+    using HotplugListenerPtr = HotplugListener*;
+
+    //! A list of hotplug event listeners.
+    using HotplugListenerList = list<HotplugListenerPtr>;
+
+    //! \class EventMonitor
+    //! Waits on all opened input device nodes through a single epoll set,
+    //! and drains each ready node with as few reads as possible.
+    //! Also watches the input directory with inotify, so that hotplugging
+    //! reports exactly the nodes that came or went.
+    //! Optionally, the nodes are read on a thread of our own instead,
+    //! with the data handed back to update() through a PacketRing.
+    class EventMonitor {
+    protected:
+      int epoll_ = -1; //!< Our epoll instance
+      int inotify_ = -1; //!< Our inotify instance, for the input directory
+      int inputWatch_ = -1; //!< Watch for the evdev input directory
+      int deviceWatch_ = -1; //!< Watch for the device directory, where hidraw nodes live
+      int wakeEvent_ = -1; //!< Eventfd for waking the input thread up
+      //! A watched device descriptor.
+      struct Registration {
+        uint64_t key; //!< Epoll key, unique per registration
+        EvdevListenerPtr evdev; //!< Listener, if an evdev node
+        HidrawListenerPtr hidraw; //!< Listener, if a hidraw node
+      };
+      HandleTable<Registration> registrations_; //!< Watched device descriptors, by descriptor
+      uint32_t keySerial_ = 0; //!< Serial of the latest registration
+      HotplugListenerList hotplugListeners_; //!< Our hotplug listeners
+      vector<epoll_event> readyEvents_; //!< Buffer for epoll results
+      vector<input_event> inputBuffer_; //!< Buffer for input reads
+      vector<uint8_t> reportBuffer_; //!< Buffer for hidraw report reads
+      unique_ptr<PacketRing> ring_; //!< Data read by the input thread, if running
+      std::thread thread_; //!< The input thread, if running
+      std::atomic<bool> stopping_ = false; //!< Is the input thread told to stop?
+      std::mutex closeLock_; //!< Guards pendingCloses_
+      vector<int> pendingCloses_; //!< Descriptors for the input thread to close
+
+      //! \b Internal Add a descriptor to our epoll set.
+      void watchDescriptor( int fd, uint64_t key );
+
+      //! \b Internal Input thread body: read ready nodes into the ring until stopped.
+      void threadMain();
+
+      //! \b Internal Input thread: read everything pending on a ready descriptor into the ring.
+      //! \return false if the node failed, and must not be read again.
+      bool readIntoRing( int fd, uint64_t key, vector<input_event>& buffer );
+
+      //! \b Internal Close descriptors whose closing was handed to the input thread.
+      //! \return The descriptors closed.
+      vector<int> closePending();
+
+      //! \b Internal Input thread: append a packet to the ring, waiting for room if need be.
+      void publish( uint64_t key, const void* data, size_t length, int32_t error );
+
+      //! \b Internal Stop & join the input thread, if running.
+      void joinThread();
+
+      //! \b Internal Hand packets read by the input thread to their listeners.
+      void dispatchPackets();
+
+      //! \b Internal Read everything pending on a ready descriptor.
+      void drain( int fd, EvdevListenerPtr listener );
+
+      //! \b Internal Read every pending report on a ready hidraw descriptor.
+      void drainReports( int fd, HidrawListenerPtr listener );
+
+      //! \b Internal Read & dispatch pending inotify events.
+      void handleNotifications();
+
+      //! \b Internal Handle node arrival.
+      void handleNodeArrival( const utf8String& path );
+
+      //! \b Internal Handle node removal.
+      void handleNodeRemoval( const utf8String& path );
+    public:
+      EventMonitor();
+
+      //! Register a listener for hotplug events.
+      void registerHotplugListener( HotplugListenerPtr listener );
+
+      //! Unregister a listener from hotplug events.
+      void unregisterHotplugListener( HotplugListenerPtr listener );
+
+      //! Start watching an evdev node descriptor for input.
+      void registerListener( int fd, EvdevListenerPtr listener );
+
+      //! Start watching a hidraw node descriptor for input reports.
+      void registerListener( int fd, HidrawListenerPtr listener );
+
+      //! Stop watching a device node descriptor.
+      void unregisterListener( int fd );
+
+      //! Stop watching a device node descriptor, and close it.
+      //! While the input thread runs, it does the closing, as it may
+      //! still be reading the descriptor.
+      void closeListener( int fd );
+
+      //! Start reading device nodes on a thread of our own.
+      //! Listeners are still only called from update().
+      //! \param bufferSize Bytes of input to hold between updates.
+      void startThread( size_t bufferSize );
+
+      //! Stop the input thread, handing over whatever it had already read.
+      void stopThread();
+
+      //! Are device nodes being read on our own thread?
+      bool isThreaded() const;
+
+      //! Update the EventMonitor, triggering new events.
+      void update();
+
+      ~EventMonitor();
+    };
+
+    //! \class DeviceNode
+    //! An open device node, watched by an EventMonitor for as long as it lives.
+    class DeviceNode {
+    private:
+      int fd_ = -1; //!< The node descriptor
+      EventMonitor* monitor_; //!< The monitor we're registered with
+    public:
+      //! Constructor.
+      //! \param monitor  The monitor to register with.
+      //! \param path     Device node path.
+      //! \param listener Listener for the node's input.
+      DeviceNode( EventMonitor* monitor, const utf8String& path, EvdevListenerPtr listener );
+
+      //! Constructor.
+      //! \param monitor  The monitor to register with.
+      //! \param path     Device node path.
+      //! \param listener Listener for the node's input reports.
+      DeviceNode( EventMonitor* monitor, const utf8String& path, HidrawListenerPtr listener );
+      DeviceNode( const DeviceNode& ) = delete;
+      DeviceNode& operator = ( const DeviceNode& ) = delete;
+
+      //! Get the node descriptor, for ioctls.
+      int getDescriptor() const;
+
+      ~DeviceNode();
+    };
+
+  }
+
+  //! \class EvdevDeviceInfo
+  //! Identity and capabilities of an evdev device node, as reported by the kernel.
+  class EvdevDeviceInfo {
+  protected:
+    input_id inputId_ = {}; //!< Bus type, vendor, product & version
+    utf8String deviceName_; //!< Name reported by the driver
+    utf8String physPath_; //!< Physical topology path, if any
+    uint8_t evBits_[EV_MAX / 8 + 1] = {}; //!< Supported event types
+    uint8_t keyBits_[KEY_MAX / 8 + 1] = {}; //!< Supported keys & buttons
+    uint8_t relBits_[REL_MAX / 8 + 1] = {}; //!< Supported relative axes
+    uint8_t absBits_[ABS_MAX / 8 + 1] = {}; //!< Supported absolute axes
+  public:
+    //! Constructor.
+    //! \param fd Descriptor of the opened device node.
+    explicit EvdevDeviceInfo( int fd );
+
+    //! Does the node report the given event type?
+    bool hasEventType( unsigned int type ) const;
+
+    //! Does the node report the given key or button code?
+    bool hasKey( unsigned int code ) const;
+
+    //! Does the node report the given relative axis?
+    bool hasRelative( unsigned int code ) const;
+
+    //! Does the node report the given absolute axis?
+    bool hasAbsolute( unsigned int code ) const;
+
+    //! Figure out which kind of device this is, if any that we support.
+    //! \return false if the node is something we cannot handle.
+    bool resolveType( Device::Type& type ) const;
+
+    //! Get the kernel's input identifier.
+    const input_id& getInputID() const;
+
+    //! Get the physical topology path. Can be empty.
+    const utf8String& getPhysPath() const;
+
+    //! Does this describe the same physical device as another node did?
+    //! Nodes without a physical path never match, since there's no telling.
+    bool isSameDevice( const EvdevDeviceInfo& other ) const;
+
+    virtual ~EvdevDeviceInfo();
+  };
+
+  //! \struct EvdevNode
+  //! An input device node we support, as found by probing it.
+  struct EvdevNode {
+    utf8String path; //!< Node path, such as /dev/input/event3
+    EvdevDeviceInfo info; //!< What the kernel says about the node
+  };
+
+  //! \class EvdevDevice
+  //! Device abstraction base class for Linux evdev devices.
+  //! \sa EvdevDeviceInfo
+  //! \sa Device
+  class EvdevDevice: public EvdevDeviceInfo, public Device, public std::enable_shared_from_this<EvdevDevice> {
+  friend class System;
+  private:
+    utf8String nodePath_; //!< Device node path, such as /dev/input/event3
+
+    //! \b Internal Move to the node a replugged device came back at.
+    void setNode( const utf8String& nodePath, const EvdevDeviceInfo& info );
+
+    //! \b Internal Resolve the device type, failing for unsupported nodes.
+    Device::Type evdevResolveType() const;
+  public:
+    EvdevDevice( System* system, DeviceID id, const utf8String& nodePath, const EvdevDeviceInfo& info );
+
+    Handler getHandler() const override;
+    DeviceID getStaticID() const override;
+    shared_ptr<Device> ptr() override { return dynamic_pointer_cast<Device>( shared_from_this() ); }
+
+    //! Get the device node path.
+    virtual const utf8String& getNodePath() const;
+  };
+
+  using EvdevDevicePtr = shared_ptr<EvdevDevice>;
+
+  //! \struct HidrawNode
+  //! A hidraw node of a known device we have a parser for, as found by probing it.
+  struct HidrawNode {
+    utf8String path; //!< Node path, such as /dev/hidraw2
+    hidraw_devinfo info; //!< Bus type, vendor & product
+    utf8String physPath; //!< Physical topology path, if any
+    const KnownDeviceRecord* knownDevice; //!< What we know about the device
+  };
+
+  //! \class HidrawDevice
+  //! Device abstraction base class for known HID devices read through Linux hidraw.
+  //! \sa Device
+  class HidrawDevice: public Device, public std::enable_shared_from_this<HidrawDevice> {
+  friend class System;
+  private:
+    utf8String nodePath_; //!< Device node path, such as /dev/hidraw2
+    utf8String physPath_; //!< Physical topology path, shared with the device's evdev nodes
+    hidraw_devinfo info_; //!< Bus type, vendor & product
+    const KnownDeviceRecord* knownDevice_; //!< What we know about the device
+
+    //! \b Internal Move to the node a replugged device came back at.
+    void setNode( const utf8String& nodePath );
+  public:
+    HidrawDevice( System* system, DeviceID id, const utf8String& nodePath,
+      const hidraw_devinfo& info, const utf8String& physPath, const KnownDeviceRecord* knownDevice );
+
+    Handler getHandler() const override;
+    DeviceID getStaticID() const override;
+    shared_ptr<Device> ptr() override { return dynamic_pointer_cast<Device>( shared_from_this() ); }
+
+    //! Get the device node path.
+    virtual const utf8String& getNodePath() const;
+
+    //! Get the physical topology path.
+    virtual const utf8String& getPhysPath() const;
+
+    //! Get the kernel's device information.
+    virtual const hidraw_devinfo& getInfo() const;
+
+    //! Get the known device type.
+    virtual KnownDeviceType knownDeviceType() const;
+
+    //! Get the connection type.
+    virtual HIDConnectionType connectionType() const;
+  };
+
+  using HidrawDevicePtr = shared_ptr<HidrawDevice>;
+
+  //! \addtogroup Mouse
+  //! @{
+
+  //! \class EvdevMouse
+  //! Mouse implemented by Linux evdev.
+  //! \sa Mouse
+  class EvdevMouse: public Mouse, public posix::EvdevListener, public std::enable_shared_from_this<EvdevMouse> {
+  private:
+    unique_ptr<posix::DeviceNode> node_; //!< Our device node
+    bool hiResWheel_ = false; //!< Whether the wheel reports in 120ths of a notch
+    Vector2i pendingMovement_; //!< Movement accumulated for the current packet
+    int pendingWheel_ = 0; //!< Wheel rotation accumulated for the current packet
+    uint32_t pendingButtons_ = 0; //!< Buttons changed during the current packet
+    bool dropped_ = false; //!< Whether the kernel dropped events and we must resync
+
+    //! Translate an evdev button code to our button index, or -1.
+    inline int translateButton( unsigned int code ) const;
+
+    //! Fire events for the accumulated packet.
+    void flushPacket();
+
+    //! Re-read button state from the kernel after dropped events.
+    void resync();
+
+    void onEvdevInput( const input_event* events, size_t count ) override;
+    void onEvdevError( int error ) override;
+  public:
+    //! Constructor.
+    //! \param device The device.
+    //! \param swapButtons Whether to swap the first & second buttons.
+    EvdevMouse( EvdevDevicePtr device, const bool swapButtons );
+
+    void update() override;
+
+    shared_ptr<DeviceInstance> ptr() override { return dynamic_pointer_cast<DeviceInstance>( shared_from_this() ); }
+
+    //! Destructor.
+    virtual ~EvdevMouse();
+  };
+
+  using EvdevMousePtr = shared_ptr<EvdevMouse>;
+
+  //! @}
+
+  //! \addtogroup Keyboard
+  //! @{
+
+  //! \class EvdevKeyboard
+  //! Keyboard implemented by Linux evdev.
+  //! \sa Keyboard
+  class EvdevKeyboard: public Keyboard, public posix::EvdevListener, public std::enable_shared_from_this<EvdevKeyboard> {
+  private:
+    unique_ptr<posix::DeviceNode> node_; //!< Our device node
+    uint8_t keyState_[KEY_MAX / 8 + 1] = {}; //!< Keys we have reported as pressed
+    bool dropped_ = false; //!< Whether the kernel dropped events and we must resync
+
+    //! Handle a single key transition, by evdev key code.
+    void handleKey( unsigned int code, int value );
+
+    //! Re-read key state from the kernel after dropped events.
+    void resync();
+
+    void onEvdevInput( const input_event* events, size_t count ) override;
+    void onEvdevError( int error ) override;
+  public:
+    //! Constructor.
+    //! \param device The device.
+    EvdevKeyboard( EvdevDevicePtr device );
+
+    //! Translate an evdev key code to a virtual key code.
+    //! \param code The evdev key code.
+    //! \return The key code, or Key_Invalid for keys we don't report.
+    static VirtualKeyCode translateKey( unsigned int code );
+
+    void update() override;
+
+    shared_ptr<DeviceInstance> ptr() override { return dynamic_pointer_cast<DeviceInstance>( shared_from_this() ); }
+
+    //! Destructor.
+    virtual ~EvdevKeyboard();
+  };
+
+  using EvdevKeyboardPtr = shared_ptr<EvdevKeyboard>;
+
+  //! @}
+
+  //! \addtogroup Controller
+  //! @{
+
+  //! \class EvdevController
+  //! Game controller implemented by Linux evdev.
+  //! \sa Controller
+  class EvdevController: public Controller, public posix::EvdevListener, public std::enable_shared_from_this<EvdevController> {
+  private:
+    struct AxisMapping {
+      input_absinfo info; //!< Kernel's range information
+      bool trigger; //!< Whether this is a one-sided trigger axis
+    };
+    unique_ptr<posix::DeviceNode> node_; //!< Our device node
+    vector<int> buttonMap_; //!< Evdev key code to button index, -1 if unmapped
+    vector<int> axisMap_; //!< Evdev absolute code to axis mapping index, -1 if unmapped
+    vector<AxisMapping> axes_; //!< Axis mappings
+    vector<Vector2i> hats_; //!< Raw hat switch values per POV
+    ControllerState lastState_; //!< State as of the previous report
+    bool dropped_ = false; //!< Whether the kernel dropped events and we must resync
+
+    //! Filter an absolute axis value.
+    inline Real filterAxis( int val, const AxisMapping& axis );
+
+    //! Apply a single absolute axis event.
+    void handleAbsolute( unsigned int code, int value );
+
+    //! Re-read the whole state from the kernel.
+    void resync();
+
+    void onEvdevInput( const input_event* events, size_t count ) override;
+    void onEvdevError( int error ) override;
+  public:
+    //! Constructor.
+    //! \param device The device.
+    EvdevController( EvdevDevicePtr device );
+
+    void update() override;
+
+    shared_ptr<DeviceInstance> ptr() override { return dynamic_pointer_cast<DeviceInstance>( shared_from_this() ); }
+
+    //! Destructor.
+    virtual ~EvdevController();
+  };
+
+  using EvdevControllerPtr = shared_ptr<EvdevController>;
+
+  //! \class HidrawController
+  //! Known game controller read through Linux hidraw,
+  //! using the same report parsers as every other platform.
+  //! \sa Controller
+  class HidrawController: public Controller, public posix::HidrawListener, public std::enable_shared_from_this<HidrawController> {
+  private:
+    unique_ptr<posix::DeviceNode> node_; //!< Our device node
+    KnownDeviceType devType_ = KnownDevice_Unknown; //!< Which parser to use
+    HIDConnectionType connType_ = HIDConnection_Unknown; //!< Which layout to expect
+    size_t reportLength_ = 0; //!< Length of one full input report
+    ControllerState lastState_; //!< State as of the previous report
+
+    //! Parse a single report and fire changes.
+    void handleReport( const uint8_t* report, size_t length );
+
+    void onHidrawInput( const uint8_t* data, size_t length, Timestamp timestamp ) override;
+    void onHidrawError( int error ) override;
+  public:
+    //! Constructor.
+    //! \param device The device.
+    HidrawController( HidrawDevicePtr device );
+
+    void update() override;
+
+    shared_ptr<DeviceInstance> ptr() override { return dynamic_pointer_cast<DeviceInstance>( shared_from_this() ); }
+
+    //! Destructor.
+    virtual ~HidrawController();
+  };
+
+  using HidrawControllerPtr = shared_ptr<HidrawController>;
+
+  //! @}
+
+  //! @}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+#include "nilConfig.h"
+
+#include "nilTypes.h"
+#include "nilCommon.h"
+
+namespace nil {
+
+  //! \addtogroup Nil
+  //! @{
+
+#ifdef NIL_PLATFORM_WINDOWS
+  using DevicePathKey = wideString; //!< A device path, in its canonical form.
+#else
+  using DevicePathKey = utf8String; //!< A device path, in its canonical form.
+#endif
+
+  //! \class DeviceRegistry
+  //! The devices known to a System, indexed so that none of the lookups
+  //! done on hotplug & enumeration have to walk them all.
+  //! Each backend picks its own keys: a native handle is whatever identifies
+  //! a device to it at the moment, such as a Raw Input HANDLE or an XInput
+  //! user index, and a path is a device path in a canonical form.
+  //! Both are indexed per handler, so different backends never collide.
+  //! Devices are only ever added, never removed; disconnected ones stay known.
+  class DeviceRegistry {
+  public:
+    using NativeHandle = uint64_t; //!< A backend-specific device handle. Never 0.
+
+    //! Number of device handlers.
+    static const size_t c_handlerCount = Device::Handler_Virtual + 1;
+
+    //! \class View
+    //! The devices of one handler, as their concrete type, in order of addition.
+    //! Adding a device of the same handler invalidates it.
+    //! Use as a range: for ( auto device : registry.view<XInputDevice>( Device::Handler_XInput ) )
+    template <class T>
+    class View {
+    private:
+      const vector<Device*>& devices_;
+    public:
+      class iterator {
+      private:
+        vector<Device*>::const_iterator it_;
+      public:
+        inline explicit iterator( vector<Device*>::const_iterator it ): it_( it ) {}
+        inline T* operator * () const { return static_cast<T*>( *it_ ); }
+        inline iterator& operator ++ () { ++it_; return *this; }
+        inline bool operator != ( const iterator& other ) const { return ( it_ != other.it_ ); }
+      };
+      inline explicit View( const vector<Device*>& devices ): devices_( devices ) {}
+      inline iterator begin() const { return iterator( devices_.begin() ); }
+      inline iterator end() const { return iterator( devices_.end() ); }
+      inline size_t size() const { return devices_.size(); }
+    };
+  private:
+    //! The keys a device is currently indexed by.
+    struct Keys {
+      NativeHandle handle = 0;
+      DevicePathKey path;
+    };
+    DeviceList devices_; //!< Every device, in order of addition
+    vector<Device*> handlerDevices_[c_handlerCount]; //!< Devices by handler
+    std::unordered_map<Device*, Keys> keys_; //!< Current keys by device
+    std::unordered_map<NativeHandle, Device*> handles_[c_handlerCount]; //!< Devices by native handle, per handler
+    std::unordered_map<DevicePathKey, Device*> paths_[c_handlerCount]; //!< Devices by path, per handler
+    std::unordered_map<DeviceID, Device*> staticIds_; //!< Devices by static ID, first come first served
+    std::unordered_multimap<uint32_t, Device*> products_; //!< Devices by product key
+  public:
+    //! Make a product key out of USB vendor & product IDs.
+    //! Laid out like DirectInput's product GUID and HIDRecord::getIdentifier.
+    static inline uint32_t makeProductKey( uint16_t vendor, uint16_t product )
+    {
+      return ( ( static_cast<uint32_t>( product ) << 16 ) | vendor );
+    }
+
+    //! Add a device, indexed by handler & static ID.
+    void add( DevicePtr device );
+
+    //! Index a device by a native handle, dropping its previous one.
+    //! Another device holding the same handle loses it.
+    //! \param handle The handle, or 0 to only drop the previous one.
+    void setHandle( Device* device, NativeHandle handle );
+
+    //! Index a device by a path, dropping its previous one.
+    //! Another device holding the same path loses it.
+    //! \param path The path, or an empty one to only drop the previous one.
+    void setPath( Device* device, const DevicePathKey& path );
+
+    //! Index a device by USB vendor & product IDs.
+    void setProduct( Device* device, uint16_t vendor, uint16_t product );
+
+    //! Find a device by native handle.
+    //! \return The device, or nullptr.
+    Device* findByHandle( Device::Handler handler, NativeHandle handle ) const;
+
+    //! Find a device by path.
+    //! \return The device, or nullptr.
+    Device* findByPath( Device::Handler handler, const DevicePathKey& path ) const;
+
+    //! Find a device by static ID. Should two devices share one, the first added is found.
+    //! \return The device, or nullptr.
+    Device* findByStaticID( DeviceID id ) const;
+
+    //! Find every device with the given USB vendor & product IDs, in no particular order.
+    vector<Device*> findByProduct( uint16_t vendor, uint16_t product ) const;
+
+    //! Get the devices of one handler as their concrete type.
+    //! \tparam T The device class the handler uses.
+    template <class T>
+    inline View<T> view( Device::Handler handler ) const
+    {
+      return View<T>( handlerDevices_[handler] );
+    }
+
+    //! Get every device, in order of addition.
+    inline DeviceList& getDevices() { return devices_; }
+    inline DeviceList::iterator begin() { return devices_.begin(); }
+    inline DeviceList::iterator end() { return devices_.end(); }
+  };
+
+  //! @}
+
+}
\ No newline at end of file
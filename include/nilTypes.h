@@ -6,6 +6,7 @@
 #include <exception>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <list>
 #include <sstream>
@@ -14,6 +15,18 @@
 #include <set>
 #include <algorithm>
 #include <numeric>
+#include <fstream>
+#include <chrono>
+#include <span>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <type_traits>
+#include <bitset>
+#include <optional>
+#include <bit>
+#include <initializer_list>
+#include <system_error>
 
 namespace nil {
 
@@ -26,9 +39,13 @@ namespace nil {
   using DeviceID = uint32_t; //!< A device ID type.
   using POVDirection = uint32_t; //!< A POV (D-pad) direction type.
   using VirtualKeyCode = unsigned int; //!< A virtual key code type.
+  using Timestamp = uint64_t; //!< A monotonic timestamp in nanoseconds.
 
   using Real = float; //!< Real number type.
 
+  //! Cache line size to keep data touched by different threads apart.
+  const size_t c_cacheLineSize = 64;
+
 # define NIL_REAL_ZERO 0.0f //!< Real number zero constant.
 # define NIL_REAL_ONE 1.0f //!< Real number one constant.
 # define NIL_REAL_MINUSONE -1.0f //!< Real number minus one constant.
@@ -60,6 +77,353 @@ namespace nil {
 
   using SystemPtr = shared_ptr<System>;
 
+  using ListenerToken = uint32_t; //!< A listener registration token. Never 0.
+
+  //! \struct Subscription
+  //! The events a listener wants to be called for. Everything by default.
+  struct Subscription
+  {
+    //! Component indices a subscription can pick out; higher ones always pass.
+    static const size_t c_componentCount = 256;
+
+    uint32_t kinds = ~0U; //!< Event kinds, one bit each, as defined by the listener type
+    std::bitset<c_componentCount> components = std::bitset<c_componentCount>().set(); //!< Component indices or key codes
+
+    inline Subscription() {}
+
+    //! Subscribe to some event kinds of every component.
+    inline explicit Subscription( uint32_t kinds_ ): kinds( kinds_ ) {}
+
+    //! Subscribe to some event kinds of the given components only.
+    inline Subscription( uint32_t kinds_, std::initializer_list<size_t> components_ ): kinds( kinds_ )
+    {
+      components.reset();
+      for ( auto component : components_ )
+        components.set( component );
+    }
+
+    //! Query if an event is wanted.
+    //! \param kind The event kind bit.
+    //! \param component The component index, or c_componentCount or above to not care.
+    inline bool wants( uint32_t kind, size_t component ) const
+    {
+      return ( ( kinds & kind ) && ( component >= c_componentCount || components[component] ) );
+    }
+  };
+
+  //! \class ListenerList
+  //! Contiguous table of event listeners.
+  //! Listeners can be added & removed at any time, from inside their own
+  //! callbacks too. A removed listener is never called again, and one added
+  //! during a dispatch is called from the next one on. Entries removed during
+  //! a dispatch are only swept out once it is over, so nothing shifts under it.
+  //! A listener may subscribe to only some events; the dispatch itself
+  //! skips it for the rest, so it is never called for them.
+  //! Once the table has grown, adding & removing never allocates.
+  template <class T>
+  class ListenerList {
+  private:
+    struct Entry {
+      T* listener; //!< The listener, or nullptr if removed during a dispatch
+      ListenerToken token; //!< Token handed out for it
+      Subscription subscription; //!< Events it wants
+    };
+    vector<Entry> entries_; //!< Registered listeners, in order of addition
+    ListenerToken lastToken_ = 0; //!< Token handed out last
+    unsigned int dispatching_ = 0; //!< Depth of dispatches in progress
+    bool holes_ = false; //!< Were entries removed during a dispatch?
+
+    void erase( size_t index )
+    {
+      if ( dispatching_ )
+      {
+        entries_[index].listener = nullptr;
+        holes_ = true;
+      }
+      else
+        entries_.erase( entries_.begin() + index );
+    }
+  public:
+    //! \class Dispatch
+    //! The listeners to call, for the length of one dispatch.
+    //! Use as a range: for ( auto listener : listeners_.dispatch( kind, component ) )
+    class Dispatch {
+    private:
+      ListenerList* list_;
+      size_t end_; //!< Entries present when the dispatch began
+      uint32_t kind_; //!< Kind of event being dispatched
+      size_t component_; //!< Component the event is about
+    public:
+      class iterator {
+      private:
+        const Dispatch* dispatch_;
+        size_t index_;
+        // Entries are looked up anew each time, as the table may grow meanwhile
+        inline void skipUnwanted()
+        {
+          auto& entries = dispatch_->list_->entries_;
+          while ( index_ < dispatch_->end_ && ( !entries[index_].listener
+            || !entries[index_].subscription.wants( dispatch_->kind_, dispatch_->component_ ) ) )
+            index_++;
+        }
+      public:
+        inline iterator( const Dispatch* dispatch, size_t index ):
+        dispatch_( dispatch ), index_( index ) { skipUnwanted(); }
+        inline T* operator * () const { return dispatch_->list_->entries_[index_].listener; }
+        inline iterator& operator ++ () { index_++; skipUnwanted(); return *this; }
+        inline bool operator != ( const iterator& other ) const { return ( index_ != other.index_ ); }
+      };
+      inline Dispatch( ListenerList* list, uint32_t kind, size_t component ):
+      list_( list ), end_( list->entries_.size() ), kind_( kind ), component_( component )
+      {
+        list_->dispatching_++;
+      }
+      Dispatch( const Dispatch& ) = delete;
+      Dispatch& operator = ( const Dispatch& ) = delete;
+      inline iterator begin() const { return iterator( this, 0 ); }
+      inline iterator end() const { return iterator( this, end_ ); }
+      inline ~Dispatch()
+      {
+        if ( --list_->dispatching_ == 0 && list_->holes_ )
+        {
+          std::erase_if( list_->entries_, []( const Entry& entry ) { return !entry.listener; } );
+          list_->holes_ = false;
+        }
+      }
+    };
+
+    //! Add a listener.
+    //! \param subscription The events it wants.
+    //! \return Token for removing it with.
+    ListenerToken add( T* listener, const Subscription& subscription = Subscription() )
+    {
+      if ( ++lastToken_ == 0 )
+        ++lastToken_;
+      entries_.push_back( { listener, lastToken_, subscription } );
+      return lastToken_;
+    }
+
+    //! Remove every registration of a listener.
+    void remove( T* listener )
+    {
+      for ( size_t i = entries_.size(); i > 0; i-- )
+        if ( entries_[i - 1].listener == listener )
+          erase( i - 1 );
+    }
+
+    //! Remove a listener by its token.
+    void remove( ListenerToken token )
+    {
+      for ( size_t i = 0; i < entries_.size(); i++ )
+        if ( entries_[i].token == token && entries_[i].listener )
+        {
+          erase( i );
+          return;
+        }
+    }
+
+    //! Change what a listener added earlier wants.
+    //! \return false if there is no such token.
+    bool subscribe( ListenerToken token, const Subscription& subscription )
+    {
+      for ( auto& entry : entries_ )
+        if ( entry.token == token && entry.listener )
+        {
+          entry.subscription = subscription;
+          return true;
+        }
+      return false;
+    }
+
+    //! Begin dispatching an event to the listeners that want it.
+    //! \param kind The event kind bit.
+    //! \param component The component index, if the event is about one.
+    inline Dispatch dispatch( uint32_t kind, size_t component = Subscription::c_componentCount )
+    {
+      return Dispatch( this, kind, component );
+    }
+  };
+
+  //! \class SeqLock
+  //! Sequence lock over a plain value, for handing it from one writer thread
+  //! to any number of readers. The writer never waits; readers retry
+  //! whenever they overlap a store, and always come away with a whole value.
+  //! Sized to whole cache lines, so that no neighbor shares one with it.
+  template <class T>
+  class alignas( c_cacheLineSize ) SeqLock {
+    static_assert( std::is_trivially_copyable_v<T>, "SeqLock needs a trivially copyable type" );
+  private:
+    static constexpr size_t c_wordCount =
+      ( ( sizeof( T ) + sizeof( uint64_t ) * 2 + c_cacheLineSize - 1 ) / c_cacheLineSize )
+      * ( c_cacheLineSize / sizeof( uint64_t ) ) - 1;
+    // The value is moved in atomic words, so that a torn read is merely
+    // thrown away instead of being a data race.
+    std::atomic<uint64_t> sequence_ = 0; //!< Odd while a store is in progress
+    std::atomic<uint64_t> words_[c_wordCount] = {}; //!< The value, a word at a time
+  public:
+    //! Writer side. Publish a new value.
+    void store( const T& value )
+    {
+      uint64_t words[c_wordCount] = {};
+      memcpy( words, &value, sizeof( T ) );
+
+      auto sequence = sequence_.load( std::memory_order_relaxed );
+      sequence_.store( sequence + 1, std::memory_order_relaxed );
+      std::atomic_thread_fence( std::memory_order_release );
+      for ( size_t i = 0; i < c_wordCount; i++ )
+        words_[i].store( words[i], std::memory_order_relaxed );
+      sequence_.store( sequence + 2, std::memory_order_release );
+    }
+
+    //! Reader side. Get the latest published value. Safe from any thread.
+    T load() const
+    {
+      uint64_t words[c_wordCount];
+      uint64_t before, after;
+      do
+      {
+        before = sequence_.load( std::memory_order_acquire );
+        for ( size_t i = 0; i < c_wordCount; i++ )
+          words[i] = words_[i].load( std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_acquire );
+        after = sequence_.load( std::memory_order_relaxed );
+      } while ( ( before & 1 ) || before != after );
+
+      T value;
+      memcpy( &value, words, sizeof( T ) );
+      return value;
+    }
+
+    //! Get the number of values published so far.
+    inline uint64_t version() const
+    {
+      return ( sequence_.load( std::memory_order_acquire ) >> 1 );
+    }
+  };
+
+  //! \class HandleTable
+  //! Values looked up by native handle, for routing raw input to its device.
+  //! The values sit in one dense array; in front of it, a small open-addressing
+  //! index maps each handle to its slot. A lookup is a probe or two in the index,
+  //! usually within one cache line, and then the slot itself.
+  //! Only growing the table allocates.
+  template <class T>
+  class HandleTable {
+  public:
+    using Handle = uint64_t;
+  private:
+    static constexpr uint32_t c_emptyBucket = ~0U;
+    struct Bucket {
+      Handle handle; //!< The handle, if used
+      uint32_t slot; //!< Index of its slot, or c_emptyBucket
+    };
+    struct Slot {
+      Handle handle;
+      T value;
+    };
+    vector<Slot> slots_; //!< The values, densely packed
+    vector<Bucket> buckets_; //!< Linear probing index, a power of two in size & at most half full
+    unsigned int shift_ = 64; //!< Shift taking a hash down to a bucket index
+
+    inline size_t home( Handle handle ) const
+    {
+      // Fibonacci hashing; handles tend to be small & evenly spaced
+      return static_cast<size_t>( ( handle * 0x9E3779B97F4A7C15ULL ) >> shift_ );
+    }
+
+    size_t findBucket( Handle handle ) const
+    {
+      auto mask = buckets_.size() - 1;
+      for ( auto i = home( handle ); ; i = ( i + 1 ) & mask )
+        if ( buckets_[i].slot == c_emptyBucket || buckets_[i].handle == handle )
+          return i;
+    }
+
+    void rehash( size_t size )
+    {
+      buckets_.assign( size, { 0, c_emptyBucket } );
+      shift_ = 64;
+      for ( size_t i = size; i > 1; i >>= 1 )
+        shift_--;
+      for ( size_t i = 0; i < slots_.size(); i++ )
+        buckets_[findBucket( slots_[i].handle )] = { slots_[i].handle, static_cast<uint32_t>( i ) };
+    }
+  public:
+    //! Find the value for a handle.
+    //! \return The value, or nullptr. Valid until the table is next changed.
+    inline T* find( Handle handle )
+    {
+      if ( slots_.empty() )
+        return nullptr;
+      auto& bucket = buckets_[findBucket( handle )];
+      return ( bucket.slot != c_emptyBucket ? &slots_[bucket.slot].value : nullptr );
+    }
+
+    //! Set the value for a handle, adding it if need be.
+    void insert( Handle handle, const T& value )
+    {
+      if ( ( slots_.size() + 1 ) * 2 > buckets_.size() )
+        rehash( std::max<size_t>( buckets_.size() * 2, 16 ) );
+
+      auto& bucket = buckets_[findBucket( handle )];
+      if ( bucket.slot != c_emptyBucket )
+      {
+        slots_[bucket.slot].value = value;
+        return;
+      }
+
+      bucket = { handle, static_cast<uint32_t>( slots_.size() ) };
+      slots_.push_back( { handle, value } );
+    }
+
+    //! Remove a handle.
+    //! \return false if it wasn't there.
+    bool erase( Handle handle )
+    {
+      if ( slots_.empty() )
+        return false;
+
+      auto i = findBucket( handle );
+      auto slot = buckets_[i].slot;
+      if ( slot == c_emptyBucket )
+        return false;
+
+      // Keep the values dense by moving the last one into the hole
+      if ( slot != slots_.size() - 1 )
+      {
+        slots_[slot] = std::move( slots_.back() );
+        buckets_[findBucket( slots_[slot].handle )].slot = slot;
+      }
+      slots_.pop_back();
+
+      // Shift later entries of the probe run back, so that no tombstones are needed
+      auto mask = buckets_.size() - 1;
+      for ( auto j = ( i + 1 ) & mask; buckets_[j].slot != c_emptyBucket; j = ( j + 1 ) & mask )
+      {
+        auto k = home( buckets_[j].handle );
+        bool stays = ( i <= j ? ( i < k && k <= j ) : ( i < k || k <= j ) );
+        if ( stays )
+          continue;
+        buckets_[i] = buckets_[j];
+        i = j;
+      }
+      buckets_[i].slot = c_emptyBucket;
+      return true;
+    }
+
+    //! Get the number of handles in the table.
+    inline size_t size() const { return slots_.size(); }
+  };
+
+  //! Get the current time on the clock input timestamps use,
+  //! which is std::chrono::steady_clock on every platform.
+  //! \return The current time.
+  inline Timestamp currentTimestamp()
+  {
+    return static_cast<Timestamp>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch() ).count() );
+  }
+
   //! \struct Color
   //! A color value.
   struct Color
@@ -95,6 +459,18 @@ namespace nil {
       return Vector2i( x - other.x, y - other.y );
     }
 
+    inline Vector2i operator + ( const Vector2i& other ) const
+    {
+      return Vector2i( x + other.x, y + other.y );
+    }
+
+    inline Vector2i& operator += ( const Vector2i& other )
+    {
+      x += other.x;
+      y += other.y;
+      return *this;
+    }
+
     const static Vector2i ZERO; //!< Static default zero vector
   };
 
@@ -17,7 +17,7 @@ namespace nil {
 #   define SAFE_RELEASE(p) {if(p){p->Release();(p)=NULL;}}
 # endif
 
-# if defined(NIL_EXCEPT) || defined(NIL_EXCEPT_WINAPI) || defined(NIL_EXCEPT_DINPUT)
+# if defined(NIL_EXCEPT) || defined(NIL_EXCEPT_WINAPI) || defined(NIL_EXCEPT_DINPUT) || defined(NIL_EXCEPT_POSIX)
 #   error NIL_EXCEPT* macro already defined!
 # else
   //! Fire a generic exception.
@@ -26,8 +26,12 @@ namespace nil {
 #   define NIL_EXCEPT_WINAPI(description) {throw nil::Exception(description,__FUNCTION__,nil::Exception::WinAPI);}
   //! Fire a DirectInput exception.
 #   define NIL_EXCEPT_DINPUT(hr,description) {throw nil::Exception(description,__FUNCTION__,hr,nil::Exception::DirectInput);}
+  //! Fire a POSIX exception, capturing errno.
+#   define NIL_EXCEPT_POSIX(description) {throw nil::Exception(description,__FUNCTION__,nil::Exception::POSIX);}
 # endif
 
+#ifdef NIL_PLATFORM_WINDOWS
+
   // Initial known value is hardcoded here, but it gets replaced by what HidD_GetHidGuid returns later
   static GUID g_HIDInterfaceGUID = { 0x4D1E55B2, 0xF16F, 0x11CF, { 0x88, 0xCB, 0x00, 0x11, 0x11, 0x00, 0x00, 0x30 } };
 
@@ -91,6 +95,69 @@ namespace nil {
     }
   };
 
+#endif
+
+#ifdef NIL_PLATFORM_LINUX
+
+  // Where evdev & hidraw device nodes live, and how they are named
+  const char* const g_inputDirectory = "/dev/input";
+  const char* const g_eventNodePrefix = "event";
+  const char* const g_deviceDirectory = "/dev";
+  const char* const g_hidrawNodePrefix = "hidraw";
+
+  //! \class SafeDescriptor
+  //! Scoped owner for a POSIX file descriptor.
+  class SafeDescriptor {
+  private:
+    int fd_; //!< The descriptor
+  public:
+    //! Wrapper constructor for a given file descriptor.
+    explicit SafeDescriptor( int fd = -1 ): fd_( fd )
+    {
+    }
+    SafeDescriptor( const SafeDescriptor& ) = delete;
+    SafeDescriptor& operator = ( const SafeDescriptor& ) = delete;
+    SafeDescriptor( SafeDescriptor&& other ) noexcept: fd_( other.release() )
+    {
+    }
+    SafeDescriptor& operator = ( SafeDescriptor&& other ) noexcept
+    {
+      reset( other.release() );
+      return *this;
+    }
+    //! Quickie descriptor conversion operator.
+    operator int() const
+    {
+      return fd_;
+    }
+    //! Is this descriptor valid?
+    bool valid() const
+    {
+      return ( fd_ >= 0 );
+    }
+    //! Give up ownership of the descriptor without closing it.
+    int release()
+    {
+      int fd = fd_;
+      fd_ = -1;
+      return fd;
+    }
+    //! Close the current descriptor and take ownership of another.
+    void reset( int fd = -1 )
+    {
+      if ( fd_ >= 0 )
+        ::close( fd_ );
+      fd_ = fd;
+    }
+    //! Destructor.
+    ~SafeDescriptor()
+    {
+      reset();
+    }
+  };
+
+#endif
+
   //! 32-bit Fowler/Noll/Vo hash initialization value
 # define FNV1_32_INIT ((uint32_t)0x811c9dc5)
   //! 32-bit Fowler/Noll/Vo hash initialization value
@@ -111,6 +178,12 @@ namespace nil {
       return hashval;
     }
     
+    //! Test a bit in a little-endian bit array, such as kernel capability masks.
+    inline bool testBit( const uint8_t* bits, unsigned int bit )
+    {
+      return ( bits[bit / 8] & ( 1 << ( bit % 8 ) ) ) != 0;
+    }
+
     inline void ltrim( utf8String& s )
     {
       s.erase( s.begin(), std::find_if( s.begin(), s.end(), []( unsigned char ch )
@@ -166,6 +239,75 @@ namespace nil {
       return utf8String( &conversion[0] );
     }
 
+#endif
+
+#ifdef NIL_PLATFORM_LINUX
+
+    //! Is the given file name that of a numbered device node, such as event3 or hidraw0?
+    inline bool isNodeName( const char* name, const char* prefix )
+    {
+      const size_t prefixLength = strlen( prefix );
+      if ( strncmp( name, prefix, prefixLength ) != 0 || !name[prefixLength] )
+        return false;
+      for ( auto c = name + prefixLength; *c; c++ )
+        if ( *c < '0' || *c > '9' )
+          return false;
+      return true;
+    }
+
+    //! Full path of a device node, by directory & file name.
+    inline utf8String makeNodePath( const char* directory, const char* name )
+    {
+      return utf8String( directory ) + "/" + name;
+    }
+
+    //! List the numbered device nodes currently present in a directory, in node order.
+    //! A missing directory is not an error, just a machine without such devices.
+    inline vector<utf8String> listNodes( const char* directory, const char* prefix )
+    {
+      vector<int> numbers;
+      if ( auto dir = opendir( directory ) )
+      {
+        while ( auto entry = readdir( dir ) )
+          if ( isNodeName( entry->d_name, prefix ) )
+            numbers.push_back( atoi( entry->d_name + strlen( prefix ) ) );
+        closedir( dir );
+      }
+
+      // Node order keeps device IDs the same from one run to the next
+      std::sort( numbers.begin(), numbers.end() );
+
+      vector<utf8String> nodes;
+      nodes.reserve( numbers.size() );
+      for ( auto number : numbers )
+        nodes.push_back( makeNodePath( directory, ( prefix + std::to_string( number ) ).c_str() ) );
+      return nodes;
+    }
+
+    //! Is the given path that of a hidraw node?
+    inline bool isHidrawNodePath( const utf8String& path )
+    {
+      const size_t directoryLength = strlen( g_deviceDirectory );
+      return ( path.compare( 0, directoryLength, g_deviceDirectory ) == 0
+        && path.length() > directoryLength && path[directoryLength] == '/'
+        && isNodeName( path.c_str() + directoryLength + 1, g_hidrawNodePrefix ) );
+    }
+
+    //! Kernel time of an input event, which is on the monotonic clock once
+    //! the node has been switched over with EVIOCSCLOCKID.
+    inline Timestamp eventTimestamp( const input_event& event )
+    {
+#ifdef input_event_sec
+      return ( static_cast<Timestamp>( event.input_event_sec ) * 1000000000ULL
+        + static_cast<Timestamp>( event.input_event_usec ) * 1000ULL );
+#else
+      return ( static_cast<Timestamp>( event.time.tv_sec ) * 1000000000ULL
+        + static_cast<Timestamp>( event.time.tv_usec ) * 1000ULL );
+#endif
+    }
+
+#endif
+
     template <typename T>
     inline void searchAndReplace( T& str, const T& search, const T& replace )
     {
@@ -210,6 +352,63 @@ namespace nil {
       }
     }
 
+    //! Most threads a concurrent probe spreads over, the calling one included.
+    const size_t c_maxProbeThreads = 8;
+
+    //! Run a probe over every item concurrently, on a few worker threads,
+    //! and collect the results in item order, so that the outcome never
+    //! depends on which thread got to an item first.
+    //! The probe must be safe to call from several threads at once.
+    //! Should it throw, the first exception is rethrown once every thread is done.
+    template <typename Item, typename Probe>
+    inline auto probeConcurrently( const vector<Item>& items, Probe probe )
+    {
+      vector<decltype( probe( items.front() ) )> results( items.size() );
+      std::atomic<size_t> next = 0;
+      std::atomic<bool> failed = false;
+      std::exception_ptr failure;
+
+      auto worker = [&]()
+      {
+        for ( auto i = next++; i < items.size(); i = next++ )
+        {
+          try
+          {
+            results[i] = probe( items[i] );
+          }
+          catch ( ... )
+          {
+            if ( !failed.exchange( true ) )
+              failure = std::current_exception();
+          }
+        }
+      };
+
+      auto threadCount = std::min( { items.size(),
+        static_cast<size_t>( std::thread::hardware_concurrency() ), c_maxProbeThreads } );
+
+      vector<std::thread> threads;
+      try
+      {
+        for ( size_t i = 1; i < threadCount; ++i )
+          threads.emplace_back( worker );
+      }
+      catch ( const std::system_error& )
+      {
+        // Out of threads; the ones we got will do
+      }
+
+      worker();
+
+      for ( auto& thread : threads )
+        thread.join();
+
+      if ( failure )
+        std::rethrow_exception( failure );
+
+      return results;
+    }
+
     //! Auto-generate a name for a nameless device.
     inline utf8String generateName( Device::Type deviceType, int index ) throw()
     {
@@ -217,34 +416,79 @@ namespace nil {
       switch ( deviceType )
       {
         case Device::Device_Mouse:
-          sprintf_s( name, 64, "Mouse %d", index );
+          snprintf( name, 64, "Mouse %d", index );
         break;
         case Device::Device_Keyboard:
-          sprintf_s( name, 64, "Keyboard %d", index );
+          snprintf( name, 64, "Keyboard %d", index );
         break;
         case Device::Device_Controller:
-          sprintf_s( name, 64, "Controller %d", index );
+          snprintf( name, 64, "Controller %d", index );
         break;
       }
       return name;
     }
 
-    inline bool compareDevicePaths( wideString a, wideString b )
+    //! Get the canonical form of a device path, for use as a lookup key:
+    //! lowercase, without the interface class GUID or anything after it,
+    //! without other {...} segments or trailing separators, and with the
+    //! \\?\ prefix that some Windows versions spell \??\.
+    //! The same device gets the same key from Raw Input and SetupAPI alike,
+    //! even where Raw Input appends to the path, as in a keyboard's \KBD.
+    //! Paths to one device only ever differ from the interface GUID on,
+    //! so keys are equal exactly when the paths name the same device.
+    //! Linear in path length.
+    inline wideString canonicalDevicePath( const wideString& path )
     {
-      stringDeleteBetween( a, L'{', L'}' );
-      stringDeleteBetween( b, L'{', L'}' );
+      wideString key;
+      key.reserve( path.length() );
 
-      std::transform( a.begin(), a.end(), a.begin(), ::towlower );
-      std::transform( b.begin(), b.end(), b.begin(), ::towlower );
+      // The interface class GUID is the last #-separated component.
+      // Bluetooth paths carry a service GUID earlier on, so don't cut at the first brace.
+      auto end = path.length();
+      auto lastHash = path.rfind( L'#' );
+      if ( lastHash != wideString::npos && lastHash + 1 < end && path[lastHash + 1] == L'{' )
+        end = lastHash;
 
+      // Skip the remaining {...} segments; an unclosed brace is kept as is
+      auto lastClose = path.rfind( L'}', end ? end - 1 : 0 );
+      for ( size_t i = 0; i < end; ++i )
+      {
+        if ( path[i] == L'{' && lastClose != wideString::npos && i < lastClose )
+        {
+          i = path.find( L'}', i + 1 );
+          continue;
+        }
+        // Paths are nearly all ASCII, and towlower is a slow call per character
+        auto c = path[i];
+        if ( c >= L'A' && c <= L'Z' )
+          c = static_cast<wchar_t>( c - L'A' + L'a' );
+        else if ( c >= 0x80 )
+          c = static_cast<wchar_t>( ::towlower( static_cast<wint_t>( c ) ) );
+        key.push_back( c );
+      }
+
+      while ( !key.empty() && key.back() == L'#' )
+        key.pop_back();
+
+      if ( key.compare( 0, 4, LR"(\??\)" ) == 0 )
+        key[1] = L'\\';
+
+      return key;
+    }
+
+    //! Do two paths point to the same HID device?
+    //! Prefer comparing canonicalDevicePath keys computed once up front.
+    inline bool compareDevicePaths( const wideString& a, const wideString& b )
+    {
       constexpr auto mustStartWith = LR"(\\?\hid)";
-      if ( a.substr( 0, 7 ) != mustStartWith || b.substr( 0, 7 ) != mustStartWith )
+
+      auto keyA = canonicalDevicePath( a );
+      if ( keyA.compare( 0, 7, mustStartWith ) != 0 )
         return false;
 
-      return ( a.find( b ) != wideString::npos || b.find( a ) != wideString::npos );
+      return ( keyA == canonicalDevicePath( b ) );
     }
 
-#endif
   }
 
   //! @}
@@ -0,0 +1,185 @@
+#pragma once
+#include "nilConfig.h"
+
+#include "nilTypes.h"
+#include "nilComponents.h"
+#include "nilException.h"
+#include "nilCommon.h"
+
+namespace nil {
+
+  //! \addtogroup Nil
+  //! @{
+
+  //! \class VirtualDevice
+  //! A device that exists only in software, for injecting synthetic input.
+  //! Behaves like any other device; it is listed, connected & enabled the same way,
+  //! and its instance fires the same listener callbacks as real hardware would.
+  //! \sa System::createVirtualDevice
+  class VirtualDevice: public Device, public std::enable_shared_from_this<VirtualDevice> {
+  friend class System;
+  public:
+    //! Component counts for a virtual device's instance.
+    struct Layout {
+      size_t buttons = 5; //!< Mouse or controller buttons
+      size_t axes = 0; //!< Controller axes
+      size_t sliders = 0; //!< Controller sliders
+      size_t povs = 0; //!< Controller POVs
+    };
+  private:
+    Layout layout_; //!< Our instance layout
+    DeviceID staticId_; //!< Static identifier, derived from type & name unless given
+  public:
+    //! Constructor.
+    //! \param system The system.
+    //! \param id     Session-specific device ID.
+    //! \param type   Device type.
+    //! \param name   Device name. Autogenerated if empty.
+    //! \param layout Component counts.
+    //! \param staticId Static identifier to use, or 0 to derive one from type & name.
+    VirtualDevice( System* system, DeviceID id, Type type, const utf8String& name, const Layout& layout,
+      DeviceID staticId = 0 );
+
+    Handler getHandler() const override;
+    DeviceID getStaticID() const override;
+    shared_ptr<Device> ptr() override { return dynamic_pointer_cast<Device>( shared_from_this() ); }
+
+    //! Get the instance layout.
+    virtual const Layout& getLayout() const;
+
+    //! Simulate unplugging the device.
+    //! Like real hardware, it gets disconnected on the next System update.
+    virtual void unplug();
+
+    //! Simulate plugging the device back in.
+    virtual void plug();
+  };
+
+  using VirtualDevicePtr = shared_ptr<VirtualDevice>;
+
+  //! \addtogroup Mouse
+  //! @{
+
+  //! \class VirtualMouse
+  //! Mouse driven by injected input.
+  //! Every injection fires listeners immediately, without allocating.
+  //! \sa Mouse
+  class VirtualMouse: public Mouse, public std::enable_shared_from_this<VirtualMouse> {
+  public:
+    //! Constructor.
+    //! \param device The device.
+    VirtualMouse( VirtualDevicePtr device );
+
+    //! Inject relative movement.
+    //! \param timestamp When it happened, or 0 for now.
+    virtual void injectMovement( const Vector2i& delta, Timestamp timestamp = 0 );
+
+    //! Inject a button press or release.
+    //! Injecting the state a button is already in does nothing.
+    //! \param timestamp When it happened, or 0 for now.
+    virtual void injectButton( size_t button, bool pushed, Timestamp timestamp = 0 );
+
+    //! Inject wheel rotation, in the same units real mice report.
+    //! \param timestamp When it happened, or 0 for now.
+    virtual void injectWheel( int delta, Timestamp timestamp = 0 );
+
+    void update() override;
+
+    shared_ptr<DeviceInstance> ptr() override { return dynamic_pointer_cast<DeviceInstance>( shared_from_this() ); }
+
+    //! Destructor.
+    virtual ~VirtualMouse();
+  };
+
+  using VirtualMousePtr = shared_ptr<VirtualMouse>;
+
+  //! @}
+
+  //! \addtogroup Keyboard
+  //! @{
+
+  //! \class VirtualKeyboard
+  //! Keyboard driven by injected input.
+  //! \sa Keyboard
+  class VirtualKeyboard: public Keyboard, public std::enable_shared_from_this<VirtualKeyboard> {
+  public:
+    //! Constructor.
+    //! \param device The device.
+    VirtualKeyboard( VirtualDevicePtr device );
+
+    //! Inject a key press.
+    //! \param timestamp When it happened, or 0 for now.
+    virtual void injectKeyPressed( const VirtualKeyCode keycode, Timestamp timestamp = 0 );
+
+    //! Inject a key repeat.
+    //! \param timestamp When it happened, or 0 for now.
+    virtual void injectKeyRepeat( const VirtualKeyCode keycode, Timestamp timestamp = 0 );
+
+    //! Inject a key release.
+    //! \param timestamp When it happened, or 0 for now.
+    virtual void injectKeyReleased( const VirtualKeyCode keycode, Timestamp timestamp = 0 );
+
+    void update() override;
+
+    shared_ptr<DeviceInstance> ptr() override { return dynamic_pointer_cast<DeviceInstance>( shared_from_this() ); }
+
+    //! Destructor.
+    virtual ~VirtualKeyboard();
+  };
+
+  using VirtualKeyboardPtr = shared_ptr<VirtualKeyboard>;
+
+  //! @}
+
+  //! \addtogroup Controller
+  //! @{
+
+  //! \class VirtualController
+  //! Game controller driven by injected input.
+  //! Components are set individually and fired together on commit,
+  //! just like a real controller's report.
+  //! \sa Controller
+  class VirtualController: public Controller, public std::enable_shared_from_this<VirtualController> {
+  private:
+    ControllerState lastState_; //!< State as of the previous commit
+  public:
+    //! Constructor.
+    //! \param device The device.
+    VirtualController( VirtualDevicePtr device );
+
+    //! Set a button's state, to be fired on commit.
+    virtual void setButton( size_t button, bool pushed );
+
+    //! Set an axis' value, to be fired on commit.
+    virtual void setAxis( size_t axis, Real value );
+
+    //! Set a slider's value, to be fired on commit.
+    virtual void setSlider( size_t slider, const Vector2f& value );
+
+    //! Set a POV's direction, to be fired on commit.
+    virtual void setPOV( size_t pov, POVDirection direction );
+
+    //! Fire changes made since the last commit.
+    //! \param timestamp When they happened, or 0 for now.
+    virtual void commit( Timestamp timestamp = 0 );
+
+    //! Replace the whole state and fire the changes.
+    //! The given state must match our layout.
+    //! \param timestamp When it happened, or 0 for now.
+    virtual void inject( const ControllerState& state, Timestamp timestamp = 0 );
+
+    void update() override;
+
+    shared_ptr<DeviceInstance> ptr() override { return dynamic_pointer_cast<DeviceInstance>( shared_from_this() ); }
+
+    //! Destructor.
+    virtual ~VirtualController();
+  };
+
+  using VirtualControllerPtr = shared_ptr<VirtualController>;
+
+  //! @}
+
+  //! @}
+
+}
\ No newline at end of file
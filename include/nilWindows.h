@@ -15,6 +15,7 @@ namespace nil {
 
   class System;
   class DeviceInstance;
+  class PacketRing;
 
   class Mouse;
   class Keyboard;
@@ -68,9 +69,10 @@ namespace nil {
   private:
     HANDLE rawHandle_; //!< The internal raw input device handle
     wideString rawPath_; //!< The full input device raw path
+    wideString rawPathKey_; //!< Canonical device path, for lookups
     windows::HIDRecordPtr hidRecord_; //!< The associated HID record entry
   public:
-    RawInputDevice( SystemPtr system, DeviceID id, HANDLE rawHandle, wideString& rawPath, windows::HIDRecordPtr hid );
+    RawInputDevice( System* system, DeviceID id, HANDLE rawHandle, wideString& rawPath, windows::HIDRecordPtr hid );
     virtual ~RawInputDevice();
 
     Handler getHandler() const override;
@@ -83,6 +85,9 @@ namespace nil {
     //! Get the RawInput device path.
     virtual const wideString& getRawPath() const;
 
+    //! Get the canonical device path, as made by util::canonicalDevicePath.
+    const wideString& getRawPathKey() const;
+
     //! Get the associated HID record entry.
     windows::HIDRecordPtr getHIDReccord() const;
   };
@@ -99,7 +104,7 @@ namespace nil {
     GUID inst_; //!< DirectInput's instance identifier
 
   public:
-    DirectInputDevice( SystemPtr system, DeviceID id, LPCDIDEVICEINSTANCEW instance );
+    DirectInputDevice( System* system, DeviceID id, LPCDIDEVICEINSTANCEW instance );
 
     Handler getHandler() const override;
     DeviceID getStaticID() const override;
@@ -154,7 +159,7 @@ namespace nil {
     void onConnect() override;
 
   public:
-    XInputDevice( SystemPtr system, DeviceID id, int xinputID );
+    XInputDevice( System* system, DeviceID id, int xinputID );
 
     Handler getHandler() const override;
     DeviceID getStaticID() const override;
@@ -169,6 +174,42 @@ namespace nil {
 
   using XInputDevicePtr = shared_ptr<XInputDevice>;
 
+  //! \class XInputSampler
+  //! Polls every XInput user index on a thread of its own, and hands each
+  //! new packet over through a PacketRing, sourced by user index.
+  //! XInput keeps no history, so this is what stops presses from going
+  //! missing between two rare updates.
+  //! \sa System::enableInputThread
+  class XInputSampler {
+  private:
+    XInput* xinput_; //!< The XInput module
+    unique_ptr<PacketRing> ring_; //!< Sampled states
+    std::thread thread_; //!< The sampling thread
+    std::atomic<bool> stopping_ = false; //!< Is the thread told to stop?
+    std::atomic<uint32_t> watched_ = 0; //!< User indices known to be connected, one bit each
+
+    //! \b Internal Sampling thread body.
+    void threadMain();
+  public:
+    //! Constructor. Starts sampling right away.
+    //! \param xinput     The XInput module.
+    //! \param bufferSize Bytes of samples to hold between updates.
+    XInputSampler( XInput* xinput, size_t bufferSize );
+
+    //! Get the ring of samples, for draining.
+    PacketRing& getRing();
+
+    //! Set the user indices the System has connected. These are polled on
+    //! every pass from then on, rather than waiting for the next probe.
+    //! \param mask User indices, one bit each.
+    void watch( uint32_t mask );
+
+    //! Stop sampling. Samples already taken stay in the ring.
+    void stop();
+
+    ~XInputSampler();
+  };
+
   //! \addtogroup Mouse
   //! @{
 
@@ -182,13 +223,20 @@ namespace nil {
     bool hasHorizontalWheel_; //!< true to horizontal wheel
 
     //! My raw input callback.
-    virtual void onRawInput( const RAWMOUSE& input );
+    virtual void onRawInput( const RAWMOUSE& input, const Timestamp timestamp );
   public:
     //! Constructor.
     //! \param device The device.
     //! \param swapButtons Whether to swap the first & second buttons.
     RawInputMouse( RawInputDevicePtr device, const bool swapButtons );
 
+    //! Decode raw mouse button flags into transition masks,
+    //! where bit n stands for Raw Input button n+1.
+    //! \param flags    The usButtonFlags of a raw mouse event.
+    //! \param pressed  Mask of buttons that went down.
+    //! \param released Mask of buttons that went up.
+    static void decodeButtons( const USHORT flags, uint32_t& pressed, uint32_t& released );
+
     void update() override;
 
     shared_ptr<DeviceInstance> ptr() override { return dynamic_pointer_cast<DeviceInstance>( shared_from_this() ); }
@@ -210,15 +258,19 @@ namespace nil {
   class RawInputKeyboard: public Keyboard, public std::enable_shared_from_this<RawInputKeyboard> {
   friend class System;
   private:
-    set<VirtualKeyCode> pressedKeys_; //!< Set of keys that are currently pressed
-
     //! My raw input callback.
-    virtual void onRawInput( const RAWKEYBOARD& input );
+    virtual void onRawInput( const RAWKEYBOARD& input, const Timestamp timestamp );
   public:
     //! Constructor.
     //! \param device The device.
     RawInputKeyboard( RawInputDevicePtr device );
 
+    //! Translate a raw keyboard event to a virtual key code,
+    //! telling apart left & right modifiers and the numpad.
+    //! \param input The raw keyboard event.
+    //! \return The key code, or Key_Invalid for fake keys.
+    static VirtualKeyCode translateKey( const RAWKEYBOARD& input );
+
     void update() override;
 
     shared_ptr<DeviceInstance> ptr() override { return dynamic_pointer_cast<DeviceInstance>( shared_from_this() ); }
@@ -241,11 +293,9 @@ namespace nil {
   friend class System;
   private:
     //! My raw input callback.
-    virtual void onRawInput( const RAWHID& input );
+    virtual void onRawInput( const RAWHID& input, const Timestamp timestamp );
     KnownDeviceType devType_ = KnownDevice_Unknown;
     HIDConnectionType connType_ = HIDConnection_Unknown;
-    void setupDualSense();
-    void handleDualSense( const uint8_t* buf );
   public:
     //! Constructor.
     //! \param device The device.
@@ -302,6 +352,7 @@ namespace nil {
   //! Game controller implemented by XInput.
   //! \sa Controller
   class XInputController: public Controller, public std::enable_shared_from_this<XInputController> {
+  friend class System;
   private:
     DWORD lastPacket_ = 0; //!< Internal previous input packet's ID
     XINPUT_STATE xinputState_ = { 0 }; //!< Internal XInput state
@@ -311,6 +362,12 @@ namespace nil {
 
     //! Filter a trigger value.
     inline Real filterTrigger( int val );
+
+    //! Turn the current XInput state into ours, firing what changed.
+    void applyState( const Timestamp timestamp );
+
+    //! Take a state sampled by the XInputSampler.
+    void onSample( const XINPUT_STATE& state, const Timestamp timestamp );
   public:
     //! Constructor.
     //! \param device The device.
@@ -328,9 +385,9 @@ namespace nil {
 
   //! @}
 
-  using RawMouseMap = map<HANDLE, RawInputMouse*>;
-  using RawKeyboardMap = map<HANDLE, RawInputKeyboard*>;
-  using RawControllerMap = map<HANDLE, RawInputController*>;
+  using RawMouseMap = HandleTable<RawInputMouse*>;
+  using RawKeyboardMap = HandleTable<RawInputKeyboard*>;
+  using RawControllerMap = HandleTable<RawInputController*>;
 
   //! @}
 
@@ -41,13 +41,13 @@ namespace nil {
       virtual void onRawArrival( HANDLE handle ) = 0;
 
       //! Raw mouse input event.
-      virtual void onRawMouseInput( HANDLE handle, const RAWMOUSE& input, const bool sinked ) = 0;
+      virtual void onRawMouseInput( HANDLE handle, const RAWMOUSE& input, const bool sinked, const Timestamp timestamp ) = 0;
 
       //! Raw keyboard input event.
-      virtual void onRawKeyboardInput( HANDLE handle, const RAWKEYBOARD& input, const bool sinked ) = 0;
+      virtual void onRawKeyboardInput( HANDLE handle, const RAWKEYBOARD& input, const bool sinked, const Timestamp timestamp ) = 0;
 
       //! Raw HID input event.
-      virtual void onRawHIDInput( HANDLE handle, const RAWHID& input, const bool sinked ) = 0;
+      virtual void onRawHIDInput( HANDLE handle, const RAWHID& input, const bool sinked, const Timestamp timestamp ) = 0;
 
       //! Raw input device removal event.
       virtual void onRawRemoval( HANDLE handle ) = 0;
@@ -118,12 +118,15 @@ namespace nil {
       ~EventMonitor();
     };
 
+    class HIDProbeCache;
+
     //! \class HIDRecord
     //! A Human Interface Device instance currently present in the system.
     //! \sa HIDManager
     class HIDRecord {
     private:
       wideString path_; //!< Raw device path
+      wideString pathKey_; //!< Canonical device path, for lookups
       uint16_t usbVid_; //!< USB Vendor ID for this device
       uint16_t usbPid_; //!< USB Product ID for this device
       uint32_t hidIdent_; //!< Combined HID identifier
@@ -139,11 +142,13 @@ namespace nil {
       const KnownDeviceRecord* knownDevice_ = nullptr;
 
       void identify(); //!< \b Internal Figure out what I am
+      void query( HANDLE handle ); //!< \b Internal Ask the device for my capabilities & strings
     public:
       //! Constructor.
       //! \param  path   Full system path to the device.
       //! \param  handle Device handle.
-      HIDRecord( const wideString& path, HANDLE handle );
+      //! \param  cache  Probe cache to take capabilities & strings from, if any.
+      HIDRecord( const wideString& path, HANDLE handle, const HIDProbeCache* cache = nullptr );
 
       HIDConnectionType connectionType() const;
 
@@ -158,9 +163,16 @@ namespace nil {
       //! Am I an XInput device?
       bool isXInput() const;
 
+      //! Is this the path of an XInput device?
+      //! Works for devices already gone, too.
+      static bool isXInputPath( const wideString& path );
+
       //! Get full device path.
       const wideString& getPath() const;
 
+      //! Get the canonical device path, as made by util::canonicalDevicePath.
+      const wideString& getPathKey() const;
+
       //! Get device name.
       const utf8String& getName() const;
 
@@ -185,6 +197,9 @@ namespace nil {
       //! Get combined VID/PID identifier.
       uint32_t getIdentifier() const;
 
+      //! Get HID API capabilities.
+      const HIDP_CAPS& getCaps() const;
+
       //! Destructor.
       ~HIDRecord() = default;
     };
@@ -194,6 +209,42 @@ namespace nil {
     //! \brief A list of HID records.
     using HIDRecordList = list<HIDRecordPtr>;
 
+    //! \class HIDProbeCache
+    //! On-disk cache of what HID records learn from their devices, so that a
+    //! repeat launch can skip the slow string & feature report queries.
+    //! An entry is only used for the same device path with the same USB
+    //! vendor & product IDs. A missing, stale or damaged cache is no error;
+    //! it just doesn't help.
+    class HIDProbeCache {
+    public:
+      //! What a record learned from its device.
+      struct Entry {
+        uint16_t vid; //!< USB Vendor ID
+        uint16_t pid; //!< USB Product ID
+        HIDP_CAPS caps; //!< HID API capabilities
+        utf8String name; //!< Device name
+        utf8String manufacturer; //!< Device manufacturer
+        utf8String serial; //!< Device serial number
+      };
+    private:
+      utf8String path_; //!< Cache file path
+      std::unordered_map<wideString, Entry> entries_; //!< Entries by canonical device path
+    public:
+      //! Constructor. Loads the cache file, if there is one.
+      //! \param path Path of the cache file.
+      explicit HIDProbeCache( const utf8String& path );
+
+      //! Find the entry for a device.
+      //! Safe to call from several threads at once.
+      //! \param pathKey The canonical device path.
+      //! \return The entry, or nullptr if there is none for this path, vendor & product.
+      const Entry* find( const wideString& pathKey, uint16_t vid, uint16_t pid ) const;
+
+      //! Replace the cache with the given records, writing it out
+      //! unless it holds exactly those already.
+      void update( const HIDRecordList& records );
+    };
+
     //! \class HIDManager
     //! Manages a list of connected Human Interface Devices.
     //! \note The HIDManager has to be registered as PnPListener on an EventMonitor.
@@ -202,6 +253,8 @@ namespace nil {
     class HIDManager: public PnPListener {
     private:
       HIDRecordList records_; //!< Records container
+      std::unordered_map<wideString, HIDRecordPtr> recordsByPath_; //!< Records by canonical device path
+      unique_ptr<HIDProbeCache> cache_; //!< Probe cache, if enabled
 
       //! \b Internal My PnP plug callback.
       void onPnPPlug( const GUID& deviceClass, const wideString& devicePath ) override;
@@ -209,25 +262,73 @@ namespace nil {
       //! \b Internal My PnP unplug callback.
       void onPnPUnplug( const GUID& deviceClass, const wideString& devicePath ) override;
 
-      //! \b Internal Process an existing device.
-      void processDevice( SP_DEVICE_INTERFACE_DATA& interfaceData,
-        SP_DEVINFO_DATA& deviceData, const wideString& devicePath );
+      //! \b Internal Open a device & read its record.
+      //! Safe to call from any thread.
+      //! \return The record, or nullptr if the device could not be opened.
+      static HIDRecordPtr probeDevice( const wideString& devicePath, const HIDProbeCache* cache );
+
+      //! \b Internal Add a record, unless one with the same path is known already.
+      void addRecord( HIDRecordPtr record );
 
       //! \b Internal Initialization stuff
       void initialize();
     public:
-      //! Default constructor.
-      HIDManager();
+      //! Constructor.
+      //! \param cachePath Path of the probe cache file, or empty to not use one.
+      explicit HIDManager( const utf8String& cachePath = utf8String() );
 
       //! Get the list of active HID records.
       const HIDRecordList& getRecords() const;
 
+      //! Find the record of a device by path, in any form Windows hands it out in.
+      //! \return The record, or nullptr.
       HIDRecordPtr getRecordByPath( const wideString& devicePath );
 
+      //! Find the record of a device by canonical path, as made by util::canonicalDevicePath.
+      //! \return The record, or nullptr.
+      HIDRecordPtr getRecordByPathKey( const wideString& pathKey );
+
       //! Destructor.
       virtual ~HIDManager();
     };
 
+    //! \class RefreshScheduler
+    //! Gathers Plug-n-Play notifications into device refreshes.
+    //! A composite device brings several interfaces along, each announced
+    //! separately; instead of refreshing on every one, the work they call for
+    //! is collected until the notifications settle down, and then done once.
+    class RefreshScheduler {
+    public:
+      //! What needs refreshing, as bit flags.
+      enum Target: uint32_t {
+        Target_None = 0,
+        Target_DirectInput = 1, //!< Enumerate DirectInput devices
+        Target_XInput = 2, //!< Poll XInput slots
+        Target_SpecialHandling = 4, //!< Gather the devices DirectInput should ignore
+        Target_All = 7
+      };
+
+      //! How long notifications have to keep quiet before a refresh, in nanoseconds.
+      static const Timestamp c_settleTime = 50000000;
+
+      //! How long a steady stream of notifications may hold a refresh back, in nanoseconds.
+      static const Timestamp c_maximumDelay = 250000000;
+    private:
+      uint32_t pending_ = Target_None; //!< Targets waiting for a refresh
+      Timestamp first_ = 0; //!< When the first pending notification came
+      Timestamp last_ = 0; //!< When the latest pending notification came
+    public:
+      //! Add targets to the next refresh.
+      void schedule( uint32_t targets, Timestamp now );
+
+      //! Take the pending targets, if they are due.
+      //! \return The targets to refresh now, or Target_None.
+      uint32_t collect( Timestamp now );
+
+      //! Get the targets waiting for a refresh.
+      uint32_t getPending() const;
+    };
+
   }
 
   //! @}
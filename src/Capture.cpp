@@ -0,0 +1,488 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+namespace nil {
+
+  // Records are written out once this much has been buffered
+  const size_t c_captureFlushSize = 64 * 1024;
+
+  inline size_t paddedLength( size_t length )
+  {
+    return ( ( length + 7 ) & ~static_cast<size_t>( 7 ) );
+  }
+
+  // CaptureWriter class
+
+  CaptureWriter::CaptureWriter( const utf8String& path ):
+  start_( currentTimestamp() )
+  {
+#ifdef NIL_PLATFORM_WINDOWS
+    file_.open( util::utf8ToWide( path ), std::ios::binary | std::ios::trunc );
+#else
+    file_.open( path, std::ios::binary | std::ios::trunc );
+#endif
+    if ( !file_ )
+      NIL_EXCEPT( "Could not create capture file" );
+
+    file_.write( c_captureMagic, sizeof( c_captureMagic ) );
+
+    buffer_.reserve( c_captureFlushSize * 2 );
+  }
+
+  void CaptureWriter::write( Timestamp timestamp, DeviceID device, CaptureRecordType type,
+  const void* payload, size_t length, const void* extra, size_t extraLength )
+  {
+    CaptureRecordHeader header;
+
+    // Input can predate the capture, if it was waiting to be read when we started
+    header.timestamp = ( timestamp > start_ ? timestamp - start_ : 0 );
+    header.device = device;
+    header.type = type;
+    header.length = static_cast<uint16_t>( length + extraLength );
+
+    auto offset = buffer_.size();
+    buffer_.resize( offset + sizeof( header ) + paddedLength( length + extraLength ), 0 );
+
+    auto out = buffer_.data() + offset;
+    memcpy( out, &header, sizeof( header ) );
+    if ( length )
+      memcpy( out + sizeof( header ), payload, length );
+    if ( extraLength )
+      memcpy( out + sizeof( header ) + length, extra, extraLength );
+
+    if ( buffer_.size() >= c_captureFlushSize )
+      flush();
+  }
+
+  void CaptureWriter::flush()
+  {
+    if ( buffer_.empty() )
+      return;
+
+    file_.write( reinterpret_cast<const char*>( buffer_.data() ), static_cast<std::streamsize>( buffer_.size() ) );
+    buffer_.clear();
+  }
+
+  void CaptureWriter::deviceConnected( Device* device )
+  {
+    const auto& name = device->getName();
+
+    CaptureDeviceRecord record;
+    record.type = static_cast<uint8_t>( device->getType() );
+    record.handler = static_cast<uint8_t>( device->getHandler() );
+    record.nameLength = static_cast<uint16_t>( std::min( name.length(), static_cast<size_t>( 0xFFFF - sizeof( record ) ) ) );
+
+    write( currentTimestamp(), device->getStaticID(), Capture_DeviceConnected, &record, sizeof( record ), name.c_str(), record.nameLength );
+  }
+
+  void CaptureWriter::deviceDisconnected( Device* device )
+  {
+    write( currentTimestamp(), device->getStaticID(), Capture_DeviceDisconnected, nullptr, 0 );
+  }
+
+  void CaptureWriter::mouseEnabled( Device* device, Mouse* instance )
+  {
+    CaptureLayoutRecord record = {};
+    record.buttons = static_cast<uint16_t>( instance->getState().buttons.size() );
+
+    write( currentTimestamp(), device->getStaticID(), Capture_DeviceEnabled, &record, sizeof( record ) );
+
+    // Motion comes straight from the Mouse, before it gets coalesced
+    instance->addListener( this, Subscription( MouseEvent_ButtonPressed | MouseEvent_ButtonReleased ) );
+  }
+
+  void CaptureWriter::keyboardEnabled( Device* device, Keyboard* instance )
+  {
+    CaptureLayoutRecord record = {};
+
+    write( currentTimestamp(), device->getStaticID(), Capture_DeviceEnabled, &record, sizeof( record ) );
+    instance->addListener( this );
+  }
+
+  void CaptureWriter::controllerEnabled( Device* device, Controller* instance )
+  {
+    const auto& state = instance->getState();
+
+    CaptureLayoutRecord record;
+    record.buttons = static_cast<uint16_t>( state.buttons.size() );
+    record.axes = static_cast<uint16_t>( state.axes.size() );
+    record.sliders = static_cast<uint16_t>( state.sliders.size() );
+    record.povs = static_cast<uint16_t>( state.povs.size() );
+
+    write( currentTimestamp(), device->getStaticID(), Capture_DeviceEnabled, &record, sizeof( record ) );
+    instance->addListener( this );
+  }
+
+  void CaptureWriter::hidReport( Device* device, const uint8_t* data, size_t length )
+  {
+    // Reports come in through the instance, which has just been stamped
+    auto instance = device->getInstance();
+    auto timestamp = ( instance ? instance->getTimestamp() : currentTimestamp() );
+
+    write( timestamp, device->getStaticID(), Capture_HIDReport, data, std::min( length, static_cast<size_t>( 0xFFFF ) ) );
+  }
+
+  void CaptureWriter::mouseMotion( Mouse* mouse, const Vector2i& movement, int wheel )
+  {
+    auto timestamp = mouse->getTimestamp();
+    auto device = mouse->getDevice()->getStaticID();
+
+    if ( movement != Vector2i::ZERO )
+    {
+      CaptureVectorRecord record = { movement.x, movement.y };
+      write( timestamp, device, Capture_MouseMove, &record, sizeof( record ) );
+    }
+
+    if ( wheel != 0 )
+    {
+      CaptureIndexRecord record = { 0, wheel };
+      write( timestamp, device, Capture_MouseWheel, &record, sizeof( record ) );
+    }
+  }
+
+  void CaptureWriter::onMouseMoved( Mouse*, const MouseState& )
+  {
+    // Recorded in mouseMotion
+  }
+
+  void CaptureWriter::onMouseButtonPressed( Mouse* mouse, const MouseState& state, size_t button )
+  {
+    (void)state;
+
+    CaptureIndexRecord record = { static_cast<uint32_t>( button ), 1 };
+    write( mouse->getTimestamp(), mouse->getDevice()->getStaticID(), Capture_MouseButton, &record, sizeof( record ) );
+  }
+
+  void CaptureWriter::onMouseButtonReleased( Mouse* mouse, const MouseState& state, size_t button )
+  {
+    (void)state;
+
+    CaptureIndexRecord record = { static_cast<uint32_t>( button ), 0 };
+    write( mouse->getTimestamp(), mouse->getDevice()->getStaticID(), Capture_MouseButton, &record, sizeof( record ) );
+  }
+
+  void CaptureWriter::onMouseWheelMoved( Mouse*, const MouseState& )
+  {
+    // Recorded in mouseMotion
+  }
+
+  void CaptureWriter::onKeyPressed( Keyboard* keyboard, const VirtualKeyCode keycode )
+  {
+    CaptureIndexRecord record = { keycode, 0 };
+    write( keyboard->getTimestamp(), keyboard->getDevice()->getStaticID(), Capture_KeyPressed, &record, sizeof( record ) );
+  }
+
+  void CaptureWriter::onKeyRepeat( Keyboard* keyboard, const VirtualKeyCode keycode )
+  {
+    CaptureIndexRecord record = { keycode, 0 };
+    write( keyboard->getTimestamp(), keyboard->getDevice()->getStaticID(), Capture_KeyRepeat, &record, sizeof( record ) );
+  }
+
+  void CaptureWriter::onKeyReleased( Keyboard* keyboard, const VirtualKeyCode keycode )
+  {
+    CaptureIndexRecord record = { keycode, 0 };
+    write( keyboard->getTimestamp(), keyboard->getDevice()->getStaticID(), Capture_KeyReleased, &record, sizeof( record ) );
+  }
+
+  void CaptureWriter::onControllerButtonPressed( Controller* controller, const ControllerState& state, size_t button )
+  {
+    (void)state;
+
+    CaptureIndexRecord record = { static_cast<uint32_t>( button ), 1 };
+    write( controller->getTimestamp(), controller->getDevice()->getStaticID(), Capture_ControllerButton, &record, sizeof( record ) );
+  }
+
+  void CaptureWriter::onControllerButtonReleased( Controller* controller, const ControllerState& state, size_t button )
+  {
+    (void)state;
+
+    CaptureIndexRecord record = { static_cast<uint32_t>( button ), 0 };
+    write( controller->getTimestamp(), controller->getDevice()->getStaticID(), Capture_ControllerButton, &record, sizeof( record ) );
+  }
+
+  void CaptureWriter::onControllerAxisMoved( Controller* controller, const ControllerState& state, size_t axis )
+  {
+    CaptureRealRecord record = { static_cast<uint32_t>( axis ), state.axes[axis].absolute, NIL_REAL_ZERO };
+    write( controller->getTimestamp(), controller->getDevice()->getStaticID(), Capture_ControllerAxis, &record, sizeof( record ) );
+  }
+
+  void CaptureWriter::onControllerSliderMoved( Controller* controller, const ControllerState& state, size_t slider )
+  {
+    const auto& value = state.sliders[slider].absolute;
+    CaptureRealRecord record = { static_cast<uint32_t>( slider ), value.x, value.y };
+    write( controller->getTimestamp(), controller->getDevice()->getStaticID(), Capture_ControllerSlider, &record, sizeof( record ) );
+  }
+
+  void CaptureWriter::onControllerPOVMoved( Controller* controller, const ControllerState& state, size_t pov )
+  {
+    CaptureIndexRecord record = { static_cast<uint32_t>( pov ), static_cast<int32_t>( state.povs[pov].direction ) };
+    write( controller->getTimestamp(), controller->getDevice()->getStaticID(), Capture_ControllerPOV, &record, sizeof( record ) );
+  }
+
+  CaptureWriter::~CaptureWriter()
+  {
+    flush();
+  }
+
+  // MappedFile class
+
+#ifdef NIL_PLATFORM_WINDOWS
+
+  MappedFile::MappedFile( const utf8String& path )
+  {
+    file_ = CreateFileW( util::utf8ToWide( path ).c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if ( file_ == INVALID_HANDLE_VALUE )
+      NIL_EXCEPT_WINAPI( "CreateFileW failed" );
+
+    LARGE_INTEGER size;
+    if ( !GetFileSizeEx( file_, &size ) )
+      NIL_EXCEPT_WINAPI( "GetFileSizeEx failed" );
+
+    size_ = static_cast<size_t>( size.QuadPart );
+    if ( !size_ )
+      return;
+
+    mapping_ = CreateFileMappingW( file_, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    if ( !mapping_ )
+      NIL_EXCEPT_WINAPI( "CreateFileMappingW failed" );
+
+    data_ = static_cast<const uint8_t*>( MapViewOfFile( mapping_, FILE_MAP_READ, 0, 0, 0 ) );
+    if ( !data_ )
+      NIL_EXCEPT_WINAPI( "MapViewOfFile failed" );
+  }
+
+  MappedFile::~MappedFile()
+  {
+    if ( data_ )
+      UnmapViewOfFile( data_ );
+    if ( mapping_ )
+      CloseHandle( mapping_ );
+    if ( file_ != INVALID_HANDLE_VALUE )
+      CloseHandle( file_ );
+  }
+
+#elif defined( NIL_PLATFORM_LINUX )
+
+  MappedFile::MappedFile( const utf8String& path )
+  {
+    SafeDescriptor fd( open( path.c_str(), O_RDONLY | O_CLOEXEC ) );
+    if ( !fd.valid() )
+      NIL_EXCEPT_POSIX( "Could not open file" );
+
+    struct stat info;
+    if ( fstat( fd, &info ) != 0 )
+      NIL_EXCEPT_POSIX( "fstat failed" );
+
+    size_ = static_cast<size_t>( info.st_size );
+    if ( !size_ )
+      return;
+
+    // The mapping outlives the descriptor, so that can close right away
+    auto data = mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( data == MAP_FAILED )
+      NIL_EXCEPT_POSIX( "mmap failed" );
+
+    madvise( data, size_, MADV_SEQUENTIAL );
+    data_ = static_cast<const uint8_t*>( data );
+  }
+
+  MappedFile::~MappedFile()
+  {
+    if ( data_ )
+      munmap( const_cast<uint8_t*>( data_ ), size_ );
+  }
+
+#endif
+
+  // CaptureReplay class
+
+  CaptureReplay::CaptureReplay( SystemPtr system, const utf8String& path ):
+  system_( system ), file_( path ), position_( sizeof( c_captureMagic ) )
+  {
+    if ( file_.size() < sizeof( c_captureMagic ) || memcmp( file_.data(), c_captureMagic, sizeof( c_captureMagic ) ) != 0 )
+      NIL_EXCEPT( "Not a capture file, or an unsupported version" );
+
+    // Learn every recorded device up front, since a virtual device's
+    // layout has to be known when it's created, not when it's enabled.
+    for ( size_t offset = position_; offset + sizeof( CaptureRecordHeader ) <= file_.size(); )
+    {
+      auto header = reinterpret_cast<const CaptureRecordHeader*>( file_.data() + offset );
+      auto payload = file_.data() + offset + sizeof( CaptureRecordHeader );
+      offset += sizeof( CaptureRecordHeader ) + paddedLength( header->length );
+      if ( offset > file_.size() )
+        NIL_EXCEPT( "Capture file is truncated" );
+
+      if ( header->type == Capture_DeviceConnected && header->length >= sizeof( CaptureDeviceRecord ) )
+      {
+        auto record = reinterpret_cast<const CaptureDeviceRecord*>( payload );
+        auto& device = devices_[header->device];
+        device.type = static_cast<Device::Type>( record->type );
+        device.name.assign( reinterpret_cast<const char*>( payload + sizeof( CaptureDeviceRecord ) ),
+          std::min( static_cast<size_t>( record->nameLength ), header->length - sizeof( CaptureDeviceRecord ) ) );
+      }
+      else if ( header->type == Capture_DeviceEnabled && header->length >= sizeof( CaptureLayoutRecord ) )
+      {
+        auto record = reinterpret_cast<const CaptureLayoutRecord*>( payload );
+        auto& layout = devices_[header->device].layout;
+        layout.buttons = record->buttons;
+        layout.axes = record->axes;
+        layout.sliders = record->sliders;
+        layout.povs = record->povs;
+      }
+    }
+  }
+
+  void CaptureReplay::replay( const CaptureRecordHeader& header, const uint8_t* payload )
+  {
+    auto it = devices_.find( header.device );
+    if ( it == devices_.end() )
+      return;
+
+    auto& recorded = it->second;
+
+    if ( header.type == Capture_DeviceConnected )
+    {
+      if ( !recorded.device )
+        recorded.device = system_->createVirtualDevice( recorded.type, recorded.name, recorded.layout, header.device );
+      else if ( recorded.device->getStatus() == Device::Status_Disconnected )
+        system_->deviceConnect( recorded.device );
+      return;
+    }
+
+    if ( !recorded.device )
+      return;
+
+    if ( header.type == Capture_DeviceDisconnected )
+    {
+      if ( recorded.device->getStatus() == Device::Status_Connected )
+        system_->deviceDisconnect( recorded.device );
+      return;
+    }
+
+    // Nobody is listening if the application didn't enable the device
+    auto instance = recorded.device->getInstance();
+    if ( !instance )
+      return;
+
+    // Events happened as far apart as they did when recorded
+    auto timestamp = start_ + header.timestamp;
+
+    // Records too short for their payload are skipped, like damaged device records are
+    auto index = ( header.length >= sizeof( CaptureIndexRecord )
+      ? reinterpret_cast<const CaptureIndexRecord*>( payload ) : nullptr );
+    auto vector = ( header.length >= sizeof( CaptureVectorRecord )
+      ? reinterpret_cast<const CaptureVectorRecord*>( payload ) : nullptr );
+    auto real = ( header.length >= sizeof( CaptureRealRecord )
+      ? reinterpret_cast<const CaptureRealRecord*>( payload ) : nullptr );
+
+    switch ( header.type )
+    {
+      case Capture_MouseMove:
+        if ( auto mouse = dynamic_cast<VirtualMouse*>( instance ); mouse && vector )
+          mouse->injectMovement( Vector2i( vector->x, vector->y ), timestamp );
+      break;
+      case Capture_MouseButton:
+        if ( auto mouse = dynamic_cast<VirtualMouse*>( instance ); mouse && index )
+          mouse->injectButton( index->index, index->value != 0, timestamp );
+      break;
+      case Capture_MouseWheel:
+        if ( auto mouse = dynamic_cast<VirtualMouse*>( instance ); mouse && index )
+          mouse->injectWheel( index->value, timestamp );
+      break;
+      case Capture_KeyPressed:
+        if ( auto keyboard = dynamic_cast<VirtualKeyboard*>( instance ); keyboard && index )
+          keyboard->injectKeyPressed( index->index, timestamp );
+      break;
+      case Capture_KeyRepeat:
+        if ( auto keyboard = dynamic_cast<VirtualKeyboard*>( instance ); keyboard && index )
+          keyboard->injectKeyRepeat( index->index, timestamp );
+      break;
+      case Capture_KeyReleased:
+        if ( auto keyboard = dynamic_cast<VirtualKeyboard*>( instance ); keyboard && index )
+          keyboard->injectKeyReleased( index->index, timestamp );
+      break;
+      case Capture_ControllerButton:
+        if ( auto controller = dynamic_cast<VirtualController*>( instance ); controller && index )
+        {
+          controller->setButton( index->index, index->value != 0 );
+          controller->commit( timestamp );
+        }
+      break;
+      case Capture_ControllerAxis:
+        if ( auto controller = dynamic_cast<VirtualController*>( instance ); controller && real )
+        {
+          controller->setAxis( real->index, real->x );
+          controller->commit( timestamp );
+        }
+      break;
+      case Capture_ControllerSlider:
+        if ( auto controller = dynamic_cast<VirtualController*>( instance ); controller && real )
+        {
+          controller->setSlider( real->index, Vector2f( real->x, real->y ) );
+          controller->commit( timestamp );
+        }
+      break;
+      case Capture_ControllerPOV:
+        if ( auto controller = dynamic_cast<VirtualController*>( instance ); controller && index )
+        {
+          controller->setPOV( index->index, static_cast<POVDirection>( index->value ) );
+          controller->commit( timestamp );
+        }
+      break;
+      default:
+        // Enabling is up to the application, and raw reports are for inspection only
+      break;
+    }
+  }
+
+  void CaptureReplay::start()
+  {
+    if ( started_ )
+      return;
+
+    start_ = currentTimestamp();
+    started_ = true;
+  }
+
+  bool CaptureReplay::advance( uint64_t until )
+  {
+    start();
+
+    while ( position_ + sizeof( CaptureRecordHeader ) <= file_.size() )
+    {
+      auto header = reinterpret_cast<const CaptureRecordHeader*>( file_.data() + position_ );
+      if ( header->timestamp > until )
+        return true;
+
+      position_ += sizeof( CaptureRecordHeader ) + paddedLength( header->length );
+      replay( *header, reinterpret_cast<const uint8_t*>( header + 1 ) );
+    }
+
+    return false;
+  }
+
+  bool CaptureReplay::update()
+  {
+    start();
+
+    return advance( currentTimestamp() - start_ );
+  }
+
+  void CaptureReplay::runToEnd()
+  {
+    advance( UINT64_MAX );
+  }
+
+  bool CaptureReplay::isFinished() const
+  {
+    return ( position_ + sizeof( CaptureRecordHeader ) > file_.size() );
+  }
+
+  CaptureReplay::~CaptureReplay()
+  {
+  }
+
+}
\ No newline at end of file
@@ -29,43 +29,89 @@ namespace nil {
 
   // Controller class
 
-  Controller::Controller( SystemPtr system, DevicePtr device ):
-  DeviceInstance( system, device ), type_( Controller_Unknown )
+  Controller::Controller( System* system, Device* device ):
+  DeviceInstance( system, device ), type_( Controller_Unknown ),
+  snapshot_( make_shared<SeqLock<ControllerSnapshot>>() )
   {
   }
 
   void Controller::fireChanges( const ControllerState& lastState )
   {
-    // Notify all our listeners
-    for ( auto& listener : listeners_ )
-    {
-      // Buttons
-      for ( size_t i = 0; i < state_.buttons.size(); i++ )
-        if ( !lastState.buttons[i].pushed && state_.buttons[i].pushed )
+    // Each change is a dispatch of its own, so that a listener
+    // removed by one of its callbacks won't get any further ones.
+
+    // Buttons
+    for ( size_t i = 0; i < state_.buttons.size(); i++ )
+      if ( !lastState.buttons[i].pushed && state_.buttons[i].pushed )
+      {
+        for ( auto listener : listeners_.dispatch( ControllerEvent_ButtonPressed, i ) )
           listener->onControllerButtonPressed( this, state_, i );
-        else if ( lastState.buttons[i].pushed && !state_.buttons[i].pushed )
+        if ( *eventSink_ )
+        {
+          auto event = makeEvent( Event_ControllerButton, static_cast<uint32_t>( i ) );
+          event.pushed = true;
+          ( *eventSink_ )( event );
+        }
+      }
+      else if ( lastState.buttons[i].pushed && !state_.buttons[i].pushed )
+      {
+        for ( auto listener : listeners_.dispatch( ControllerEvent_ButtonReleased, i ) )
           listener->onControllerButtonReleased( this, state_, i );
-
-      // Axes
-      for ( size_t i = 0; i < state_.axes.size(); i++ )
-        if ( lastState.axes[i].absolute != state_.axes[i].absolute )
+        if ( *eventSink_ )
+        {
+          auto event = makeEvent( Event_ControllerButton, static_cast<uint32_t>( i ) );
+          event.pushed = false;
+          ( *eventSink_ )( event );
+        }
+      }
+
+    // Axes
+    for ( size_t i = 0; i < state_.axes.size(); i++ )
+      if ( lastState.axes[i].absolute != state_.axes[i].absolute )
+      {
+        for ( auto listener : listeners_.dispatch( ControllerEvent_AxisMoved, i ) )
           listener->onControllerAxisMoved( this, state_, i );
-
-      // Sliders
-      for ( size_t i = 0; i < state_.sliders.size(); i++ )
-        if ( lastState.sliders[i].absolute != state_.sliders[i].absolute )
+        if ( *eventSink_ )
+        {
+          auto event = makeEvent( Event_ControllerAxis, static_cast<uint32_t>( i ) );
+          event.axis = state_.axes[i].absolute;
+          ( *eventSink_ )( event );
+        }
+      }
+
+    // Sliders
+    for ( size_t i = 0; i < state_.sliders.size(); i++ )
+      if ( lastState.sliders[i].absolute != state_.sliders[i].absolute )
+      {
+        for ( auto listener : listeners_.dispatch( ControllerEvent_SliderMoved, i ) )
           listener->onControllerSliderMoved( this, state_, i );
-
-      // POVs
-      for ( size_t i = 0; i < state_.povs.size(); i++ )
-        if ( lastState.povs[i].direction != state_.povs[i].direction )
+        if ( *eventSink_ )
+        {
+          auto event = makeEvent( Event_ControllerSlider, static_cast<uint32_t>( i ) );
+          event.slider.x = state_.sliders[i].absolute.x;
+          event.slider.y = state_.sliders[i].absolute.y;
+          ( *eventSink_ )( event );
+        }
+      }
+
+    // POVs
+    for ( size_t i = 0; i < state_.povs.size(); i++ )
+      if ( lastState.povs[i].direction != state_.povs[i].direction )
+      {
+        for ( auto listener : listeners_.dispatch( ControllerEvent_POVMoved, i ) )
           listener->onControllerPOVMoved( this, state_, i );
-    }
+        if ( *eventSink_ )
+        {
+          auto event = makeEvent( Event_ControllerPOV, static_cast<uint32_t>( i ) );
+          event.direction = state_.povs[i].direction;
+          ( *eventSink_ )( event );
+        }
+      }
   }
 
-  void Controller::addListener( ControllerListener* listener )
+  ListenerToken Controller::addListener( ControllerListener * listener, const Subscription& subscription )
   {
-    listeners_.push_back( listener );
+    return listeners_.add( listener, subscription );
   }
 
   void Controller::removeListener( ControllerListener* listener )
@@ -73,6 +119,17 @@ namespace nil {
     listeners_.remove( listener );
   }
 
+  void Controller::removeListener( ListenerToken token )
+  {
+    listeners_.remove( token );
+  }
+
+  void Controller::setSubscription( ListenerToken token, const Subscription& subscription )
+  {
+    if ( !listeners_.subscribe( token, subscription ) )
+      NIL_EXCEPT( "No listener with that token" );
+  }
+
   Controller::Type Controller::getType() const
   {
     return type_;
@@ -83,6 +140,41 @@ namespace nil {
     return state_;
   }
 
+  void Controller::publishSnapshot()
+  {
+    ControllerSnapshot snapshot = {};
+    snapshot.timestamp = timestamp_;
+    snapshot.buttonCount = static_cast<uint32_t>( std::min( state_.buttons.size(), c_snapshotButtons ) );
+    snapshot.axisCount = static_cast<uint32_t>( std::min( state_.axes.size(), c_snapshotAxes ) );
+    snapshot.sliderCount = static_cast<uint32_t>( std::min( state_.sliders.size(), c_snapshotSliders ) );
+    snapshot.povCount = static_cast<uint32_t>( std::min( state_.povs.size(), c_snapshotPOVs ) );
+
+    for ( size_t i = 0; i < snapshot.buttonCount; i++ )
+      if ( state_.buttons[i].pushed )
+        snapshot.buttons[i / 64] |= ( 1ULL << ( i % 64 ) );
+
+    for ( size_t i = 0; i < snapshot.axisCount; i++ )
+      snapshot.axes[i] = state_.axes[i].absolute;
+
+    for ( size_t i = 0; i < snapshot.sliderCount; i++ )
+      snapshot.sliders[i] = state_.sliders[i].absolute;
+
+    for ( size_t i = 0; i < snapshot.povCount; i++ )
+      snapshot.povs[i] = state_.povs[i].direction;
+
+    snapshot_->store( snapshot );
+  }
+
+  ControllerSnapshot Controller::getSnapshot() const
+  {
+    return snapshot_->load();
+  }
+
+  ControllerSnapshotSource Controller::getSnapshotSource() const
+  {
+    return snapshot_;
+  }
+
   Controller::~Controller()
   {
   }
@@ -5,7 +5,7 @@
 
 namespace nil {
 
-  Device::Device( SystemPtr system, DeviceID id, Type type ):
+  Device::Device( System* system, DeviceID id, Type type ):
   type_( type ), system_( system ), id_( id )
   {
     // Get our type-specific index
@@ -31,7 +31,31 @@ namespace nil {
     if ( instance_ || status_ != Status_Connected )
       return;
 
-    if ( getHandler() == Handler_XInput )
+    if ( getHandler() == Handler_Virtual )
+    {
+      auto virtualDevice = dynamic_pointer_cast<VirtualDevice>( ptr() );
+      if ( !virtualDevice )
+        NIL_EXCEPT( "Dynamic cast failed for VirtualDevice" );
+      if ( getType() == Device_Mouse )
+      {
+        instance_ = make_shared<VirtualMouse>( virtualDevice )->ptr();
+        system_->mouseEnabled( ptr(), dynamic_pointer_cast<Mouse>( instance_->ptr() ) );
+      }
+      else if ( getType() == Device_Keyboard )
+      {
+        instance_ = make_shared<VirtualKeyboard>( virtualDevice )->ptr();
+        system_->keyboardEnabled( ptr(), dynamic_pointer_cast<Keyboard>( instance_->ptr() ) );
+      }
+      else if ( getType() == Device_Controller )
+      {
+        instance_ = make_shared<VirtualController>( virtualDevice )->ptr();
+        system_->controllerEnabled( ptr(), dynamic_pointer_cast<Controller>( instance_->ptr() ) );
+      }
+      else
+        NIL_EXCEPT( "Unsupported device type for virtual device; cannot instantiate device!" );
+    }
+#ifdef NIL_PLATFORM_WINDOWS
+    else if ( getHandler() == Handler_XInput )
     {
       auto xDevice = dynamic_pointer_cast<XInputDevice>( ptr() );
       if ( !xDevice )
@@ -80,6 +104,39 @@ namespace nil {
       else
         NIL_EXCEPT( "Unsupported device type for RawInput; cannot instantiate device!" );
     }
+#elif defined( NIL_PLATFORM_LINUX )
+    else if ( getHandler() == Handler_Evdev )
+    {
+      auto evDevice = dynamic_pointer_cast<EvdevDevice>( ptr() );
+      if ( !evDevice )
+        NIL_EXCEPT( "Dynamic cast failed for EvdevDevice" );
+      if ( getType() == Device_Mouse )
+      {
+        instance_ = make_shared<EvdevMouse>( evDevice, system_->getDefaultMouseButtonSwapping() )->ptr();
+        system_->mouseEnabled( ptr(), dynamic_pointer_cast<Mouse>( instance_->ptr() ) );
+      }
+      else if ( getType() == Device_Keyboard )
+      {
+        instance_ = make_shared<EvdevKeyboard>( evDevice )->ptr();
+        system_->keyboardEnabled( ptr(), dynamic_pointer_cast<Keyboard>( instance_->ptr() ) );
+      }
+      else if ( getType() == Device_Controller )
+      {
+        instance_ = make_shared<EvdevController>( evDevice )->ptr();
+        system_->controllerEnabled( ptr(), dynamic_pointer_cast<Controller>( instance_->ptr() ) );
+      }
+      else
+        NIL_EXCEPT( "Unsupported device type for evdev; cannot instantiate device!" );
+    }
+    else if ( getHandler() == Handler_HID )
+    {
+      auto hidDevice = dynamic_pointer_cast<HidrawDevice>( ptr() );
+      if ( !hidDevice )
+        NIL_EXCEPT( "Dynamic cast failed for HidrawDevice" );
+      instance_ = make_shared<HidrawController>( hidDevice )->ptr();
+      system_->controllerEnabled( ptr(), dynamic_pointer_cast<Controller>( instance_->ptr() ) );
+    }
+#endif
     else
       NIL_EXCEPT( "Unsupported device handler; Cannot instantiate device!" );
   }
@@ -92,7 +149,10 @@ namespace nil {
   void Device::update()
   {
     if ( instance_ )
+    {
       instance_->update();
+      instance_->publishSnapshot();
+    }
   }
 
   void Device::disable()
@@ -143,7 +203,7 @@ namespace nil {
 
   System* Device::getSystem()
   {
-    return system_.get();
+    return system_;
   }
 
   DeviceID Device::getID() const
@@ -5,17 +5,26 @@
 
 namespace nil {
 
-  DeviceInstance::DeviceInstance( SystemPtr system, DevicePtr device ):
-  system_( system ), device_( device )
+  DeviceInstance::DeviceInstance( System* system, Device* device ):
+  system_( system ), device_( device ), eventSink_( &system->eventSink_ )
   {
     assert( device_ );
   }
 
-  const DevicePtr DeviceInstance::getDevice() const
+  Device* DeviceInstance::getDevice() const
   {
     return device_;
   }
 
+  void DeviceInstance::publishSnapshot()
+  {
+  }
+
+  Timestamp DeviceInstance::getTimestamp() const
+  {
+    return timestamp_;
+  }
+
   DeviceInstance::~DeviceInstance()
   {
   }
@@ -0,0 +1,218 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+namespace nil {
+
+  EventQueue::EventQueue( size_t capacity )
+  {
+    size_t size = 1;
+    while ( size < capacity )
+      size <<= 1;
+
+    events_.resize( size );
+    mask_ = size - 1;
+  }
+
+  Event* EventQueue::push( DeviceInstance* instance, EventType type, uint32_t index )
+  {
+    if ( tail_ - head_ == events_.size() )
+    {
+      dropped_++;
+      return nullptr;
+    }
+
+    auto event = &events_[tail_++ & mask_];
+    event->timestamp = instance->getTimestamp();
+    event->device = instance->getDevice()->getID();
+    event->type = type;
+    event->index = index;
+    return event;
+  }
+
+  size_t EventQueue::poll( std::span<Event> events )
+  {
+    size_t count = std::min( events.size(), tail_ - head_ );
+
+    // At most two contiguous runs, split where the ring wraps around
+    size_t first = std::min( count, events_.size() - ( head_ & mask_ ) );
+    std::copy_n( events_.data() + ( head_ & mask_ ), first, events.data() );
+    std::copy_n( events_.data(), count - first, events.data() + first );
+
+    head_ += count;
+    return count;
+  }
+
+  size_t EventQueue::size() const
+  {
+    return ( tail_ - head_ );
+  }
+
+  size_t EventQueue::capacity() const
+  {
+    return events_.size();
+  }
+
+  size_t EventQueue::dropped() const
+  {
+    return dropped_;
+  }
+
+  void EventQueue::onMouseMoved( Mouse* mouse, const MouseState& state )
+  {
+    if ( auto event = push( mouse, Event_MouseMove, 0 ) )
+    {
+      event->movement.x = state.movement.relative.x;
+      event->movement.y = state.movement.relative.y;
+    }
+  }
+
+  void EventQueue::onMouseButtonPressed( Mouse* mouse, const MouseState&, size_t button )
+  {
+    if ( auto event = push( mouse, Event_MouseButton, static_cast<uint32_t>( button ) ) )
+      event->pushed = true;
+  }
+
+  void EventQueue::onMouseButtonReleased( Mouse* mouse, const MouseState&, size_t button )
+  {
+    if ( auto event = push( mouse, Event_MouseButton, static_cast<uint32_t>( button ) ) )
+      event->pushed = false;
+  }
+
+  void EventQueue::onMouseWheelMoved( Mouse* mouse, const MouseState& state )
+  {
+    if ( auto event = push( mouse, Event_MouseWheel, 0 ) )
+      event->wheel = state.wheel.relative;
+  }
+
+  void EventQueue::onKeyPressed( Keyboard* keyboard, const VirtualKeyCode keycode )
+  {
+    push( keyboard, Event_KeyPressed, keycode );
+  }
+
+  void EventQueue::onKeyRepeat( Keyboard* keyboard, const VirtualKeyCode keycode )
+  {
+    push( keyboard, Event_KeyRepeat, keycode );
+  }
+
+  void EventQueue::onKeyReleased( Keyboard* keyboard, const VirtualKeyCode keycode )
+  {
+    push( keyboard, Event_KeyReleased, keycode );
+  }
+
+  void EventQueue::onControllerButtonPressed( Controller* controller, const ControllerState&, size_t button )
+  {
+    if ( auto event = push( controller, Event_ControllerButton, static_cast<uint32_t>( button ) ) )
+      event->pushed = true;
+  }
+
+  void EventQueue::onControllerButtonReleased( Controller* controller, const ControllerState&, size_t button )
+  {
+    if ( auto event = push( controller, Event_ControllerButton, static_cast<uint32_t>( button ) ) )
+      event->pushed = false;
+  }
+
+  void EventQueue::onControllerAxisMoved( Controller* controller, const ControllerState& state, size_t axis )
+  {
+    if ( auto event = push( controller, Event_ControllerAxis, static_cast<uint32_t>( axis ) ) )
+      event->axis = state.axes[axis].absolute;
+  }
+
+  void EventQueue::onControllerSliderMoved( Controller* controller, const ControllerState& state, size_t slider )
+  {
+    if ( auto event = push( controller, Event_ControllerSlider, static_cast<uint32_t>( slider ) ) )
+    {
+      event->slider.x = state.sliders[slider].absolute.x;
+      event->slider.y = state.sliders[slider].absolute.y;
+    }
+  }
+
+  void EventQueue::onControllerPOVMoved( Controller* controller, const ControllerState& state, size_t pov )
+  {
+    if ( auto event = push( controller, Event_ControllerPOV, static_cast<uint32_t>( pov ) ) )
+      event->direction = state.povs[pov].direction;
+  }
+
+  // PacketRing class
+
+  // Marks the unused end of the ring, skipped when a packet didn't fit there
+  const uint64_t c_paddingSource = ~0ULL;
+
+  PacketRing::PacketRing( size_t capacity )
+  {
+    size_t count = 2;
+    while ( count * sizeof( Packet ) < capacity )
+      count <<= 1;
+
+    slots_.resize( count );
+    mask_ = count - 1;
+  }
+
+  bool PacketRing::write( uint64_t source, Timestamp timestamp, const void* data, size_t length, int32_t error )
+  {
+    size_t slots = 1 + ( length + sizeof( Packet ) - 1 ) / sizeof( Packet );
+    assert( slots <= slots_.size() / 2 );
+
+    // Packets are kept contiguous; if this one won't fit before the end,
+    // the end is skipped over and it goes to the start instead.
+    size_t tail = tail_.load( std::memory_order_relaxed );
+    size_t contiguous = slots_.size() - ( tail & mask_ );
+    size_t needed = ( contiguous < slots ? contiguous + slots : slots );
+
+    if ( tail + needed - cachedHead_ > slots_.size() )
+    {
+      cachedHead_ = head_.load( std::memory_order_acquire );
+      if ( tail + needed - cachedHead_ > slots_.size() )
+        return false;
+    }
+
+    if ( contiguous < slots )
+    {
+      auto padding = &slots_[tail & mask_];
+      padding->source = c_paddingSource;
+      padding->slots = static_cast<uint32_t>( contiguous );
+      tail += contiguous;
+    }
+
+    auto packet = &slots_[tail & mask_];
+    packet->source = source;
+    packet->timestamp = timestamp;
+    packet->length = static_cast<uint32_t>( length );
+    packet->error = error;
+    packet->slots = static_cast<uint32_t>( slots );
+    if ( length )
+      memcpy( packet + 1, data, length );
+
+    tail_.store( tail + slots, std::memory_order_release );
+    return true;
+  }
+
+  const PacketRing::Packet* PacketRing::front()
+  {
+    size_t head = head_.load( std::memory_order_relaxed );
+    while ( true )
+    {
+      if ( head == cachedTail_ )
+      {
+        cachedTail_ = tail_.load( std::memory_order_acquire );
+        if ( head == cachedTail_ )
+          return nullptr;
+      }
+
+      auto packet = &slots_[head & mask_];
+      if ( packet->source != c_paddingSource )
+        return packet;
+
+      head += packet->slots;
+      head_.store( head, std::memory_order_release );
+    }
+  }
+
+  void PacketRing::pop()
+  {
+    size_t head = head_.load( std::memory_order_relaxed );
+    head_.store( head + slots_[head & mask_].slots, std::memory_order_release );
+  }
+
+}
\ No newline at end of file
@@ -41,6 +41,14 @@ namespace nil {
         stream << "\r\nDirectInput error code " << std::hex << error.code << ":\r\n" << util::wideToUtf8( error.description );
       }
 
+#else
+
+      if ( type_ == POSIX )
+      {
+        const POSIXError& error = std::get<POSIXError>( additional_ );
+        stream << "\nSystem error " << error.code << ": " << error.description;
+      }
+
 #endif
 
       fullDescription_ = stream.str();
@@ -132,4 +140,19 @@ namespace nil {
 
 #endif
 
+#ifdef NIL_PLATFORM_LINUX
+
+  void Exception::handleAdditional()
+  {
+    if ( type_ == POSIX )
+    {
+      POSIXError error;
+      error.code = errno;
+      error.description = strerror( error.code );
+      additional_ = error;
+    }
+  }
+
+#endif
+
 }
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilHID.h"
+
+namespace nil {
+
+  namespace hid {
+
+    // clang-format off
+
+    const vector<KnownDeviceRecord> c_predefinedControllers = {
+      { USBVendor_Sony, 0x05C4, KnownDevice_DualShock4, "DualShock 4", 18 },
+      { USBVendor_Sony, 0x09CC, KnownDevice_DualShock4, "DualShock 4", 18 },
+      { USBVendor_Sony, 0x0CE6, KnownDevice_DualSense, "DualSense", 9 }
+    };
+
+    // clang-format on
+
+    const KnownDeviceRecord* resolveKnownDevice( uint16_t vid, uint16_t pid )
+    {
+      for ( const auto& predef : c_predefinedControllers )
+      {
+        if ( vid == predef.vid && pid == predef.pid )
+          return &predef;
+      }
+
+      return nullptr;
+    }
+
+    bool hasReportParser( KnownDeviceType type )
+    {
+      return ( type == KnownDevice_DualSense );
+    }
+
+    inline Real filterThumbAxis( int val, int deadzone )
+    {
+      if ( val < 0 )
+      {
+        if ( val > -deadzone )
+          return NIL_REAL_ZERO;
+        val += deadzone;
+        auto ret = static_cast<Real>( val ) / static_cast<Real>( 128 - deadzone );
+        return ( ret < NIL_REAL_MINUSONE ? NIL_REAL_MINUSONE : ret );
+      }
+      if ( val > 0 )
+      {
+        if ( val < deadzone )
+          return NIL_REAL_ZERO;
+        val -= deadzone;
+        auto ret = static_cast<Real>( val ) / static_cast<Real>( 127 - deadzone );
+        return ( ret > NIL_REAL_ONE ? NIL_REAL_ONE : ret );
+      }
+      return NIL_REAL_ZERO;
+    }
+
+    inline Real filterTrigger( int val, int deadzone )
+    {
+      if ( val < deadzone )
+        return NIL_REAL_ZERO;
+      val -= deadzone;
+      auto ret = static_cast<Real>( val ) / static_cast<Real>( 255 - deadzone );
+      return ( ret > NIL_REAL_ONE ? NIL_REAL_ONE : ret );
+    }
+
+    void setupDualSense( ControllerState& state )
+    {
+      state.povs.resize( 1 );
+      state.axes.resize( 6 );
+      state.buttons.resize( 19 );
+    }
+
+    bool parseDualSense( const uint8_t* report, size_t length, HIDConnectionType connection, ControllerState& state )
+    {
+      // Over Bluetooth, only the full 0x31 report carries everything,
+      // and it has one extra byte in front of the same layout USB uses.
+      if ( connection == HIDConnection_Bluetooth && ( length < 1 || report[0] != 0x31 ) )
+        return false;
+
+      const size_t offset = ( connection == HIDConnection_Bluetooth ? 1 : 0 );
+      if ( length < 11 + offset )
+        return false;
+
+      auto buf = report + offset;
+
+      state.axes[0].absolute = filterThumbAxis( buf[1] - 128, 5 );
+      state.axes[1].absolute = filterThumbAxis( buf[2] - 128, 5 );
+      state.axes[2].absolute = filterThumbAxis( buf[3] - 128, 5 );
+      state.axes[3].absolute = filterThumbAxis( buf[4] - 128, 5 );
+      state.axes[4].absolute = filterTrigger( buf[5], 30 );
+      state.axes[5].absolute = filterTrigger( buf[6], 30 );
+
+      auto tmp = buf[8];
+      state.buttons[0].pushed = ( tmp & ( 1 << 7 ) ) != 0; // Triangle
+      state.buttons[1].pushed = ( tmp & ( 1 << 6 ) ) != 0; // Circle
+      state.buttons[2].pushed = ( tmp & ( 1 << 5 ) ) != 0; // Cross
+      state.buttons[3].pushed = ( tmp & ( 1 << 4 ) ) != 0; // Square
+
+      POVDirection& pov = state.povs[0].direction;
+      pov = POV::Centered;
+      switch ( tmp & 0x0F )
+      {
+        case 0x0: pov = POV::North; break;
+        case 0x4: pov = POV::South; break;
+        case 0x6: pov = POV::West; break;
+        case 0x2: pov = POV::East; break;
+        case 0x5: pov = POV::SouthWest; break;
+        case 0x7: pov = POV::NorthWest; break;
+        case 0x1: pov = POV::NorthEast; break;
+        case 0x3: pov = POV::SouthEast; break;
+      }
+
+      tmp = buf[9];
+      state.buttons[4].pushed = ( tmp & ( 1 << 7 ) ) != 0; // Right stick
+      state.buttons[5].pushed = ( tmp & ( 1 << 6 ) ) != 0; // Left stick
+      state.buttons[6].pushed = ( tmp & ( 1 << 5 ) ) != 0; // Options
+      state.buttons[7].pushed = ( tmp & ( 1 << 4 ) ) != 0; // Create/Share
+      state.buttons[8].pushed = ( tmp & ( 1 << 3 ) ) != 0; // R2
+      state.buttons[9].pushed = ( tmp & ( 1 << 2 ) ) != 0; // L2
+      state.buttons[10].pushed = ( tmp & ( 1 << 1 ) ) != 0; // R1
+      state.buttons[11].pushed = ( tmp & ( 1 << 0 ) ) != 0; // L1
+
+      tmp = buf[10];
+      state.buttons[12].pushed = ( tmp & ( 1 << 0 ) ) != 0; // PS logo
+      state.buttons[13].pushed = ( tmp & 0x02 ) != 0; // Touchpad
+      state.buttons[14].pushed = ( tmp & ( 1 << 2 ) ) != 0; // Mic button
+      state.buttons[15].pushed = ( tmp & ( 1 << 4 ) ) != 0;
+      state.buttons[16].pushed = ( tmp & ( 1 << 5 ) ) != 0;
+      state.buttons[17].pushed = ( tmp & ( 1 << 6 ) ) != 0;
+      state.buttons[18].pushed = ( tmp & ( 1 << 7 ) ) != 0;
+
+      return true;
+    }
+
+  }
+
+}
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+namespace nil {
+
+  // Either side's keys of each modifier
+  const KeyMask c_controlKeys = { Keyboard::Key_LeftControl, Keyboard::Key_RightControl };
+  const KeyMask c_shiftKeys = { Keyboard::Key_LeftShift, Keyboard::Key_RightShift };
+  const KeyMask c_altKeys = { Keyboard::Key_LeftAlt, Keyboard::Key_RightAlt };
+  const KeyMask c_superKeys = { 0x5B, 0x5C }; // VK_LWIN, VK_RWIN
+
+  const uint32_t c_allModifiers = ( Modifier_Control | Modifier_Shift | Modifier_Alt | Modifier_Super );
+
+  // Key codes fit in the lower half of a chord's edge key, with room to spare
+  const VirtualKeyCode c_maxChordKey = 0xFFFF;
+
+  HotkeyRegistry::HotkeyRegistry( HotkeyListener* listener ): listener_( listener )
+  {
+    assert( listener_ );
+
+    // The start of every hotkey
+    nodes_.emplace_back();
+  }
+
+  uint64_t HotkeyRegistry::makeEdge( uint32_t node, const Chord& chord )
+  {
+    return ( ( static_cast<uint64_t>( node ) << 32 )
+      | ( static_cast<uint64_t>( chord.modifiers ) << 16 )
+      | chord.key );
+  }
+
+  uint32_t HotkeyRegistry::findNode( uint32_t node, const Chord& chord ) const
+  {
+    auto it = edges_.find( makeEdge( node, chord ) );
+    return ( it != edges_.end() ? it->second : 0 );
+  }
+
+  HotkeyID HotkeyRegistry::add( const Chord& chord )
+  {
+    return add( std::span<const Chord>( &chord, 1 ) );
+  }
+
+  HotkeyID HotkeyRegistry::add( std::span<const Chord> sequence )
+  {
+    if ( sequence.empty() )
+      NIL_EXCEPT( "Empty hotkey sequence" );
+
+    for ( const auto& chord : sequence )
+    {
+      if ( chord.key == Keyboard::Key_Invalid || chord.key > c_maxChordKey
+        || isModifierKey( chord.key ) || ( chord.modifiers & ~c_allModifiers ) )
+        NIL_EXCEPT( "Invalid hotkey chord" );
+    }
+
+    // Follow the chords we already have, making sure that neither
+    // hotkey is the start of the other, before changing anything
+    uint32_t node = 0;
+    size_t matched = 0;
+    for ( ; matched < sequence.size(); matched++ )
+    {
+      auto next = findNode( node, sequence[matched] );
+      if ( !next )
+        break;
+
+      if ( nodes_[next].hotkey )
+        NIL_EXCEPT( "Hotkey conflicts with one already registered" );
+
+      node = next;
+    }
+
+    if ( matched == sequence.size() )
+      NIL_EXCEPT( "Hotkey conflicts with one already registered" );
+
+    for ( ; matched < sequence.size(); matched++ )
+    {
+      uint32_t next;
+      if ( !freeNodes_.empty() )
+      {
+        next = freeNodes_.back();
+        freeNodes_.pop_back();
+      }
+      else
+      {
+        next = static_cast<uint32_t>( nodes_.size() );
+        nodes_.emplace_back();
+      }
+
+      auto edge = makeEdge( node, sequence[matched] );
+      nodes_[next] = Node { 0, node, edge, 0 };
+      nodes_[node].children++;
+      edges_[edge] = next;
+      node = next;
+    }
+
+    auto hotkey = nextID_++;
+    nodes_[node].hotkey = hotkey;
+    hotkeys_[hotkey] = node;
+
+    return hotkey;
+  }
+
+  void HotkeyRegistry::remove( HotkeyID hotkey )
+  {
+    auto it = hotkeys_.find( hotkey );
+    if ( it == hotkeys_.end() )
+      NIL_EXCEPT( "No hotkey by that ID" );
+
+    uint32_t node = it->second;
+    hotkeys_.erase( it );
+    nodes_[node].hotkey = 0;
+
+    // Drop the chords no other hotkey goes through
+    while ( node != 0 && !nodes_[node].hotkey && !nodes_[node].children )
+    {
+      auto parent = nodes_[node].parent;
+      edges_.erase( nodes_[node].edge );
+      nodes_[parent].children--;
+      freeNodes_.push_back( node );
+
+      std::erase_if( pending_, [node]( const Pending& pending ) { return pending.node == node; } );
+
+      node = parent;
+    }
+  }
+
+  void HotkeyRegistry::clear()
+  {
+    nodes_.resize( 1 );
+    nodes_[0] = Node();
+    freeNodes_.clear();
+    edges_.clear();
+    hotkeys_.clear();
+    pending_.clear();
+  }
+
+  size_t HotkeyRegistry::size() const
+  {
+    return hotkeys_.size();
+  }
+
+  void HotkeyRegistry::setSequenceTimeout( Timestamp timeout )
+  {
+    sequenceTimeout_ = timeout;
+  }
+
+  uint32_t HotkeyRegistry::getModifiers( const Keyboard* keyboard )
+  {
+    auto& keys = keyboard->getKeys();
+
+    uint32_t modifiers = Modifier_None;
+    if ( keys.any( c_controlKeys ) )
+      modifiers |= Modifier_Control;
+    if ( keys.any( c_shiftKeys ) )
+      modifiers |= Modifier_Shift;
+    if ( keys.any( c_altKeys ) )
+      modifiers |= Modifier_Alt;
+    if ( keys.any( c_superKeys ) )
+      modifiers |= Modifier_Super;
+
+    return modifiers;
+  }
+
+  bool HotkeyRegistry::isModifierKey( VirtualKeyCode key )
+  {
+    return ( c_controlKeys.test( key ) || c_shiftKeys.test( key )
+      || c_altKeys.test( key ) || c_superKeys.test( key ) );
+  }
+
+  void HotkeyRegistry::onKeyPressed( Keyboard* keyboard, const VirtualKeyCode keycode )
+  {
+    // Modifiers only ever go along with a chord's key
+    if ( isModifierKey( keycode ) )
+      return;
+
+    Chord chord { getModifiers( keyboard ), keycode };
+    auto timestamp = keyboard->getTimestamp();
+
+    // Every keyboard goes through its sequences on its own; there are
+    // seldom more than a few at once, so a scan beats a hash here
+    auto pending = std::find_if( pending_.begin(), pending_.end(),
+      [keyboard]( const Pending& entry ) { return entry.keyboard == keyboard; } );
+
+    uint32_t from = 0;
+    if ( pending != pending_.end() && timestamp <= pending->time + sequenceTimeout_ )
+      from = pending->node;
+
+    auto node = findNode( from, chord );
+
+    // A chord that breaks off a sequence may still start another
+    if ( !node && from )
+      node = findNode( 0, chord );
+
+    if ( !node || nodes_[node].hotkey )
+    {
+      if ( pending != pending_.end() )
+        pending_.erase( pending );
+      if ( node )
+        listener_->onHotkey( keyboard, nodes_[node].hotkey );
+      return;
+    }
+
+    if ( pending != pending_.end() )
+    {
+      pending->node = node;
+      pending->time = timestamp;
+    }
+    else
+      pending_.push_back( { keyboard, node, timestamp } );
+  }
+
+  void HotkeyRegistry::onKeyRepeat( Keyboard*, const VirtualKeyCode )
+  {
+    // Holding a chord down doesn't trigger its hotkey again
+  }
+
+  void HotkeyRegistry::onKeyReleased( Keyboard*, const VirtualKeyCode )
+  {
+  }
+
+}
\ No newline at end of file
@@ -5,14 +5,15 @@
 
 namespace nil {
 
-  Keyboard::Keyboard( SystemPtr system, DevicePtr device ):
-  DeviceInstance( system, device )
+  Keyboard::Keyboard( System* system, Device* device ):
+  DeviceInstance( system, device ),
+  snapshot_( make_shared<SeqLock<KeyboardSnapshot>>() )
   {
   }
 
-  void Keyboard::addListener( KeyboardListener* listener )
+  ListenerToken Keyboard::addListener( KeyboardListener* listener, const Subscription& subscription )
   {
-    listeners_.push_back( listener );
+    return listeners_.add( listener, subscription );
   }
 
   void Keyboard::removeListener( KeyboardListener* listener )
@@ -20,6 +21,90 @@ namespace nil {
     listeners_.remove( listener );
   }
 
+  void Keyboard::removeListener( ListenerToken token )
+  {
+    listeners_.remove( token );
+  }
+
+  void Keyboard::setSubscription( ListenerToken token, const Subscription& subscription )
+  {
+    if ( !listeners_.subscribe( token, subscription ) )
+      NIL_EXCEPT( "No listener with that token" );
+  }
+
+  void Keyboard::fireKeyPressed( VirtualKeyCode keycode )
+  {
+    if ( keycode < KeyMask::c_keyCount )
+    {
+      keys_.set( keycode );
+      pressTimes_[keycode] = timestamp_;
+    }
+    snapshotPending_ = true;
+
+    for ( auto listener : listeners_.dispatch( KeyboardEvent_KeyPressed, keycode ) )
+      listener->onKeyPressed( this, keycode );
+
+    if ( *eventSink_ )
+      ( *eventSink_ )( makeEvent( Event_KeyPressed, keycode ) );
+  }
+
+  void Keyboard::fireKeyRepeat( VirtualKeyCode keycode )
+  {
+    snapshotPending_ = true;
+
+    for ( auto listener : listeners_.dispatch( KeyboardEvent_KeyRepeat, keycode ) )
+      listener->onKeyRepeat( this, keycode );
+
+    if ( *eventSink_ )
+      ( *eventSink_ )( makeEvent( Event_KeyRepeat, keycode ) );
+  }
+
+  void Keyboard::fireKeyReleased( VirtualKeyCode keycode )
+  {
+    if ( keycode < KeyMask::c_keyCount )
+    {
+      keys_.set( keycode, false );
+      pressTimes_[keycode] = 0;
+    }
+    snapshotPending_ = true;
+
+    for ( auto listener : listeners_.dispatch( KeyboardEvent_KeyReleased, keycode ) )
+      listener->onKeyReleased( this, keycode );
+
+    if ( *eventSink_ )
+      ( *eventSink_ )( makeEvent( Event_KeyReleased, keycode ) );
+  }
+
+  Timestamp Keyboard::getKeyPressTime( VirtualKeyCode keycode ) const
+  {
+    return ( keycode < KeyMask::c_keyCount ? pressTimes_[keycode] : 0 );
+  }
+
+  void Keyboard::publishSnapshot()
+  {
+    // Keys change rarely, and the press times make for a largish copy
+    if ( !snapshotPending_ )
+      return;
+
+    KeyboardSnapshot snapshot;
+    snapshot.timestamp = timestamp_;
+    snapshot.keys = keys_;
+    memcpy( snapshot.pressTimes, pressTimes_, sizeof( pressTimes_ ) );
+
+    snapshot_->store( snapshot );
+    snapshotPending_ = false;
+  }
+
+  KeyboardSnapshot Keyboard::getSnapshot() const
+  {
+    return snapshot_->load();
+  }
+
+  KeyboardSnapshotSource Keyboard::getSnapshotSource() const
+  {
+    return snapshot_;
+  }
+
   Keyboard::~Keyboard()
   {
   }
@@ -0,0 +1,225 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilKeys.h"
+
+namespace nil {
+
+  namespace keys {
+
+    // A key by scan code, and the key code it translates to
+    struct ScanCodeEntry
+    {
+      uint8_t scanCode;
+      ScanCodePrefix prefix;
+      VirtualKeyCode key;
+    };
+
+    // A key by evdev code, and its scan code
+    struct EvdevEntry
+    {
+      uint16_t code;
+      uint8_t scanCode;
+      ScanCodePrefix prefix;
+    };
+
+    // clang-format off
+
+    constexpr ScanCodeEntry c_scanCodeEntries[] = {
+      { 0x01, Prefix_None, 0x1B }, // VK_ESCAPE
+      { 0x02, Prefix_None, '1' }, { 0x03, Prefix_None, '2' }, { 0x04, Prefix_None, '3' },
+      { 0x05, Prefix_None, '4' }, { 0x06, Prefix_None, '5' }, { 0x07, Prefix_None, '6' },
+      { 0x08, Prefix_None, '7' }, { 0x09, Prefix_None, '8' }, { 0x0A, Prefix_None, '9' },
+      { 0x0B, Prefix_None, '0' },
+      { 0x0C, Prefix_None, 0xBD }, // VK_OEM_MINUS
+      { 0x0D, Prefix_None, 0xBB }, // VK_OEM_PLUS
+      { 0x0E, Prefix_None, 0x08 }, // VK_BACK
+      { 0x0F, Prefix_None, 0x09 }, // VK_TAB
+      { 0x10, Prefix_None, 'Q' }, { 0x11, Prefix_None, 'W' }, { 0x12, Prefix_None, 'E' },
+      { 0x13, Prefix_None, 'R' }, { 0x14, Prefix_None, 'T' }, { 0x15, Prefix_None, 'Y' },
+      { 0x16, Prefix_None, 'U' }, { 0x17, Prefix_None, 'I' }, { 0x18, Prefix_None, 'O' },
+      { 0x19, Prefix_None, 'P' },
+      { 0x1A, Prefix_None, 0xDB }, // VK_OEM_4
+      { 0x1B, Prefix_None, 0xDD }, // VK_OEM_6
+      { 0x1C, Prefix_None, 0x0D }, // VK_RETURN
+      { 0x1D, Prefix_None, Keyboard::Key_LeftControl },
+      { 0x1E, Prefix_None, 'A' }, { 0x1F, Prefix_None, 'S' }, { 0x20, Prefix_None, 'D' },
+      { 0x21, Prefix_None, 'F' }, { 0x22, Prefix_None, 'G' }, { 0x23, Prefix_None, 'H' },
+      { 0x24, Prefix_None, 'J' }, { 0x25, Prefix_None, 'K' }, { 0x26, Prefix_None, 'L' },
+      { 0x27, Prefix_None, 0xBA }, // VK_OEM_1
+      { 0x28, Prefix_None, 0xDE }, // VK_OEM_7
+      { 0x29, Prefix_None, 0xC0 }, // VK_OEM_3
+      { 0x2A, Prefix_None, Keyboard::Key_LeftShift },
+      { 0x2B, Prefix_None, 0xDC }, // VK_OEM_5
+      { 0x2C, Prefix_None, 'Z' }, { 0x2D, Prefix_None, 'X' }, { 0x2E, Prefix_None, 'C' },
+      { 0x2F, Prefix_None, 'V' }, { 0x30, Prefix_None, 'B' }, { 0x31, Prefix_None, 'N' },
+      { 0x32, Prefix_None, 'M' },
+      { 0x33, Prefix_None, 0xBC }, // VK_OEM_COMMA
+      { 0x34, Prefix_None, 0xBE }, // VK_OEM_PERIOD
+      { 0x35, Prefix_None, 0xBF }, // VK_OEM_2
+      { 0x36, Prefix_None, Keyboard::Key_RightShift },
+      { 0x37, Prefix_None, 0x6A }, // VK_MULTIPLY
+      { 0x38, Prefix_None, Keyboard::Key_LeftAlt },
+      { 0x39, Prefix_None, 0x20 }, // VK_SPACE
+      { 0x3A, Prefix_None, 0x14 }, // VK_CAPITAL
+      { 0x3B, Prefix_None, 0x70 }, { 0x3C, Prefix_None, 0x71 }, { 0x3D, Prefix_None, 0x72 }, // VK_F1-3
+      { 0x3E, Prefix_None, 0x73 }, { 0x3F, Prefix_None, 0x74 }, { 0x40, Prefix_None, 0x75 }, // VK_F4-6
+      { 0x41, Prefix_None, 0x76 }, { 0x42, Prefix_None, 0x77 }, { 0x43, Prefix_None, 0x78 }, // VK_F7-9
+      { 0x44, Prefix_None, 0x79 }, // VK_F10
+      { 0x45, Prefix_None, 0x90 }, // VK_NUMLOCK
+      { 0x46, Prefix_None, 0x91 }, // VK_SCROLL
+      { 0x47, Prefix_None, 0x67 }, { 0x48, Prefix_None, 0x68 }, { 0x49, Prefix_None, 0x69 }, // VK_NUMPAD7-9
+      { 0x4A, Prefix_None, 0x6D }, // VK_SUBTRACT
+      { 0x4B, Prefix_None, 0x64 }, { 0x4C, Prefix_None, 0x65 }, { 0x4D, Prefix_None, 0x66 }, // VK_NUMPAD4-6
+      { 0x4E, Prefix_None, 0x6B }, // VK_ADD
+      { 0x4F, Prefix_None, 0x61 }, { 0x50, Prefix_None, 0x62 }, { 0x51, Prefix_None, 0x63 }, // VK_NUMPAD1-3
+      { 0x52, Prefix_None, 0x60 }, // VK_NUMPAD0
+      { 0x53, Prefix_None, 0x6E }, // VK_DECIMAL
+      { 0x56, Prefix_None, 0xE2 }, // VK_OEM_102
+      { 0x57, Prefix_None, 0x7A }, // VK_F11
+      { 0x58, Prefix_None, 0x7B }, // VK_F12
+      { 0x64, Prefix_None, 0x7C }, { 0x65, Prefix_None, 0x7D }, { 0x66, Prefix_None, 0x7E }, // VK_F13-15
+      { 0x67, Prefix_None, 0x7F }, { 0x68, Prefix_None, 0x80 }, { 0x69, Prefix_None, 0x81 }, // VK_F16-18
+      { 0x6A, Prefix_None, 0x82 }, { 0x6B, Prefix_None, 0x83 }, { 0x6C, Prefix_None, 0x84 }, // VK_F19-21
+      { 0x6D, Prefix_None, 0x85 }, { 0x6E, Prefix_None, 0x86 }, // VK_F22-23
+      { 0x76, Prefix_None, 0x87 }, // VK_F24
+      { 0x10, Prefix_E0, 0xB1 }, // VK_MEDIA_PREV_TRACK
+      { 0x19, Prefix_E0, 0xB0 }, // VK_MEDIA_NEXT_TRACK
+      { 0x1C, Prefix_E0, Keyboard::Key_NumpadEnter },
+      { 0x1D, Prefix_E0, Keyboard::Key_RightControl },
+      { 0x20, Prefix_E0, 0xAD }, // VK_VOLUME_MUTE
+      { 0x22, Prefix_E0, 0xB3 }, // VK_MEDIA_PLAY_PAUSE
+      { 0x24, Prefix_E0, 0xB2 }, // VK_MEDIA_STOP
+      { 0x2E, Prefix_E0, 0xAE }, // VK_VOLUME_DOWN
+      { 0x30, Prefix_E0, 0xAF }, // VK_VOLUME_UP
+      { 0x35, Prefix_E0, 0x6F }, // VK_DIVIDE
+      { 0x37, Prefix_E0, 0x2C }, // VK_SNAPSHOT
+      { 0x38, Prefix_E0, Keyboard::Key_RightAlt },
+      { 0x47, Prefix_E0, 0x24 }, // VK_HOME
+      { 0x48, Prefix_E0, 0x26 }, // VK_UP
+      { 0x49, Prefix_E0, 0x21 }, // VK_PRIOR
+      { 0x4B, Prefix_E0, 0x25 }, // VK_LEFT
+      { 0x4D, Prefix_E0, 0x27 }, // VK_RIGHT
+      { 0x4F, Prefix_E0, 0x23 }, // VK_END
+      { 0x50, Prefix_E0, 0x28 }, // VK_DOWN
+      { 0x51, Prefix_E0, 0x22 }, // VK_NEXT
+      { 0x52, Prefix_E0, 0x2D }, // VK_INSERT
+      { 0x53, Prefix_E0, 0x2E }, // VK_DELETE
+      { 0x5B, Prefix_E0, 0x5B }, // VK_LWIN
+      { 0x5C, Prefix_E0, 0x5C }, // VK_RWIN
+      { 0x5D, Prefix_E0, 0x5D }, // VK_APPS
+      { 0x5F, Prefix_E0, 0x5F }, // VK_SLEEP
+      { 0x1D, Prefix_E1, 0x13 } // VK_PAUSE
+    };
+
+    // Evdev codes of the keys added since the original PC keyboard;
+    // those of the rest are their scan codes.
+    constexpr EvdevEntry c_evdevEntries[] = {
+      { 96, 0x1C, Prefix_E0 }, // KEY_KPENTER
+      { 97, 0x1D, Prefix_E0 }, // KEY_RIGHTCTRL
+      { 98, 0x35, Prefix_E0 }, // KEY_KPSLASH
+      { 99, 0x37, Prefix_E0 }, // KEY_SYSRQ
+      { 100, 0x38, Prefix_E0 }, // KEY_RIGHTALT
+      { 102, 0x47, Prefix_E0 }, // KEY_HOME
+      { 103, 0x48, Prefix_E0 }, // KEY_UP
+      { 104, 0x49, Prefix_E0 }, // KEY_PAGEUP
+      { 105, 0x4B, Prefix_E0 }, // KEY_LEFT
+      { 106, 0x4D, Prefix_E0 }, // KEY_RIGHT
+      { 107, 0x4F, Prefix_E0 }, // KEY_END
+      { 108, 0x50, Prefix_E0 }, // KEY_DOWN
+      { 109, 0x51, Prefix_E0 }, // KEY_PAGEDOWN
+      { 110, 0x52, Prefix_E0 }, // KEY_INSERT
+      { 111, 0x53, Prefix_E0 }, // KEY_DELETE
+      { 113, 0x20, Prefix_E0 }, // KEY_MUTE
+      { 114, 0x2E, Prefix_E0 }, // KEY_VOLUMEDOWN
+      { 115, 0x30, Prefix_E0 }, // KEY_VOLUMEUP
+      { 119, 0x1D, Prefix_E1 }, // KEY_PAUSE
+      { 125, 0x5B, Prefix_E0 }, // KEY_LEFTMETA
+      { 126, 0x5C, Prefix_E0 }, // KEY_RIGHTMETA
+      { 127, 0x5D, Prefix_E0 }, // KEY_COMPOSE
+      { 142, 0x5F, Prefix_E0 }, // KEY_SLEEP
+      { 163, 0x19, Prefix_E0 }, // KEY_NEXTSONG
+      { 164, 0x22, Prefix_E0 }, // KEY_PLAYPAUSE
+      { 165, 0x10, Prefix_E0 }, // KEY_PREVIOUSSONG
+      { 166, 0x24, Prefix_E0 }, // KEY_STOPCD
+      { 183, 0x64, Prefix_None }, { 184, 0x65, Prefix_None }, { 185, 0x66, Prefix_None }, // KEY_F13-15
+      { 186, 0x67, Prefix_None }, { 187, 0x68, Prefix_None }, { 188, 0x69, Prefix_None }, // KEY_F16-18
+      { 189, 0x6A, Prefix_None }, { 190, 0x6B, Prefix_None }, { 191, 0x6C, Prefix_None }, // KEY_F19-21
+      { 192, 0x6D, Prefix_None }, { 193, 0x6E, Prefix_None }, { 194, 0x76, Prefix_None } // KEY_F22-24
+    };
+
+    // clang-format on
+
+    // Scan codes of the original PC keyboard run up to F12
+    constexpr unsigned int c_lastBasicScanCode = 0x58;
+
+    // Lookup tables, a byte per key, built at compile time out of the entries above
+    struct ScanCodeTable
+    {
+      uint8_t keys[Prefix_E1 + 1][c_scanCodeCount];
+    };
+
+    struct EvdevTable
+    {
+      uint8_t keys[c_evdevCodeCount];
+    };
+
+    constexpr ScanCodeTable makeScanCodeTable()
+    {
+      ScanCodeTable table = {};
+      for ( auto& row : table.keys )
+        for ( auto& key : row )
+          key = Keyboard::Key_Invalid;
+
+      for ( const auto& entry : c_scanCodeEntries )
+        table.keys[entry.prefix][entry.scanCode] = static_cast<uint8_t>( entry.key );
+
+      return table;
+    }
+
+    constexpr ScanCodeTable c_scanCodeTable = makeScanCodeTable();
+
+    constexpr EvdevTable makeEvdevTable()
+    {
+      EvdevTable table = {};
+      for ( auto& key : table.keys )
+        key = Keyboard::Key_Invalid;
+
+      for ( unsigned int code = 0; code <= c_lastBasicScanCode; code++ )
+        table.keys[code] = c_scanCodeTable.keys[Prefix_None][code];
+
+      for ( const auto& entry : c_evdevEntries )
+        table.keys[entry.code] = c_scanCodeTable.keys[entry.prefix][entry.scanCode];
+
+      return table;
+    }
+
+    constexpr EvdevTable c_evdevTable = makeEvdevTable();
+
+    VirtualKeyCode translateScanCode( unsigned int scanCode, ScanCodePrefix prefix )
+    {
+      if ( scanCode >= c_scanCodeCount || prefix < Prefix_None || prefix > Prefix_E1 )
+        return Keyboard::Key_Invalid;
+
+      return c_scanCodeTable.keys[prefix][scanCode];
+    }
+
+    VirtualKeyCode translateEvdevCode( unsigned int code )
+    {
+      if ( code >= c_evdevCodeCount )
+        return Keyboard::Key_Invalid;
+
+      return c_evdevTable.keys[code];
+    }
+
+    bool isLayoutIndependent( VirtualKeyCode key )
+    {
+      // VK_NUMPAD0 through VK_DIVIDE, and our own codes
+      return ( ( key >= 0x60 && key <= 0x6F )
+        || ( key >= Keyboard::Key_LeftShift && key <= Keyboard::Key_RightAlt )
+        || key == Keyboard::Key_NumpadEnter );
+    }
+
+  }
+
+}
\ No newline at end of file
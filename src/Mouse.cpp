@@ -22,14 +22,15 @@ namespace nil {
 
   // Mouse class
 
-  Mouse::Mouse( SystemPtr system, DevicePtr device, const bool swapButtons ):
-  DeviceInstance( system, device ), swapButtons_( swapButtons )
+  Mouse::Mouse( System* system, Device* device, const bool swapButtons ):
+  DeviceInstance( system, device ), swapButtons_( swapButtons ),
+  snapshot_( make_shared<SeqLock<MouseSnapshot>>() )
   {
   }
 
-  void Mouse::addListener( MouseListener* listener )
+  ListenerToken Mouse::addListener( MouseListener * listener, const Subscription& subscription )
   {
-    listeners_.push_back( listener );
+    return listeners_.add( listener, subscription );
   }
 
   void Mouse::removeListener( MouseListener* listener )
@@ -37,11 +38,254 @@ namespace nil {
     listeners_.remove( listener );
   }
 
+  void Mouse::removeListener( ListenerToken token )
+  {
+    listeners_.remove( token );
+  }
+
+  void Mouse::setSubscription( ListenerToken token, const Subscription& subscription )
+  {
+    if ( !listeners_.subscribe( token, subscription ) )
+      NIL_EXCEPT( "No listener with that token" );
+  }
+
   const MouseState& Mouse::getState() const
   {
     return state_;
   }
 
+  void Mouse::fireMovement( const Vector2i& delta )
+  {
+    if ( delta != Vector2i::ZERO )
+      system_->captureMotion( this, delta, 0 );
+
+    if ( coalescing_ )
+    {
+      if ( delta != Vector2i::ZERO )
+      {
+        coalescedMovement_ += delta;
+        coalescedTimestamp_ = timestamp_;
+      }
+      return;
+    }
+
+    state_.movement.relative = delta;
+
+    if ( delta != Vector2i::ZERO )
+    {
+      frameMovement_ += delta;
+      for ( auto listener : listeners_.dispatch( MouseEvent_Moved ) )
+        listener->onMouseMoved( this, state_ );
+      if ( *eventSink_ )
+      {
+        auto event = makeEvent( Event_MouseMove, 0 );
+        event.movement.x = state_.movement.relative.x;
+        event.movement.y = state_.movement.relative.y;
+        ( *eventSink_ )( event );
+      }
+    }
+  }
+
+  void Mouse::fireWheel( int delta )
+  {
+    if ( delta != 0 )
+      system_->captureMotion( this, Vector2i::ZERO, delta );
+
+    if ( coalescing_ )
+    {
+      if ( delta != 0 )
+      {
+        coalescedWheel_ += delta;
+        coalescedTimestamp_ = timestamp_;
+      }
+      return;
+    }
+
+    state_.wheel.relative = delta;
+
+    if ( delta != 0 )
+    {
+      frameWheel_ += delta;
+      for ( auto listener : listeners_.dispatch( MouseEvent_WheelMoved ) )
+        listener->onMouseWheelMoved( this, state_ );
+      if ( *eventSink_ )
+      {
+        auto event = makeEvent( Event_MouseWheel, 0 );
+        event.wheel = state_.wheel.relative;
+        ( *eventSink_ )( event );
+      }
+    }
+  }
+
+  void Mouse::fireButton( size_t button, bool pushed )
+  {
+    // Whatever moved before the button must be seen to have moved before it
+    if ( coalescing_ )
+      flushCoalesced();
+
+    state_.buttons[button].pushed = pushed;
+
+    if ( button < 32 )
+    {
+      if ( pushed )
+        buttonMask_ |= ( 1U << button );
+      else
+        buttonMask_ &= ~( 1U << button );
+    }
+
+    if ( pushed )
+    {
+      for ( auto listener : listeners_.dispatch( MouseEvent_ButtonPressed, button ) )
+        listener->onMouseButtonPressed( this, state_, button );
+    }
+    else
+    {
+      for ( auto listener : listeners_.dispatch( MouseEvent_ButtonReleased, button ) )
+        listener->onMouseButtonReleased( this, state_, button );
+    }
+
+    if ( *eventSink_ )
+    {
+      auto event = makeEvent( Event_MouseButton, static_cast<uint32_t>( button ) );
+      event.pushed = pushed;
+      ( *eventSink_ )( event );
+    }
+  }
+
+  void Mouse::flushCoalesced()
+  {
+    if ( coalescedMovement_ == Vector2i::ZERO && coalescedWheel_ == 0 )
+      return;
+
+    // Held back events go out stamped with when they last happened
+    auto timestamp = timestamp_;
+    timestamp_ = coalescedTimestamp_;
+
+    if ( coalescedMovement_ != Vector2i::ZERO )
+    {
+      state_.movement.relative = coalescedMovement_;
+      frameMovement_ += coalescedMovement_;
+      coalescedMovement_ = Vector2i::ZERO;
+      for ( auto listener : listeners_.dispatch( MouseEvent_Moved ) )
+        listener->onMouseMoved( this, state_ );
+      if ( *eventSink_ )
+      {
+        auto event = makeEvent( Event_MouseMove, 0 );
+        event.movement.x = state_.movement.relative.x;
+        event.movement.y = state_.movement.relative.y;
+        ( *eventSink_ )( event );
+      }
+    }
+
+    if ( coalescedWheel_ != 0 )
+    {
+      state_.wheel.relative = coalescedWheel_;
+      frameWheel_ += coalescedWheel_;
+      coalescedWheel_ = 0;
+      for ( auto listener : listeners_.dispatch( MouseEvent_WheelMoved ) )
+        listener->onMouseWheelMoved( this, state_ );
+      if ( *eventSink_ )
+      {
+        auto event = makeEvent( Event_MouseWheel, 0 );
+        event.wheel = state_.wheel.relative;
+        ( *eventSink_ )( event );
+      }
+    }
+
+    timestamp_ = timestamp;
+  }
+
+  void Mouse::recordSample( const Vector2i& movement, int wheel )
+  {
+    if ( !sampleCapacity_ )
+      return;
+
+    // Never grow on the input path; the room was reserved up front
+    if ( samples_.size() == sampleCapacity_ )
+    {
+      droppedSamples_++;
+      return;
+    }
+
+    samples_.push_back( { timestamp_, movement, wheel, buttonMask_ } );
+  }
+
+  void Mouse::update()
+  {
+    if ( !coalescing_ )
+      return;
+
+    flushCoalesced();
+
+    // Until the next update, the state tells about this one as a whole
+    state_.movement.relative = frameMovement_;
+    state_.wheel.relative = frameWheel_;
+  }
+
+  void Mouse::publishSnapshot()
+  {
+    MouseSnapshot snapshot = {};
+    snapshot.timestamp = timestamp_;
+    snapshot.movement = frameMovement_;
+    snapshot.wheel = frameWheel_;
+    snapshot.buttons = buttonMask_;
+
+    snapshot_->store( snapshot );
+
+    frameMovement_ = Vector2i::ZERO;
+    frameWheel_ = 0;
+
+    // This update's samples become readable, and the last one's make room
+    frameSamples_.swap( samples_ );
+    samples_.clear();
+  }
+
+  MouseSnapshot Mouse::getSnapshot() const
+  {
+    return snapshot_->load();
+  }
+
+  MouseSnapshotSource Mouse::getSnapshotSource() const
+  {
+    return snapshot_;
+  }
+
+  void Mouse::setCoalescing( bool coalesce )
+  {
+    if ( coalescing_ && !coalesce )
+      flushCoalesced();
+
+    coalescing_ = coalesce;
+  }
+
+  bool Mouse::isCoalescing() const
+  {
+    return coalescing_;
+  }
+
+  void Mouse::setSampleHistory( size_t capacity )
+  {
+    sampleCapacity_ = capacity;
+
+    samples_.clear();
+    samples_.shrink_to_fit();
+    samples_.reserve( capacity );
+
+    frameSamples_.clear();
+    frameSamples_.shrink_to_fit();
+    frameSamples_.reserve( capacity );
+  }
+
+  std::span<const MouseSample> Mouse::getSamples() const
+  {
+    return frameSamples_;
+  }
+
+  size_t Mouse::getDroppedSamples() const
+  {
+    return droppedSamples_;
+  }
+
   Mouse::~Mouse()
   {
   }
@@ -0,0 +1,93 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+namespace nil {
+
+  void DeviceRegistry::add( DevicePtr device )
+  {
+    auto raw = device.get();
+    devices_.push_back( device );
+    handlerDevices_[raw->getHandler()].push_back( raw );
+    staticIds_.try_emplace( raw->getStaticID(), raw );
+  }
+
+  void DeviceRegistry::setHandle( Device* device, NativeHandle handle )
+  {
+    auto& handles = handles_[device->getHandler()];
+    auto& keys = keys_[device];
+
+    if ( keys.handle )
+    {
+      auto it = handles.find( keys.handle );
+      if ( it != handles.end() && it->second == device )
+        handles.erase( it );
+    }
+
+    keys.handle = handle;
+    if ( !handle )
+      return;
+
+    // Handles get reused, so whoever had this one before doesn't anymore
+    auto& holder = handles[handle];
+    if ( holder && holder != device )
+      keys_[holder].handle = 0;
+    holder = device;
+  }
+
+  void DeviceRegistry::setPath( Device* device, const DevicePathKey& path )
+  {
+    auto& paths = paths_[device->getHandler()];
+    auto& keys = keys_[device];
+
+    if ( !keys.path.empty() )
+    {
+      auto it = paths.find( keys.path );
+      if ( it != paths.end() && it->second == device )
+        paths.erase( it );
+    }
+
+    keys.path = path;
+    if ( path.empty() )
+      return;
+
+    auto& holder = paths[path];
+    if ( holder && holder != device )
+      keys_[holder].path.clear();
+    holder = device;
+  }
+
+  void DeviceRegistry::setProduct( Device* device, uint16_t vendor, uint16_t product )
+  {
+    products_.emplace( makeProductKey( vendor, product ), device );
+  }
+
+  Device* DeviceRegistry::findByHandle( Device::Handler handler, NativeHandle handle ) const
+  {
+    auto it = handles_[handler].find( handle );
+    return ( it != handles_[handler].end() ? it->second : nullptr );
+  }
+
+  Device* DeviceRegistry::findByPath( Device::Handler handler, const DevicePathKey& path ) const
+  {
+    auto it = paths_[handler].find( path );
+    return ( it != paths_[handler].end() ? it->second : nullptr );
+  }
+
+  Device* DeviceRegistry::findByStaticID( DeviceID id ) const
+  {
+    auto it = staticIds_.find( id );
+    return ( it != staticIds_.end() ? it->second : nullptr );
+  }
+
+  vector<Device*> DeviceRegistry::findByProduct( uint16_t vendor, uint16_t product ) const
+  {
+    vector<Device*> devices;
+    auto range = products_.equal_range( makeProductKey( vendor, product ) );
+    for ( auto it = range.first; it != range.second; ++it )
+      devices.push_back( it->second );
+    return devices;
+  }
+
+}
\ No newline at end of file
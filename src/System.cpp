@@ -0,0 +1,245 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+namespace nil {
+
+  DeviceID System::getNextID()
+  {
+    return idPool_++;
+  }
+
+  void System::deviceConnect( DevicePtr device )
+  {
+    device->onConnect();
+    if ( capture_ )
+      capture_->deviceConnected( device.get() );
+    listener_->onDeviceConnected( device.get() );
+  }
+
+  void System::deviceDisconnect( DevicePtr device )
+  {
+    device->onDisconnect();
+    if ( capture_ )
+      capture_->deviceDisconnected( device.get() );
+    listener_->onDeviceDisconnected( device.get() );
+  }
+
+  void System::mouseEnabled( DevicePtr device, MousePtr instance )
+  {
+    if ( capture_ )
+      capture_->mouseEnabled( device.get(), instance.get() );
+    if ( eventQueue_ )
+      instance->addListener( eventQueue_.get() );
+    listener_->onMouseEnabled( device.get(), instance.get() );
+  }
+
+  void System::mouseDisabled( DevicePtr device, MousePtr instance )
+  {
+    listener_->onMouseDisabled( device.get(), instance.get() );
+  }
+
+  void System::keyboardEnabled( DevicePtr device, KeyboardPtr instance )
+  {
+    if ( capture_ )
+      capture_->keyboardEnabled( device.get(), instance.get() );
+    if ( eventQueue_ )
+      instance->addListener( eventQueue_.get() );
+    listener_->onKeyboardEnabled( device.get(), instance.get() );
+  }
+
+  void System::keyboardDisabled( DevicePtr device, KeyboardPtr instance )
+  {
+    listener_->onKeyboardDisabled( device.get(), instance.get() );
+  }
+
+  void System::controllerEnabled( DevicePtr device, ControllerPtr instance )
+  {
+    if ( capture_ )
+      capture_->controllerEnabled( device.get(), instance.get() );
+    if ( eventQueue_ )
+      instance->addListener( eventQueue_.get() );
+    listener_->onControllerEnabled( device.get(), instance.get() );
+  }
+
+  void System::controllerDisabled( DevicePtr device, ControllerPtr instance )
+  {
+    listener_->onControllerDisabled( device.get(), instance.get() );
+  }
+
+  VirtualDevicePtr System::createVirtualDevice( Device::Type type,
+  const utf8String& name, const VirtualDevice::Layout& layout, DeviceID staticId )
+  {
+    auto device = make_shared<VirtualDevice>( this, getNextID(), type, name, layout, staticId );
+
+    if ( isInitializing() )
+      device->setStatus( Device::Status_Connected );
+    else
+      deviceConnect( device );
+
+    devices_.add( device );
+
+    return device;
+  }
+
+  void System::setProbeCache( const utf8String& path )
+  {
+    if ( !isInitializing() )
+      NIL_EXCEPT( "Cannot set the probe cache after initialization" );
+
+    probeCachePath_ = path;
+  }
+
+  void System::startCapture( const utf8String& path )
+  {
+    stopCapture();
+
+    capture_ = make_unique<CaptureWriter>( path );
+
+    // Record the current state of things, as if it had all just happened
+    for ( auto& device : devices_ )
+    {
+      if ( device->getStatus() != Device::Status_Connected )
+        continue;
+
+      capture_->deviceConnected( device.get() );
+
+      auto instance = device->getInstance();
+      if ( !instance )
+        continue;
+
+      if ( device->getType() == Device::Device_Mouse )
+        capture_->mouseEnabled( device.get(), static_cast<Mouse*>( instance ) );
+      else if ( device->getType() == Device::Device_Keyboard )
+        capture_->keyboardEnabled( device.get(), static_cast<Keyboard*>( instance ) );
+      else if ( device->getType() == Device::Device_Controller )
+        capture_->controllerEnabled( device.get(), static_cast<Controller*>( instance ) );
+    }
+  }
+
+  void System::stopCapture()
+  {
+    if ( !capture_ )
+      return;
+
+    attachInstanceListeners( capture_.get(), capture_.get(), capture_.get(), false );
+
+    capture_.reset();
+  }
+
+  bool System::isCapturing() const
+  {
+    return ( capture_ != nullptr );
+  }
+
+  void System::enableEventQueue( size_t capacity )
+  {
+    disableEventQueue();
+
+    eventQueue_ = make_unique<EventQueue>( capacity );
+
+    attachInstanceListeners( eventQueue_.get(), eventQueue_.get(), eventQueue_.get(), true );
+  }
+
+  void System::disableEventQueue()
+  {
+    if ( !eventQueue_ )
+      return;
+
+    attachInstanceListeners( eventQueue_.get(), eventQueue_.get(), eventQueue_.get(), false );
+
+    eventQueue_.reset();
+  }
+
+  void System::clearEventHandler()
+  {
+    eventSink_ = EventSink();
+  }
+
+  size_t System::pollEvents( std::span<Event> events )
+  {
+    return ( eventQueue_ ? eventQueue_->poll( events ) : 0 );
+  }
+
+  size_t System::getDroppedEventCount() const
+  {
+    return ( eventQueue_ ? eventQueue_->dropped() : 0 );
+  }
+
+  void System::attachInstanceListeners( MouseListener* mouse, KeyboardListener* keyboard,
+  ControllerListener* controller, bool attach )
+  {
+    for ( auto& device : devices_ )
+    {
+      auto instance = device->getInstance();
+      if ( !instance )
+        continue;
+
+      if ( device->getType() == Device::Device_Mouse )
+      {
+        if ( attach )
+          static_cast<Mouse*>( instance )->addListener( mouse );
+        else
+          static_cast<Mouse*>( instance )->removeListener( mouse );
+      }
+      else if ( device->getType() == Device::Device_Keyboard )
+      {
+        if ( attach )
+          static_cast<Keyboard*>( instance )->addListener( keyboard );
+        else
+          static_cast<Keyboard*>( instance )->removeListener( keyboard );
+      }
+      else if ( device->getType() == Device::Device_Controller )
+      {
+        if ( attach )
+          static_cast<Controller*>( instance )->addListener( controller );
+        else
+          static_cast<Controller*>( instance )->removeListener( controller );
+      }
+    }
+  }
+
+  void System::captureReport( Device* device, const uint8_t* data, size_t length )
+  {
+    if ( capture_ )
+      capture_->hidReport( device, data, length );
+  }
+
+  void System::captureMotion( Mouse* mouse, const Vector2i& movement, int wheel )
+  {
+    if ( capture_ )
+      capture_->mouseMotion( mouse, movement, wheel );
+  }
+
+  DeviceList& System::getDevices()
+  {
+    return devices_.getDevices();
+  }
+
+  const DeviceRegistry& System::getDeviceRegistry() const
+  {
+    return devices_;
+  }
+
+  bool System::isInitializing() const
+  {
+    return initializing_;
+  }
+
+  int System::getNextMouseIndex()
+  {
+    return ++mouseIdPool_;
+  }
+
+  int System::getNextKeyboardIndex()
+  {
+    return ++keyboardIdPool_;
+  }
+
+  int System::getNextControllerIndex()
+  {
+    return ++controllerIdPool_;
+  }
+
+}
\ No newline at end of file
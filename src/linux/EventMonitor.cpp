@@ -0,0 +1,539 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilLinux.h"
+#include "nilUtil.h"
+
+#ifdef NIL_PLATFORM_LINUX
+
+namespace nil {
+
+  namespace posix {
+
+    // Maximum number of ready descriptors handled per update
+    const size_t c_maxReadyEvents = 64;
+
+    // Events read per syscall; large enough to swallow a whole frame
+    // of traffic from an 8 kHz mouse in a single read.
+    const size_t c_inputBufferEvents = 1024;
+
+    // Hidraw reads return one report at a time; this fits any sane report
+    const size_t c_reportBufferSize = HID_MAX_DESCRIPTOR_SIZE;
+
+    // Events that can make a node appear, or become openable to us.
+    // Udev creates nodes root-only and fixes permissions afterwards,
+    // so IN_ATTRIB is what usually tells us a node is ready.
+    const uint32_t c_arrivalMask = ( IN_CREATE | IN_ATTRIB | IN_MOVED_TO );
+
+    // Events that make a node disappear
+    const uint32_t c_removalMask = ( IN_DELETE | IN_MOVED_FROM );
+
+    // How long the input thread backs off when the game thread has fallen
+    // so far behind that the ring is full. Meanwhile the kernel buffers.
+    const auto c_ringFullBackoff = std::chrono::milliseconds( 1 );
+
+    // How long the input thread backs off when only nodes that already
+    // failed are ready, until the game thread gets around to closing them.
+    const auto c_failedNodeBackoff = std::chrono::milliseconds( 1 );
+
+    EventMonitor::EventMonitor()
+    {
+      epoll_ = epoll_create1( EPOLL_CLOEXEC );
+      if ( epoll_ < 0 )
+        NIL_EXCEPT_POSIX( "epoll_create1 failed" );
+
+      readyEvents_.resize( c_maxReadyEvents );
+      inputBuffer_.resize( c_inputBufferEvents );
+      reportBuffer_.resize( c_reportBufferSize );
+
+      inotify_ = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+      if ( inotify_ < 0 )
+        NIL_EXCEPT_POSIX( "inotify_init1 failed" );
+
+      // Without an input directory there is nothing to hotplug into;
+      // carry on without notifications rather than failing.
+      inputWatch_ = inotify_add_watch( inotify_, g_inputDirectory, c_arrivalMask | c_removalMask );
+      deviceWatch_ = inotify_add_watch( inotify_, g_deviceDirectory, c_arrivalMask | c_removalMask );
+
+      if ( inputWatch_ >= 0 || deviceWatch_ >= 0 )
+        watchDescriptor( inotify_, inotify_ );
+    }
+
+    void EventMonitor::watchDescriptor( int fd, uint64_t key )
+    {
+      epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.u64 = key;
+
+      if ( epoll_ctl( epoll_, EPOLL_CTL_ADD, fd, &event ) != 0 )
+        NIL_EXCEPT_POSIX( "epoll_ctl failed" );
+    }
+
+    void EventMonitor::registerHotplugListener( HotplugListenerPtr listener )
+    {
+      hotplugListeners_.push_back( listener );
+    }
+
+    void EventMonitor::unregisterHotplugListener( HotplugListenerPtr listener )
+    {
+      hotplugListeners_.remove( listener );
+    }
+
+    void EventMonitor::handleNodeArrival( const utf8String& path )
+    {
+      for ( auto& listener : hotplugListeners_ )
+        listener->onHotplugArrival( path );
+    }
+
+    void EventMonitor::handleNodeRemoval( const utf8String& path )
+    {
+      for ( auto& listener : hotplugListeners_ )
+        listener->onHotplugRemoval( path );
+    }
+
+    void EventMonitor::handleNotifications()
+    {
+      alignas( inotify_event ) char buffer[4096];
+
+      while ( true )
+      {
+        auto bytes = read( inotify_, buffer, sizeof( buffer ) );
+        if ( bytes < 0 && errno == EINTR )
+          continue;
+        if ( bytes <= 0 )
+          return;
+
+        for ( char* ptr = buffer; ptr < buffer + bytes; )
+        {
+          auto event = reinterpret_cast<const inotify_event*>( ptr );
+          ptr += sizeof( inotify_event ) + event->len;
+
+          // We lost track of what happened; report everything that's there,
+          // removals will surface as read errors on their own.
+          if ( event->mask & IN_Q_OVERFLOW )
+          {
+            for ( auto& path : util::listNodes( g_deviceDirectory, g_hidrawNodePrefix ) )
+              handleNodeArrival( path );
+            for ( auto& path : util::listNodes( g_inputDirectory, g_eventNodePrefix ) )
+              handleNodeArrival( path );
+            continue;
+          }
+
+          if ( !event->len )
+            continue;
+
+          const char* directory = nullptr;
+          if ( event->wd == inputWatch_ && util::isNodeName( event->name, g_eventNodePrefix ) )
+            directory = g_inputDirectory;
+          else if ( event->wd == deviceWatch_ && util::isNodeName( event->name, g_hidrawNodePrefix ) )
+            directory = g_deviceDirectory;
+          else
+            continue;
+
+          if ( event->mask & c_removalMask )
+            handleNodeRemoval( util::makeNodePath( directory, event->name ) );
+          else if ( event->mask & c_arrivalMask )
+            handleNodeArrival( util::makeNodePath( directory, event->name ) );
+        }
+      }
+    }
+
+    // Device descriptors are keyed by registration, not just by number,
+    // since the input thread may still be holding data read from a
+    // descriptor that has since been closed and its number reused.
+    // Only the input thread reads or closes descriptors while it runs,
+    // so a number it is about to read can never belong to another node.
+
+    void EventMonitor::registerListener( int fd, EvdevListenerPtr listener )
+    {
+      auto key = ( ( static_cast<uint64_t>( ++keySerial_ ) << 32 ) | static_cast<uint32_t>( fd ) );
+      watchDescriptor( fd, key );
+      registrations_.insert( fd, { key, listener, nullptr } );
+    }
+
+    void EventMonitor::registerListener( int fd, HidrawListenerPtr listener )
+    {
+      auto key = ( ( static_cast<uint64_t>( ++keySerial_ ) << 32 ) | static_cast<uint32_t>( fd ) );
+      watchDescriptor( fd, key );
+      registrations_.insert( fd, { key, nullptr, listener } );
+    }
+
+    void EventMonitor::unregisterListener( int fd )
+    {
+      if ( registrations_.erase( fd ) )
+        epoll_ctl( epoll_, EPOLL_CTL_DEL, fd, nullptr );
+    }
+
+    void EventMonitor::closeListener( int fd )
+    {
+      // The descriptor is still open, so removing it from the set here is safe
+      unregisterListener( fd );
+
+      if ( !thread_.joinable() )
+      {
+        close( fd );
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock( closeLock_ );
+        pendingCloses_.push_back( fd );
+      }
+      uint64_t wake = 1;
+      while ( write( wakeEvent_, &wake, sizeof( wake ) ) < 0 && errno == EINTR );
+    }
+
+    vector<int> EventMonitor::closePending()
+    {
+      vector<int> closes;
+      {
+        std::lock_guard<std::mutex> lock( closeLock_ );
+        closes.swap( pendingCloses_ );
+      }
+      for ( auto fd : closes )
+        close( fd );
+      return closes;
+    }
+
+    void EventMonitor::drain( int fd, EvdevListenerPtr listener )
+    {
+      const size_t capacity = inputBuffer_.size() * sizeof( input_event );
+
+      while ( true )
+      {
+        auto bytes = read( fd, inputBuffer_.data(), capacity );
+        if ( bytes < 0 )
+        {
+          if ( errno == EINTR )
+            continue;
+          if ( errno != EAGAIN && errno != EWOULDBLOCK )
+          {
+            // The node is gone; stop polling it before anyone gets to react
+            int error = errno;
+            unregisterListener( fd );
+            listener->onEvdevError( error );
+          }
+          return;
+        }
+
+        auto count = static_cast<size_t>( bytes ) / sizeof( input_event );
+        if ( count )
+          listener->onEvdevInput( inputBuffer_.data(), count );
+
+        // A short read means the kernel queue is empty
+        if ( static_cast<size_t>( bytes ) < capacity )
+          return;
+      }
+    }
+
+    void EventMonitor::drainReports( int fd, HidrawListenerPtr listener )
+    {
+      while ( true )
+      {
+        auto bytes = read( fd, reportBuffer_.data(), reportBuffer_.size() );
+        if ( bytes < 0 )
+        {
+          if ( errno == EINTR )
+            continue;
+          if ( errno != EAGAIN && errno != EWOULDBLOCK )
+          {
+            int error = errno;
+            unregisterListener( fd );
+            listener->onHidrawError( error );
+          }
+          return;
+        }
+
+        // End of file only happens with stand-ins; treat it like an unplug
+        if ( bytes == 0 )
+        {
+          unregisterListener( fd );
+          listener->onHidrawError( ENODEV );
+          return;
+        }
+
+        // Parsers work straight off our buffer, no copies in between
+        listener->onHidrawInput( reportBuffer_.data(), static_cast<size_t>( bytes ), currentTimestamp() );
+      }
+    }
+
+    void EventMonitor::startThread( size_t bufferSize )
+    {
+      if ( thread_.joinable() )
+        return;
+
+      wakeEvent_ = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+      if ( wakeEvent_ < 0 )
+        NIL_EXCEPT_POSIX( "eventfd failed" );
+
+      // A whole read must fit in half the ring, or it would never fit at all
+      ring_ = make_unique<PacketRing>( std::max( bufferSize,
+        4 * c_inputBufferEvents * sizeof( input_event ) ) );
+
+      // Notifications stay with update(), as they lead to opening & closing nodes.
+      // Reading the nonblocking descriptor there costs next to nothing.
+      epoll_ctl( epoll_, EPOLL_CTL_DEL, inotify_, nullptr );
+      watchDescriptor( wakeEvent_, wakeEvent_ );
+
+      stopping_ = false;
+      thread_ = std::thread( &EventMonitor::threadMain, this );
+    }
+
+    void EventMonitor::joinThread()
+    {
+      if ( !thread_.joinable() )
+        return;
+
+      stopping_ = true;
+      uint64_t wake = 1;
+      while ( write( wakeEvent_, &wake, sizeof( wake ) ) < 0 && errno == EINTR );
+      thread_.join();
+
+      // Whatever the thread didn't get to close is ours again
+      closePending();
+
+      epoll_ctl( epoll_, EPOLL_CTL_DEL, wakeEvent_, nullptr );
+      close( wakeEvent_ );
+      wakeEvent_ = -1;
+    }
+
+    void EventMonitor::stopThread()
+    {
+      if ( !thread_.joinable() )
+        return;
+
+      joinThread();
+
+      // Whatever was read already is no less input than what's to come
+      dispatchPackets();
+      ring_.reset();
+
+      if ( inputWatch_ >= 0 || deviceWatch_ >= 0 )
+        watchDescriptor( inotify_, inotify_ );
+    }
+
+    bool EventMonitor::isThreaded() const
+    {
+      return ( ring_ != nullptr );
+    }
+
+    void EventMonitor::threadMain()
+    {
+      vector<epoll_event> ready( c_maxReadyEvents );
+      vector<input_event> buffer( c_inputBufferEvents );
+
+      // Nodes that failed stay in the set until the game thread gets the error
+      // and closes them through us; until then we merely skip them.
+      vector<uint64_t> failed;
+
+      while ( !stopping_ )
+      {
+        int count = epoll_wait( epoll_, ready.data(), static_cast<int>( ready.size() ), -1 );
+        if ( count < 0 )
+        {
+          if ( errno == EINTR )
+            continue;
+          // The epoll instance is ours alone; this cannot happen short of a bug
+          return;
+        }
+
+        bool woken = false;
+        bool idle = true;
+        for ( int i = 0; i < count && !stopping_; i++ )
+        {
+          auto key = ready[i].data.u64;
+          if ( key == static_cast<uint64_t>( wakeEvent_ ) )
+          {
+            uint64_t value;
+            while ( read( wakeEvent_, &value, sizeof( value ) ) < 0 && errno == EINTR );
+            woken = true;
+            continue;
+          }
+          if ( std::find( failed.begin(), failed.end(), key ) != failed.end() )
+            continue;
+          idle = false;
+          if ( !readIntoRing( static_cast<int>( key ), key, buffer ) )
+            failed.push_back( key );
+        }
+
+        // Close only once done with the batch, as it may still name the descriptors.
+        // Their registrations are gone already, so no later batch will.
+        if ( woken )
+        {
+          auto closed = closePending();
+          std::erase_if( failed, [&closed]( uint64_t key ) {
+            return std::find( closed.begin(), closed.end(), static_cast<int>( key ) ) != closed.end(); } );
+        }
+
+        // Only failed nodes are ready; don't spin on them until they're closed
+        if ( idle && !woken && !stopping_ )
+          std::this_thread::sleep_for( c_failedNodeBackoff );
+      }
+    }
+
+    bool EventMonitor::readIntoRing( int fd, uint64_t key, vector<input_event>& buffer )
+    {
+      const size_t capacity = buffer.size() * sizeof( input_event );
+
+      // Evdev reads whole events & hidraw one report at a time,
+      // so the same loop does for both kinds of node.
+      while ( !stopping_ )
+      {
+        auto bytes = read( fd, buffer.data(), capacity );
+        if ( bytes < 0 && errno == EINTR )
+          continue;
+        if ( bytes < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+          return true;
+
+        if ( bytes <= 0 )
+        {
+          // Removal from the set is left to the game thread, which owns the
+          // registration; it unregisters & closes the node once it gets the error.
+          int error = ( bytes < 0 ? errno : ENODEV );
+          publish( key, nullptr, 0, error );
+          return false;
+        }
+
+        publish( key, buffer.data(), static_cast<size_t>( bytes ), 0 );
+      }
+      return true;
+    }
+
+    void EventMonitor::publish( uint64_t key, const void* data, size_t length, int32_t error )
+    {
+      auto timestamp = currentTimestamp();
+      while ( !ring_->write( key, timestamp, data, length, error ) )
+      {
+        if ( stopping_ )
+          return;
+        std::this_thread::sleep_for( c_ringFullBackoff );
+      }
+    }
+
+    void EventMonitor::dispatchPackets()
+    {
+      while ( auto packet = ring_->front() )
+      {
+        // Anything from a registration that is no more is stale
+        auto fd = static_cast<int>( packet->source );
+        auto registration = registrations_.find( fd );
+        if ( registration && registration->key == packet->source )
+        {
+          if ( registration->evdev )
+          {
+            auto listener = registration->evdev;
+            if ( packet->error )
+            {
+              unregisterListener( fd );
+              listener->onEvdevError( packet->error );
+            }
+            else
+              listener->onEvdevInput( reinterpret_cast<const input_event*>( packet->data() ),
+                packet->length / sizeof( input_event ) );
+          }
+          else
+          {
+            auto listener = registration->hidraw;
+            if ( packet->error )
+            {
+              unregisterListener( fd );
+              listener->onHidrawError( packet->error );
+            }
+            else
+              listener->onHidrawInput( packet->data(), packet->length, packet->timestamp );
+          }
+        }
+        ring_->pop();
+      }
+    }
+
+    void EventMonitor::update()
+    {
+      if ( ring_ )
+      {
+        dispatchPackets();
+        handleNotifications();
+        return;
+      }
+
+      int count = epoll_wait( epoll_, readyEvents_.data(), static_cast<int>( readyEvents_.size() ), 0 );
+      if ( count < 0 )
+      {
+        if ( errno == EINTR )
+          return;
+        NIL_EXCEPT_POSIX( "epoll_wait failed" );
+      }
+
+      for ( int i = 0; i < count; i++ )
+      {
+        auto fd = static_cast<int>( readyEvents_[i].data.u64 );
+        if ( fd == inotify_ )
+        {
+          handleNotifications();
+          continue;
+        }
+
+        // Look the listener up again, since an earlier one may have removed it
+        auto registration = registrations_.find( fd );
+        if ( !registration )
+          continue;
+
+        if ( registration->evdev )
+          drain( fd, registration->evdev );
+        else
+          drainReports( fd, registration->hidraw );
+      }
+    }
+
+    EventMonitor::~EventMonitor()
+    {
+      joinThread();
+
+      if ( inotify_ >= 0 )
+        close( inotify_ );
+      if ( epoll_ >= 0 )
+        close( epoll_ );
+    }
+
+    // DeviceNode class
+
+    DeviceNode::DeviceNode( EventMonitor* monitor, const utf8String& path, EvdevListenerPtr listener ):
+    monitor_( monitor )
+    {
+      fd_ = open( path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC );
+      if ( fd_ < 0 )
+        NIL_EXCEPT_POSIX( "Could not open input device node" );
+
+      // Event times default to the wall clock, which can jump; we want the
+      // one std::chrono::steady_clock runs on. Only ancient kernels refuse.
+      int clock = CLOCK_MONOTONIC;
+      ioctl( fd_, EVIOCSCLOCKID, &clock );
+
+      monitor_->registerListener( fd_, listener );
+    }
+
+    DeviceNode::DeviceNode( EventMonitor* monitor, const utf8String& path, HidrawListenerPtr listener ):
+    monitor_( monitor )
+    {
+      fd_ = open( path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC );
+      if ( fd_ < 0 )
+        NIL_EXCEPT_POSIX( "Could not open hidraw device node" );
+
+      monitor_->registerListener( fd_, listener );
+    }
+
+    int DeviceNode::getDescriptor() const
+    {
+      return fd_;
+    }
+
+    DeviceNode::~DeviceNode()
+    {
+      monitor_->closeListener( fd_ );
+    }
+
+  }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+#include "nilHID.h"
+
+#ifdef NIL_PLATFORM_LINUX
+
+namespace nil {
+
+  System::System( const Cooperation coop, SystemListener* listener ):
+  listener_( listener ), coop_( coop )
+  {
+    assert( listener_ );
+  }
+
+  SystemPtr System::create( const Cooperation coop, SystemListener* listener )
+  {
+    return SystemPtr( new System( coop, listener ) );
+  }
+
+  void System::initialize()
+  {
+    if ( !initializing_ )
+      return;
+
+    // Initialize our event monitor
+    eventMonitor_ = make_unique<posix::EventMonitor>();
+
+    // Register ourselves for hotplug events
+    eventMonitor_->registerHotplugListener( this );
+
+    // Fetch initial devices
+    initializeDevices();
+
+    initializing_ = false;
+  }
+
+  bool System::getDefaultMouseButtonSwapping()
+  {
+    // Left-handed mode is a compositor setting; the kernel never swaps
+    return false;
+  }
+
+  void System::initializeDevices()
+  {
+    // Opening nodes & questioning the kernel is what takes time, so do that
+    // for every node at once, then add the devices in node order.
+    auto hidrawNodes = util::probeConcurrently(
+      util::listNodes( g_deviceDirectory, g_hidrawNodePrefix ), &System::inspectHidraw );
+    auto deviceNodes = util::probeConcurrently(
+      util::listNodes( g_inputDirectory, g_eventNodePrefix ), &System::inspectDevice );
+
+    // Hidraw first, so that the evdev nodes of devices we parse ourselves get skipped
+    for ( auto& node : hidrawNodes )
+      if ( node )
+        addHidraw( *node );
+
+    for ( auto& node : deviceNodes )
+      if ( node )
+        addDevice( *node );
+  }
+
+  DevicePtr System::findNodeDevice( const utf8String& path )
+  {
+    for ( auto handler : { Device::Handler_Evdev, Device::Handler_HID } )
+    {
+      auto device = devices_.findByPath( handler, path );
+      if ( device && device->getStatus() == Device::Status_Connected )
+        return device->ptr();
+    }
+    return DevicePtr();
+  }
+
+  bool System::isHidrawHandled( const utf8String& physPath )
+  {
+    if ( physPath.empty() )
+      return false;
+
+    for ( auto device : devices_.view<HidrawDevice>( Device::Handler_HID ) )
+      if ( device->getStatus() == Device::Status_Connected && device->getPhysPath() == physPath )
+        return true;
+
+    return false;
+  }
+
+  void System::onHotplugArrival( const utf8String& path )
+  {
+    // Permission changes on nodes we already have are no news
+    if ( findNodeDevice( path ) )
+      return;
+
+    if ( util::isHidrawNodePath( path ) )
+      probeHidraw( path );
+    else
+      probeDevice( path );
+  }
+
+  void System::onHotplugRemoval( const utf8String& path )
+  {
+    // Usually a read error has beaten us to it, and this finds nothing
+    if ( auto device = findNodeDevice( path ) )
+      deviceDisconnect( device );
+  }
+
+  void System::probeDevice( const utf8String& path )
+  {
+    if ( auto node = inspectDevice( path ) )
+      addDevice( *node );
+  }
+
+  void System::probeHidraw( const utf8String& path )
+  {
+    if ( auto node = inspectHidraw( path ) )
+      addHidraw( *node );
+  }
+
+  std::optional<EvdevNode> System::inspectDevice( const utf8String& path )
+  {
+    // Nodes we are not allowed to read are simply not ours to use
+    SafeDescriptor fd( open( path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC ) );
+    if ( !fd.valid() )
+      return std::nullopt;
+
+    EvdevDeviceInfo info( fd );
+    Device::Type type;
+    if ( !info.resolveType( type ) )
+      return std::nullopt;
+
+    return EvdevNode { path, info };
+  }
+
+  std::optional<HidrawNode> System::inspectHidraw( const utf8String& path )
+  {
+    SafeDescriptor fd( open( path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC ) );
+    if ( !fd.valid() )
+      return std::nullopt;
+
+    hidraw_devinfo info = {};
+    if ( ioctl( fd, HIDIOCGRAWINFO, &info ) < 0 )
+      return std::nullopt;
+
+    // Only take devices we have a report parser for; evdev does the rest
+    auto knownDevice = hid::resolveKnownDevice(
+      static_cast<uint16_t>( info.vendor ), static_cast<uint16_t>( info.product ) );
+    if ( !knownDevice || !hid::hasReportParser( knownDevice->type ) )
+      return std::nullopt;
+
+    char buffer[256] = { 0 };
+    utf8String physPath;
+    if ( ioctl( fd, HIDIOCGRAWPHYS( sizeof( buffer ) - 1 ), buffer ) >= 0 )
+      physPath = buffer;
+
+    return HidrawNode { path, info, physPath, knownDevice };
+  }
+
+  void System::addDevice( const EvdevNode& node )
+  {
+    auto& path = node.path;
+    auto& info = node.info;
+
+    // The same controller is already coming in through hidraw
+    if ( isHidrawHandled( info.getPhysPath() ) )
+      return;
+
+    // A replugged device comes back as the same Device, wherever its node is now
+    for ( auto evDevice : devices_.view<EvdevDevice>( Device::Handler_Evdev ) )
+    {
+      if ( evDevice->getStatus() == Device::Status_Disconnected && evDevice->isSameDevice( info ) )
+      {
+        evDevice->setNode( path, info );
+        devices_.setPath( evDevice, path );
+        deviceConnect( evDevice->ptr() );
+        return;
+      }
+    }
+
+    auto device = make_shared<EvdevDevice>( this, getNextID(), path, info )->ptr();
+
+    if ( isInitializing() )
+      device->setStatus( Device::Status_Connected );
+    else
+      deviceConnect( device );
+
+    devices_.add( device );
+    devices_.setPath( device.get(), path );
+    devices_.setProduct( device.get(), info.getInputID().vendor, info.getInputID().product );
+  }
+
+  void System::addHidraw( const HidrawNode& node )
+  {
+    auto& path = node.path;
+    auto& info = node.info;
+    auto& physPath = node.physPath;
+
+    // A replugged device comes back as the same Device, wherever its node is now
+    for ( auto hidDevice : devices_.view<HidrawDevice>( Device::Handler_HID ) )
+    {
+      if ( hidDevice->getStatus() == Device::Status_Disconnected
+        && !physPath.empty() && hidDevice->getPhysPath() == physPath
+        && memcmp( &hidDevice->getInfo(), &info, sizeof( hidraw_devinfo ) ) == 0 )
+      {
+        hidDevice->setNode( path );
+        devices_.setPath( hidDevice, path );
+        deviceConnect( hidDevice->ptr() );
+        return;
+      }
+    }
+
+    // If the evdev node beat us here, retire it in favor of ourselves
+    if ( !physPath.empty() )
+    {
+      for ( auto evDevice : devices_.view<EvdevDevice>( Device::Handler_Evdev ) )
+        if ( evDevice->getStatus() == Device::Status_Connected && evDevice->getPhysPath() == physPath )
+          deviceDisconnect( evDevice->ptr() );
+    }
+
+    auto device = make_shared<HidrawDevice>( this, getNextID(), path, info, physPath, node.knownDevice )->ptr();
+
+    if ( isInitializing() )
+      device->setStatus( Device::Status_Connected );
+    else
+      deviceConnect( device );
+
+    devices_.add( device );
+    devices_.setPath( device.get(), path );
+    devices_.setProduct( device.get(),
+      static_cast<uint16_t>( info.vendor ), static_cast<uint16_t>( info.product ) );
+  }
+
+  void System::update()
+  {
+    // Drain every device node with pending input
+    eventMonitor_->update();
+
+    // Make sure that we disconnect failed devices,
+    // and update the rest
+    for ( auto& device : devices_ )
+      if ( device->isDisconnectFlagged() )
+        deviceDisconnect( device );
+      else
+        device->update();
+  }
+
+  void System::enableInputThread( size_t bufferSize )
+  {
+    if ( isInitializing() )
+      NIL_EXCEPT( "Cannot start the input thread before initialization" );
+
+    eventMonitor_->startThread( bufferSize );
+  }
+
+  void System::disableInputThread()
+  {
+    eventMonitor_->stopThread();
+  }
+
+  bool System::isInputThreaded() const
+  {
+    return ( eventMonitor_ && eventMonitor_->isThreaded() );
+  }
+
+  System::~System()
+  {
+    for ( auto& device : devices_ )
+      device->disable();
+  }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+#include "nilLinux.h"
+
+#ifdef NIL_PLATFORM_LINUX
+
+namespace nil {
+
+  inline bool isHatAxis( unsigned int code )
+  {
+    return ( code >= ABS_HAT0X && code <= ABS_HAT3Y );
+  }
+
+  inline bool isTriggerAxis( unsigned int code, const input_absinfo& info )
+  {
+    // One-sided ranges on these are triggers & pedals, not centered sticks
+    return ( info.minimum >= 0 && ( code == ABS_Z || code == ABS_RZ || code == ABS_GAS || code == ABS_BRAKE ) );
+  }
+
+  EvdevController::EvdevController( EvdevDevicePtr device ):
+  Controller( device->getSystem(), device.get() )
+  {
+    node_ = make_unique<posix::DeviceNode>( device->getSystem()->eventMonitor_.get(), device->getNodePath(), this );
+
+    if ( device->hasKey( BTN_GAMEPAD ) )
+      type_ = Controller_Gamepad;
+    else if ( device->hasAbsolute( ABS_WHEEL ) || device->hasAbsolute( ABS_GAS ) )
+      type_ = Controller_Driving;
+    else if ( device->hasKey( BTN_JOYSTICK ) )
+      type_ = Controller_Joystick;
+
+    // Buttons are numbered in key code order, starting from the misc range
+    buttonMap_.resize( KEY_CNT, -1 );
+    size_t buttons = 0;
+    for ( unsigned int code = BTN_MISC; code < KEY_CNT; code++ )
+      if ( device->hasKey( code ) )
+        buttonMap_[code] = static_cast<int>( buttons++ );
+
+    // Skip the multitouch range; those belong to touchpads
+    axisMap_.resize( ABS_CNT, -1 );
+    size_t hats = 0;
+    for ( unsigned int code = 0; code < ABS_MT_SLOT; code++ )
+    {
+      if ( !device->hasAbsolute( code ) )
+        continue;
+
+      if ( isHatAxis( code ) )
+      {
+        hats = std::max( hats, static_cast<size_t>( ( code - ABS_HAT0X ) / 2 + 1 ) );
+        continue;
+      }
+
+      AxisMapping axis;
+      if ( ioctl( node_->getDescriptor(), EVIOCGABS( code ), &axis.info ) < 0 )
+        continue;
+
+      axis.trigger = isTriggerAxis( code, axis.info );
+      axisMap_[code] = static_cast<int>( axes_.size() );
+      axes_.push_back( axis );
+    }
+
+    state_.buttons.resize( buttons );
+    state_.axes.resize( axes_.size() );
+    state_.povs.resize( hats );
+    hats_.resize( hats );
+
+    // Start from wherever the controls are now, without firing anything
+    resync();
+    lastState_ = state_;
+  }
+
+  Real EvdevController::filterAxis( int val, const AxisMapping& axis )
+  {
+    const auto& info = axis.info;
+    if ( info.maximum <= info.minimum )
+      return NIL_REAL_ZERO;
+
+    if ( axis.trigger )
+    {
+      val -= info.minimum;
+      if ( val <= info.flat )
+        return NIL_REAL_ZERO;
+      auto ret = static_cast<Real>( val - info.flat ) / static_cast<Real>( info.maximum - info.minimum - info.flat );
+      return ( ret > NIL_REAL_ONE ? NIL_REAL_ONE : ret );
+    }
+
+    // Center the range, then apply the driver's flat zone as a deadzone
+    auto half = static_cast<Real>( info.maximum - info.minimum ) / 2;
+    auto centered = static_cast<Real>( val - info.minimum ) - half;
+    auto flat = static_cast<Real>( info.flat );
+    if ( centered > -flat && centered < flat )
+      return NIL_REAL_ZERO;
+    if ( half <= flat )
+      return NIL_REAL_ZERO;
+
+    auto ret = ( centered < 0 ? centered + flat : centered - flat ) / ( half - flat );
+    if ( ret < NIL_REAL_MINUSONE )
+      return NIL_REAL_MINUSONE;
+    return ( ret > NIL_REAL_ONE ? NIL_REAL_ONE : ret );
+  }
+
+  void EvdevController::handleAbsolute( unsigned int code, int value )
+  {
+    if ( isHatAxis( code ) )
+    {
+      size_t pov = ( code - ABS_HAT0X ) / 2;
+      if ( pov >= hats_.size() )
+        return;
+
+      if ( ( code - ABS_HAT0X ) % 2 == 0 )
+        hats_[pov].x = value;
+      else
+        hats_[pov].y = value;
+
+      POVDirection& direction = state_.povs[pov].direction;
+      direction = POV::Centered;
+      if ( hats_[pov].y < 0 )
+        direction |= POV::North;
+      else if ( hats_[pov].y > 0 )
+        direction |= POV::South;
+      if ( hats_[pov].x < 0 )
+        direction |= POV::West;
+      else if ( hats_[pov].x > 0 )
+        direction |= POV::East;
+      return;
+    }
+
+    if ( code >= axisMap_.size() || axisMap_[code] < 0 )
+      return;
+
+    state_.axes[axisMap_[code]].absolute = filterAxis( value, axes_[axisMap_[code]] );
+  }
+
+  void EvdevController::resync()
+  {
+    const int fd = node_->getDescriptor();
+
+    uint8_t keys[KEY_MAX / 8 + 1] = { 0 };
+    if ( ioctl( fd, EVIOCGKEY( sizeof( keys ) ), keys ) >= 0 )
+    {
+      for ( unsigned int code = BTN_MISC; code < KEY_CNT; code++ )
+        if ( buttonMap_[code] >= 0 )
+          state_.buttons[buttonMap_[code]].pushed = util::testBit( keys, code );
+    }
+
+    input_absinfo info;
+    for ( unsigned int code = 0; code < ABS_MT_SLOT; code++ )
+    {
+      if ( axisMap_[code] < 0 && !( isHatAxis( code ) && ( code - ABS_HAT0X ) / 2 < hats_.size() ) )
+        continue;
+
+      if ( ioctl( fd, EVIOCGABS( code ), &info ) >= 0 )
+        handleAbsolute( code, info.value );
+    }
+  }
+
+  void EvdevController::onEvdevInput( const input_event* events, size_t count )
+  {
+    for ( size_t i = 0; i < count; i++ )
+    {
+      const input_event& event = events[i];
+
+      if ( event.type == EV_SYN )
+      {
+        if ( event.code == SYN_DROPPED )
+          dropped_ = true;
+        else if ( event.code == SYN_REPORT )
+        {
+          if ( dropped_ )
+          {
+            resync();
+            dropped_ = false;
+          }
+          timestamp_ = util::eventTimestamp( event );
+          fireChanges( lastState_ );
+          lastState_ = state_;
+        }
+        continue;
+      }
+
+      if ( dropped_ )
+        continue;
+
+      if ( event.type == EV_KEY )
+      {
+        if ( event.code < buttonMap_.size() && buttonMap_[event.code] >= 0 )
+          state_.buttons[buttonMap_[event.code]].pushed = ( event.value != 0 );
+      }
+      else if ( event.type == EV_ABS )
+        handleAbsolute( event.code, event.value );
+    }
+  }
+
+  void EvdevController::onEvdevError( int error )
+  {
+    // ENODEV is the usual way to learn about an unplug, but there is
+    // nothing to salvage from any other read failure either.
+    (void)error;
+
+    device_->flagDisconnected();
+  }
+
+  void EvdevController::update()
+  {
+    // Nothing to update, since we process events as they come
+  }
+
+  EvdevController::~EvdevController()
+  {
+  }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+#include "nilLinux.h"
+
+#ifdef NIL_PLATFORM_LINUX
+
+namespace nil {
+
+  // EvdevDeviceInfo class
+
+  EvdevDeviceInfo::EvdevDeviceInfo( int fd )
+  {
+    // The kernel limits these strings to far less than this
+    char buffer[256] = { 0 };
+
+    ioctl( fd, EVIOCGID, &inputId_ );
+
+    if ( ioctl( fd, EVIOCGNAME( sizeof( buffer ) - 1 ), buffer ) >= 0 )
+      deviceName_ = buffer;
+
+    memset( buffer, 0, sizeof( buffer ) );
+    if ( ioctl( fd, EVIOCGPHYS( sizeof( buffer ) - 1 ), buffer ) >= 0 )
+      physPath_ = buffer;
+
+    // Nodes that don't answer these are not evdev devices at all,
+    // and will simply resolve to an unsupported type.
+    ioctl( fd, EVIOCGBIT( 0, sizeof( evBits_ ) ), evBits_ );
+    ioctl( fd, EVIOCGBIT( EV_KEY, sizeof( keyBits_ ) ), keyBits_ );
+    ioctl( fd, EVIOCGBIT( EV_REL, sizeof( relBits_ ) ), relBits_ );
+    ioctl( fd, EVIOCGBIT( EV_ABS, sizeof( absBits_ ) ), absBits_ );
+  }
+
+  bool EvdevDeviceInfo::hasEventType( unsigned int type ) const
+  {
+    return ( type <= EV_MAX && util::testBit( evBits_, type ) );
+  }
+
+  bool EvdevDeviceInfo::hasKey( unsigned int code ) const
+  {
+    return ( code <= KEY_MAX && util::testBit( keyBits_, code ) );
+  }
+
+  bool EvdevDeviceInfo::hasRelative( unsigned int code ) const
+  {
+    return ( code <= REL_MAX && util::testBit( relBits_, code ) );
+  }
+
+  bool EvdevDeviceInfo::hasAbsolute( unsigned int code ) const
+  {
+    return ( code <= ABS_MAX && util::testBit( absBits_, code ) );
+  }
+
+  bool EvdevDeviceInfo::resolveType( Device::Type& type ) const
+  {
+    // Joystick & gamepad buttons occupy BTN_JOYSTICK up to BTN_DIGI
+    if ( hasEventType( EV_ABS ) )
+    {
+      for ( unsigned int code = BTN_JOYSTICK; code < BTN_DIGI; code++ )
+        if ( hasKey( code ) )
+        {
+          type = Device::Device_Controller;
+          return true;
+        }
+    }
+
+    if ( hasRelative( REL_X ) && hasRelative( REL_Y ) && hasKey( BTN_LEFT ) )
+    {
+      type = Device::Device_Mouse;
+      return true;
+    }
+
+    // Media key & power button nodes also claim EV_KEY; demand some letters
+    if ( hasKey( KEY_A ) && hasKey( KEY_Z ) && hasKey( KEY_SPACE ) )
+    {
+      type = Device::Device_Keyboard;
+      return true;
+    }
+
+    return false;
+  }
+
+  const input_id& EvdevDeviceInfo::getInputID() const
+  {
+    return inputId_;
+  }
+
+  const utf8String& EvdevDeviceInfo::getPhysPath() const
+  {
+    return physPath_;
+  }
+
+  bool EvdevDeviceInfo::isSameDevice( const EvdevDeviceInfo& other ) const
+  {
+    if ( physPath_.empty() || physPath_ != other.physPath_ || deviceName_ != other.deviceName_ )
+      return false;
+
+    return ( memcmp( &inputId_, &other.inputId_, sizeof( input_id ) ) == 0 );
+  }
+
+  EvdevDeviceInfo::~EvdevDeviceInfo()
+  {
+  }
+
+  // EvdevDevice class
+
+  EvdevDevice::EvdevDevice( System* system, DeviceID id, const utf8String& nodePath,
+  const EvdevDeviceInfo& info ): EvdevDeviceInfo( info ), Device( system, id, evdevResolveType() ),
+  nodePath_( nodePath )
+  {
+    // Only replace auto-generated name if fetched one isn't empty
+    utf8String tmpName = deviceName_;
+    util::trim( tmpName );
+    if ( !tmpName.empty() )
+      name_ = tmpName;
+  }
+
+  void EvdevDevice::setNode( const utf8String& nodePath, const EvdevDeviceInfo& info )
+  {
+    // Our instance was torn down on disconnect, so nothing holds the old node
+    EvdevDeviceInfo::operator = ( info );
+    nodePath_ = nodePath;
+  }
+
+  Device::Type EvdevDevice::evdevResolveType() const
+  {
+    Device::Type type;
+    if ( !resolveType( type ) )
+      NIL_EXCEPT( "Unsupported evdev device type" );
+    return type;
+  }
+
+  Device::Handler EvdevDevice::getHandler() const
+  {
+    return Device::Handler_Evdev;
+  }
+
+  DeviceID EvdevDevice::getStaticID() const
+  {
+    // Static ID for evdev devices:
+    // 4 bits of handler ID, 28 bits of unique id (hashed input ID & physical path).
+    // Node numbers are handed out in probe order, so they are no good here.
+
+    DeviceID id = util::fnv_32a_buf(
+      (void*)&inputId_, sizeof( input_id ), FNV1_32A_INIT );
+
+    const utf8String& location = ( physPath_.empty() ? nodePath_ : physPath_ );
+    id = util::fnv_32a_buf( (void*)location.c_str(), location.length(), id );
+
+    return ( ( id >> 4 ) | ( ( Handler_Evdev + 1 ) << 28 ) );
+  }
+
+  const utf8String& EvdevDevice::getNodePath() const
+  {
+    return nodePath_;
+  }
+
+}
+
+#endif
\ No newline at end of file
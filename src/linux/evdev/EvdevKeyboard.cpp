@@ -0,0 +1,105 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+#include "nilLinux.h"
+#include "nilKeys.h"
+
+#ifdef NIL_PLATFORM_LINUX
+
+namespace nil {
+
+  EvdevKeyboard::EvdevKeyboard( EvdevDevicePtr device ):
+  Keyboard( device->getSystem(), device.get() )
+  {
+    node_ = make_unique<posix::DeviceNode>( device->getSystem()->eventMonitor_.get(), device->getNodePath(), this );
+  }
+
+  VirtualKeyCode EvdevKeyboard::translateKey( unsigned int code )
+  {
+    return keys::translateEvdevCode( code );
+  }
+
+  void EvdevKeyboard::handleKey( unsigned int code, int value )
+  {
+    VirtualKeyCode virtualKey = translateKey( code );
+    if ( virtualKey == Key_Invalid )
+      return;
+
+    // Evdev tells repeats apart by itself: 0 is release, 1 press, 2 repeat
+    if ( value == 0 )
+    {
+      keyState_[code / 8] &= ~( 1 << ( code % 8 ) );
+      fireKeyReleased( virtualKey );
+    }
+    else if ( value == 2 && util::testBit( keyState_, code ) )
+    {
+      fireKeyRepeat( virtualKey );
+    }
+    else
+    {
+      keyState_[code / 8] |= ( 1 << ( code % 8 ) );
+      fireKeyPressed( virtualKey );
+    }
+  }
+
+  void EvdevKeyboard::resync()
+  {
+    uint8_t keys[KEY_MAX / 8 + 1] = { 0 };
+    if ( ioctl( node_->getDescriptor(), EVIOCGKEY( sizeof( keys ) ), keys ) < 0 )
+      return;
+
+    for ( unsigned int code = 0; code <= KEY_MAX; code++ )
+    {
+      bool pushed = util::testBit( keys, code );
+      if ( util::testBit( keyState_, code ) != pushed )
+        handleKey( code, pushed ? 1 : 0 );
+    }
+  }
+
+  void EvdevKeyboard::onEvdevInput( const input_event* events, size_t count )
+  {
+    for ( size_t i = 0; i < count; i++ )
+    {
+      const input_event& event = events[i];
+
+      if ( event.type == EV_SYN )
+      {
+        if ( event.code == SYN_DROPPED )
+          dropped_ = true;
+        else if ( event.code == SYN_REPORT && dropped_ )
+        {
+          timestamp_ = util::eventTimestamp( event );
+          resync();
+          dropped_ = false;
+        }
+      }
+      else if ( event.type == EV_KEY && !dropped_ )
+      {
+        timestamp_ = util::eventTimestamp( event );
+        handleKey( event.code, event.value );
+      }
+    }
+  }
+
+  void EvdevKeyboard::onEvdevError( int error )
+  {
+    // ENODEV is the usual way to learn about an unplug, but there is
+    // nothing to salvage from any other read failure either.
+    (void)error;
+
+    device_->flagDisconnected();
+  }
+
+  void EvdevKeyboard::update()
+  {
+    // Nothing to update, since we process events as they come
+  }
+
+  EvdevKeyboard::~EvdevKeyboard()
+  {
+  }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+#include "nilLinux.h"
+
+#ifdef NIL_PLATFORM_LINUX
+
+namespace nil {
+
+  // Evdev numbers mouse buttons from BTN_LEFT through BTN_TASK,
+  // with side & extra matching Windows' XBUTTON1 & XBUTTON2.
+  const unsigned int c_evdevMouseButtons = ( BTN_TASK - BTN_LEFT + 1 );
+
+  // Wheel units per notch, as reported by REL_WHEEL_HI_RES and Raw Input alike
+  const int c_wheelDelta = 120;
+
+  EvdevMouse::EvdevMouse( EvdevDevicePtr device, const bool swapButtons ):
+  Mouse( device->getSystem(), device.get(), swapButtons )
+  {
+    node_ = make_unique<posix::DeviceNode>( device->getSystem()->eventMonitor_.get(), device->getNodePath(), this );
+
+    size_t buttons = 0;
+    for ( unsigned int i = 0; i < c_evdevMouseButtons; i++ )
+      if ( device->hasKey( BTN_LEFT + i ) )
+        buttons = i + 1;
+
+    state_.buttons.resize( buttons );
+
+#ifdef REL_WHEEL_HI_RES
+    hiResWheel_ = device->hasRelative( REL_WHEEL_HI_RES );
+#endif
+  }
+
+  int EvdevMouse::translateButton( unsigned int code ) const
+  {
+    if ( code < BTN_LEFT || code >= BTN_LEFT + c_evdevMouseButtons )
+      return -1;
+
+    int button = static_cast<int>( code - BTN_LEFT );
+    if ( swapButtons_ && button < 2 )
+      button ^= 1;
+
+    return ( static_cast<size_t>( button ) < state_.buttons.size() ? button : -1 );
+  }
+
+  void EvdevMouse::flushPacket()
+  {
+    // Reset everything but the buttons, unless summing up the whole update
+    if ( !coalescing_ )
+      state_.reset();
+
+    fireMovement( pendingMovement_ );
+
+    for ( size_t i = 0; pendingButtons_ && i < state_.buttons.size(); i++ )
+    {
+      if ( pendingButtons_ & ( 1 << i ) )
+        fireButton( i, state_.buttons[i].pushed );
+    }
+
+    if ( pendingWheel_ != 0 )
+      fireWheel( pendingWheel_ );
+
+    recordSample( pendingMovement_, pendingWheel_ );
+
+    pendingMovement_ = Vector2i::ZERO;
+    pendingWheel_ = 0;
+    pendingButtons_ = 0;
+  }
+
+  void EvdevMouse::resync()
+  {
+    // Whatever motion we had is unreliable now; only buttons can be recovered
+    pendingMovement_ = Vector2i::ZERO;
+    pendingWheel_ = 0;
+    pendingButtons_ = 0;
+
+    uint8_t keys[KEY_MAX / 8 + 1] = { 0 };
+    if ( ioctl( node_->getDescriptor(), EVIOCGKEY( sizeof( keys ) ), keys ) < 0 )
+      return;
+
+    for ( unsigned int i = 0; i < c_evdevMouseButtons; i++ )
+    {
+      int button = translateButton( BTN_LEFT + i );
+      if ( button < 0 )
+        continue;
+
+      bool pushed = util::testBit( keys, BTN_LEFT + i );
+      if ( state_.buttons[button].pushed != pushed )
+      {
+        state_.buttons[button].pushed = pushed;
+        pendingButtons_ |= ( 1 << button );
+      }
+    }
+  }
+
+  void EvdevMouse::onEvdevInput( const input_event* events, size_t count )
+  {
+    for ( size_t i = 0; i < count; i++ )
+    {
+      const input_event& event = events[i];
+
+      if ( event.type == EV_SYN )
+      {
+        if ( event.code == SYN_DROPPED )
+          dropped_ = true;
+        else if ( event.code == SYN_REPORT )
+        {
+          if ( dropped_ )
+          {
+            resync();
+            dropped_ = false;
+          }
+          timestamp_ = util::eventTimestamp( event );
+          flushPacket();
+        }
+        continue;
+      }
+
+      // Everything up to the next report is garbage after a drop
+      if ( dropped_ )
+        continue;
+
+      if ( event.type == EV_REL )
+      {
+        switch ( event.code )
+        {
+          case REL_X:
+            pendingMovement_.x += event.value;
+          break;
+          case REL_Y:
+            pendingMovement_.y += event.value;
+          break;
+          case REL_WHEEL:
+            if ( !hiResWheel_ )
+              pendingWheel_ += event.value * c_wheelDelta;
+          break;
+#ifdef REL_WHEEL_HI_RES
+          case REL_WHEEL_HI_RES:
+            pendingWheel_ += event.value;
+          break;
+#endif
+        }
+      }
+      else if ( event.type == EV_KEY )
+      {
+        int button = translateButton( event.code );
+        if ( button < 0 )
+          continue;
+
+        bool pushed = ( event.value != 0 );
+        if ( state_.buttons[button].pushed != pushed )
+        {
+          state_.buttons[button].pushed = pushed;
+          pendingButtons_ |= ( 1 << button );
+        }
+      }
+    }
+  }
+
+  void EvdevMouse::onEvdevError( int error )
+  {
+    // ENODEV is the usual way to learn about an unplug, but there is
+    // nothing to salvage from any other read failure either.
+    (void)error;
+
+    device_->flagDisconnected();
+  }
+
+  void EvdevMouse::update()
+  {
+    // Events are processed as they come; only coalesced motion is left
+    Mouse::update();
+  }
+
+  EvdevMouse::~EvdevMouse()
+  {
+  }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+#include "nilHID.h"
+
+#ifdef NIL_PLATFORM_LINUX
+
+namespace nil {
+
+  HidrawController::HidrawController( HidrawDevicePtr device ):
+  Controller( device->getSystem(), device.get() )
+  {
+    devType_ = device->knownDeviceType();
+    connType_ = device->connectionType();
+
+    if ( devType_ == KnownDevice_DualSense )
+    {
+      type_ = Controller_Gamepad;
+      hid::setupDualSense( state_ );
+      reportLength_ = ( connType_ == HIDConnection_Bluetooth
+        ? hid::c_dualSenseBluetoothReportLength
+        : hid::c_dualSenseUSBReportLength );
+    }
+
+    lastState_ = state_;
+
+    node_ = make_unique<posix::DeviceNode>( device->getSystem()->eventMonitor_.get(), device->getNodePath(), this );
+  }
+
+  void HidrawController::handleReport( const uint8_t* report, size_t length )
+  {
+    system_->captureReport( device_, report, length );
+
+    if ( devType_ == KnownDevice_DualSense )
+    {
+      if ( !hid::parseDualSense( report, length, connType_, state_ ) )
+        return;
+    }
+
+    fireChanges( lastState_ );
+    lastState_ = state_;
+  }
+
+  void HidrawController::onHidrawInput( const uint8_t* data, size_t length, Timestamp timestamp )
+  {
+    timestamp_ = timestamp;
+
+    // Fire per report, so that a press & release within one read still shows.
+    // Only stand-ins like pipes can hand us more than one report per read.
+    if ( reportLength_ && length > reportLength_ )
+    {
+      for ( size_t offset = 0; offset + reportLength_ <= length; offset += reportLength_ )
+        handleReport( data + offset, reportLength_ );
+    }
+    else
+      handleReport( data, length );
+  }
+
+  void HidrawController::onHidrawError( int error )
+  {
+    // ENODEV is the usual way to learn about an unplug, but there is
+    // nothing to salvage from any other read failure either.
+    (void)error;
+
+    device_->flagDisconnected();
+  }
+
+  void HidrawController::update()
+  {
+    // Nothing to update, since we process reports as they come
+  }
+
+  HidrawController::~HidrawController()
+  {
+  }
+
+}
+
+#endif
\ No newline at end of file
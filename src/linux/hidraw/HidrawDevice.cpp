@@ -0,0 +1,74 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+#ifdef NIL_PLATFORM_LINUX
+
+namespace nil {
+
+  HidrawDevice::HidrawDevice( System* system, DeviceID id, const utf8String& nodePath,
+  const hidraw_devinfo& info, const utf8String& physPath, const KnownDeviceRecord* knownDevice ):
+  Device( system, id, Device_Controller ), nodePath_( nodePath ), physPath_( physPath ),
+  info_( info ), knownDevice_( knownDevice )
+  {
+    assert( knownDevice_ );
+    name_ = knownDevice_->name;
+  }
+
+  void HidrawDevice::setNode( const utf8String& nodePath )
+  {
+    nodePath_ = nodePath;
+  }
+
+  Device::Handler HidrawDevice::getHandler() const
+  {
+    return Device::Handler_HID;
+  }
+
+  DeviceID HidrawDevice::getStaticID() const
+  {
+    // Static ID for hidraw devices:
+    // 4 bits of handler ID, 28 bits of unique id (hashed device info & physical path).
+
+    DeviceID id = util::fnv_32a_buf(
+      (void*)&info_, sizeof( hidraw_devinfo ), FNV1_32A_INIT );
+
+    id = util::fnv_32a_buf( (void*)physPath_.c_str(), physPath_.length(), id );
+
+    return ( ( id >> 4 ) | ( ( Handler_HID + 1 ) << 28 ) );
+  }
+
+  const utf8String& HidrawDevice::getNodePath() const
+  {
+    return nodePath_;
+  }
+
+  const utf8String& HidrawDevice::getPhysPath() const
+  {
+    return physPath_;
+  }
+
+  const hidraw_devinfo& HidrawDevice::getInfo() const
+  {
+    return info_;
+  }
+
+  KnownDeviceType HidrawDevice::knownDeviceType() const
+  {
+    return knownDevice_->type;
+  }
+
+  HIDConnectionType HidrawDevice::connectionType() const
+  {
+    if ( info_.bustype == BUS_USB )
+      return HIDConnection_USB;
+    else if ( info_.bustype == BUS_BLUETOOTH )
+      return HIDConnection_Bluetooth;
+
+    return HIDConnection_Unknown;
+  }
+
+}
+
+#endif
\ No newline at end of file
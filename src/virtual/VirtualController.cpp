@@ -0,0 +1,79 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+namespace nil {
+
+  VirtualController::VirtualController( VirtualDevicePtr device ):
+  Controller( device->getSystem(), device.get() )
+  {
+    const auto& layout = device->getLayout();
+
+    type_ = Controller_Gamepad;
+
+    state_.buttons.resize( layout.buttons );
+    state_.axes.resize( layout.axes );
+    state_.sliders.resize( layout.sliders );
+    state_.povs.resize( layout.povs );
+
+    lastState_ = state_;
+  }
+
+  void VirtualController::setButton( size_t button, bool pushed )
+  {
+    if ( button < state_.buttons.size() )
+      state_.buttons[button].pushed = pushed;
+  }
+
+  void VirtualController::setAxis( size_t axis, Real value )
+  {
+    if ( axis < state_.axes.size() )
+      state_.axes[axis].absolute = value;
+  }
+
+  void VirtualController::setSlider( size_t slider, const Vector2f& value )
+  {
+    if ( slider < state_.sliders.size() )
+      state_.sliders[slider].absolute = value;
+  }
+
+  void VirtualController::setPOV( size_t pov, POVDirection direction )
+  {
+    if ( pov < state_.povs.size() )
+      state_.povs[pov].direction = direction;
+  }
+
+  void VirtualController::commit( Timestamp timestamp )
+  {
+    timestamp_ = ( timestamp ? timestamp : currentTimestamp() );
+
+    fireChanges( lastState_ );
+
+    // Same sizes every time, so this never allocates
+    lastState_ = state_;
+  }
+
+  void VirtualController::inject( const ControllerState& state, Timestamp timestamp )
+  {
+    if ( state.buttons.size() != state_.buttons.size()
+      || state.axes.size() != state_.axes.size()
+      || state.sliders.size() != state_.sliders.size()
+      || state.povs.size() != state_.povs.size() )
+      NIL_EXCEPT( "Injected state does not match virtual controller layout" );
+
+    state_ = state;
+
+    commit( timestamp );
+  }
+
+  void VirtualController::update()
+  {
+    // Nothing to update, since injections fire as they come
+  }
+
+  VirtualController::~VirtualController()
+  {
+  }
+
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+namespace nil {
+
+  VirtualDevice::VirtualDevice( System* system, DeviceID id, Type type,
+  const utf8String& name, const Layout& layout, DeviceID staticId ):
+  Device( system, id, type ), layout_( layout ), staticId_( staticId )
+  {
+    // Only replace auto-generated name if given one isn't empty
+    if ( !name.empty() )
+      name_ = name;
+
+    // Stand-ins for recorded devices keep the ID they were recorded with
+    if ( staticId_ )
+      return;
+
+    // Static ID for virtual devices:
+    // 4 bits of handler ID, 28 bits of unique id (hashed type & name).
+    // Autogenerated names are unique per type, so this stays unique too.
+    DeviceID hash = util::fnv_32a_buf( (void*)&type_, sizeof( Type ), FNV1_32A_INIT );
+    hash = util::fnv_32a_buf( (void*)name_.c_str(), name_.length(), hash );
+
+    staticId_ = ( ( hash >> 4 ) | ( ( Handler_Virtual + 1 ) << 28 ) );
+  }
+
+  Device::Handler VirtualDevice::getHandler() const
+  {
+    return Device::Handler_Virtual;
+  }
+
+  DeviceID VirtualDevice::getStaticID() const
+  {
+    return staticId_;
+  }
+
+  const VirtualDevice::Layout& VirtualDevice::getLayout() const
+  {
+    return layout_;
+  }
+
+  void VirtualDevice::unplug()
+  {
+    flagDisconnected();
+  }
+
+  void VirtualDevice::plug()
+  {
+    if ( status_ == Status_Disconnected )
+      system_->deviceConnect( ptr() );
+  }
+
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+namespace nil {
+
+  VirtualKeyboard::VirtualKeyboard( VirtualDevicePtr device ):
+  Keyboard( device->getSystem(), device.get() )
+  {
+  }
+
+  void VirtualKeyboard::injectKeyPressed( const VirtualKeyCode keycode, Timestamp timestamp )
+  {
+    timestamp_ = ( timestamp ? timestamp : currentTimestamp() );
+
+    fireKeyPressed( keycode );
+  }
+
+  void VirtualKeyboard::injectKeyRepeat( const VirtualKeyCode keycode, Timestamp timestamp )
+  {
+    timestamp_ = ( timestamp ? timestamp : currentTimestamp() );
+
+    fireKeyRepeat( keycode );
+  }
+
+  void VirtualKeyboard::injectKeyReleased( const VirtualKeyCode keycode, Timestamp timestamp )
+  {
+    timestamp_ = ( timestamp ? timestamp : currentTimestamp() );
+
+    fireKeyReleased( keycode );
+  }
+
+  void VirtualKeyboard::update()
+  {
+    // Nothing to update, since injections fire as they come
+  }
+
+  VirtualKeyboard::~VirtualKeyboard()
+  {
+  }
+
+}
\ No newline at end of file
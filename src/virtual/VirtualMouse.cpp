@@ -0,0 +1,61 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+
+namespace nil {
+
+  VirtualMouse::VirtualMouse( VirtualDevicePtr device ):
+  Mouse( device->getSystem(), device.get(), false )
+  {
+    state_.buttons.resize( device->getLayout().buttons );
+  }
+
+  void VirtualMouse::injectMovement( const Vector2i& delta, Timestamp timestamp )
+  {
+    timestamp_ = ( timestamp ? timestamp : currentTimestamp() );
+
+    // Reset everything but the buttons, unless summing up the whole update
+    if ( !coalescing_ )
+      state_.reset();
+
+    fireMovement( delta );
+    recordSample( delta, 0 );
+  }
+
+  void VirtualMouse::injectButton( size_t button, bool pushed, Timestamp timestamp )
+  {
+    if ( button >= state_.buttons.size() || state_.buttons[button].pushed == pushed )
+      return;
+
+    timestamp_ = ( timestamp ? timestamp : currentTimestamp() );
+
+    if ( !coalescing_ )
+      state_.reset();
+
+    fireButton( button, pushed );
+    recordSample( Vector2i::ZERO, 0 );
+  }
+
+  void VirtualMouse::injectWheel( int delta, Timestamp timestamp )
+  {
+    timestamp_ = ( timestamp ? timestamp : currentTimestamp() );
+
+    if ( !coalescing_ )
+      state_.reset();
+
+    fireWheel( delta );
+    recordSample( Vector2i::ZERO, delta );
+  }
+
+  void VirtualMouse::update()
+  {
+    // Injections fire as they come; only coalesced motion is left
+    Mouse::update();
+  }
+
+  VirtualMouse::~VirtualMouse()
+  {
+  }
+
+}
\ No newline at end of file
@@ -93,21 +93,26 @@ namespace nil {
 
       auto raw = reinterpret_cast<const RAWINPUT*>( inputBuffer_.data() );
 
+      // The message time is on the millisecond tick count, and we get to it
+      // only once the queue is pumped; step back from now by its age.
+      auto age = static_cast<Timestamp>( GetTickCount() - static_cast<DWORD>( GetMessageTime() ) );
+      auto timestamp = currentTimestamp() - age * 1000000ULL;
+
       // Ping our listeners
       if ( raw->header.dwType == RIM_TYPEMOUSE )
       {
         for ( auto& listener : rawListeners_ )
-          listener->onRawMouseInput( raw->header.hDevice, raw->data.mouse, sinked );
+          listener->onRawMouseInput( raw->header.hDevice, raw->data.mouse, sinked, timestamp );
       }
       else if ( raw->header.dwType == RIM_TYPEKEYBOARD )
       {
         for ( auto& listener : rawListeners_ )
-          listener->onRawKeyboardInput( raw->header.hDevice, raw->data.keyboard, sinked );
+          listener->onRawKeyboardInput( raw->header.hDevice, raw->data.keyboard, sinked, timestamp );
       }
       else if ( raw->header.dwType == RIM_TYPEHID )
       {
         for ( auto& listener : rawListeners_ )
-          listener->onRawHIDInput( raw->header.hDevice, raw->data.hid, sinked );
+          listener->onRawHIDInput( raw->header.hDevice, raw->data.hid, sinked, timestamp );
       }
     }
 
@@ -11,9 +11,11 @@ namespace nil {
 
   namespace windows {
 
-    HIDManager::HIDManager()
+    HIDManager::HIDManager( const utf8String& cachePath )
     {
       HidD_GetHidGuid( &g_HIDInterfaceGUID );
+      if ( !cachePath.empty() )
+        cache_ = make_unique<HIDProbeCache>( cachePath );
       initialize();
     }
 
@@ -22,23 +24,22 @@ namespace nil {
       return records_;
     }
 
+    void HIDManager::addRecord( HIDRecordPtr record )
+    {
+      if ( recordsByPath_.emplace( record->getPathKey(), record ).second )
+        records_.push_back( record );
+    }
+
     void HIDManager::onPnPPlug( const GUID& deviceClass, const wideString& devicePath )
     {
       if ( deviceClass != g_HIDInterfaceGUID )
         return;
 
-      for ( auto& record : records_ )
-        if ( util::compareDevicePaths( record->getPath(), devicePath ) )
-          return;
-
-      SafeHandle deviceHandle( CreateFileW( devicePath.c_str(), 0,
-        FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr ) );
+      if ( getRecordByPath( devicePath ) )
+        return;
 
-      if ( deviceHandle.valid() )
-      {
-        auto record = make_shared<HIDRecord>( devicePath, deviceHandle );
-        records_.push_back( record );
-      }
+      if ( auto record = probeDevice( devicePath, cache_.get() ) )
+        addRecord( record );
     }
 
     void HIDManager::onPnPUnplug( const GUID& deviceClass, const wideString& devicePath )
@@ -46,45 +47,39 @@ namespace nil {
       if ( deviceClass != g_HIDInterfaceGUID )
         return;
 
-      for ( auto& record : records_ )
-        if ( util::compareDevicePaths( record->getPath(), devicePath ) )
-        {
-          records_.remove( record );
-          return;
-        }
+      auto it = recordsByPath_.find( util::canonicalDevicePath( devicePath ) );
+      if ( it == recordsByPath_.end() )
+        return;
+
+      records_.remove( it->second );
+      recordsByPath_.erase( it );
     }
 
     HIDRecordPtr HIDManager::getRecordByPath( const wideString& devicePath )
     {
-      for ( auto& record : records_ )
-        if ( util::compareDevicePaths( record->getPath(), devicePath ) )
-          return record;
-
-      return HIDRecordPtr();
+      // Raw Input, SetupAPI & device notifications all spell paths a little
+      // differently, but they come down to the same canonical form
+      return getRecordByPathKey( util::canonicalDevicePath( devicePath ) );
     }
 
-    void HIDManager::processDevice( SP_DEVICE_INTERFACE_DATA& interfaceData,
-    SP_DEVINFO_DATA& deviceData, const wideString& devicePath )
+    HIDRecordPtr HIDManager::getRecordByPathKey( const wideString& pathKey )
     {
-      UNREFERENCED_PARAMETER( deviceData );
-
-      if ( interfaceData.InterfaceClassGuid != g_HIDInterfaceGUID )
-        return;
+      auto it = recordsByPath_.find( pathKey );
+      if ( it == recordsByPath_.end() )
+        return HIDRecordPtr();
 
-      // Well, this string comparison is kind of nasty, but it seems
-      // to be what everyone does. Nothing else is quite reliable enough.
-      for ( auto& record : records_ )
-        if ( util::compareDevicePaths( record->getPath(), devicePath ) )
-          return;
+      return it->second;
+    }
 
+    HIDRecordPtr HIDManager::probeDevice( const wideString& devicePath, const HIDProbeCache* cache )
+    {
       SafeHandle deviceHandle( CreateFileW( devicePath.c_str(), 0,
         FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr ) );
 
-      if ( deviceHandle.valid() )
-      {
-        auto record = make_shared<HIDRecord>( devicePath, deviceHandle );
-        records_.push_back( record );
-      }
+      if ( !deviceHandle.valid() )
+        return HIDRecordPtr();
+
+      return make_shared<HIDRecord>( devicePath, deviceHandle, cache );
     }
 
     void HIDManager::initialize()
@@ -98,6 +93,8 @@ namespace nil {
       SP_DEVINFO_DATA deviceData {
         .cbSize = sizeof( SP_DEVINFO_DATA ) };
 
+      vector<wideString> devicePaths;
+
       for ( unsigned long dev = 0; SetupDiEnumDeviceInfo( info, dev, &deviceData ); ++dev )
       {
         SP_DEVICE_INTERFACE_DATA interfaceData = {
@@ -115,12 +112,26 @@ namespace nil {
           auto detailData = reinterpret_cast<SP_DEVICE_INTERFACE_DETAIL_DATA_W*>( detailBuffer.data() );
           detailData->cbSize = sizeof( SP_INTERFACE_DEVICE_DETAIL_DATA_W );
 
-          if ( SetupDiGetDeviceInterfaceDetailW( info, &interfaceData, detailData, length, nullptr, &deviceData ) )
-            processDevice( interfaceData, deviceData, detailData->DevicePath );
+          if ( SetupDiGetDeviceInterfaceDetailW( info, &interfaceData, detailData, length, nullptr, &deviceData )
+            && interfaceData.InterfaceClassGuid == g_HIDInterfaceGUID )
+            devicePaths.emplace_back( detailData->DevicePath );
         }
       }
 
       SetupDiDestroyDeviceInfoList( info );
+
+      // Opening a device & querying its attributes & strings is slow,
+      // and some devices are slower than others; do them all at once
+      auto cache = cache_.get();
+      auto records = util::probeConcurrently( devicePaths,
+        [cache]( const wideString& devicePath ) { return probeDevice( devicePath, cache ); } );
+
+      for ( auto& record : records )
+        if ( record )
+          addRecord( record );
+
+      if ( cache_ )
+        cache_->update( records_ );
     }
 
     HIDManager::~HIDManager()
@@ -0,0 +1,172 @@
+#include "nilConfig.h"
+
+#include "nilWindowsPNP.h"
+#include "nilUtil.h"
+
+#ifdef NIL_PLATFORM_WINDOWS
+
+namespace nil {
+
+  namespace windows {
+
+    //! Probe cache file magic, "NILHPC" followed by the format version.
+    const char c_probeCacheMagic[8] = { 'N', 'I', 'L', 'H', 'P', 'C', 0, 1 };
+
+    //! Header in front of every entry in a probe cache file.
+    //! The UTF-8 device path, name, manufacturer & serial follow, unterminated.
+    //! Everything is stored in native byte order.
+    struct ProbeCacheEntryHeader
+    {
+      uint16_t vid;
+      uint16_t pid;
+      uint16_t pathLength;
+      uint16_t nameLength;
+      uint16_t manufacturerLength;
+      uint16_t serialLength;
+      HIDP_CAPS caps;
+    };
+
+    inline bool sameEntry( const HIDProbeCache::Entry& a, const HIDProbeCache::Entry& b )
+    {
+      return ( a.vid == b.vid && a.pid == b.pid
+        && memcmp( &a.caps, &b.caps, sizeof( HIDP_CAPS ) ) == 0
+        && a.name == b.name && a.manufacturer == b.manufacturer && a.serial == b.serial );
+    }
+
+    inline uint16_t clampedLength( const utf8String& str )
+    {
+      return static_cast<uint16_t>( std::min( str.length(), static_cast<size_t>( 0xFFFF ) ) );
+    }
+
+    HIDProbeCache::HIDProbeCache( const utf8String& path ):
+    path_( path )
+    {
+      std::ifstream file( util::utf8ToWide( path_ ), std::ios::binary | std::ios::ate );
+      if ( !file )
+        return;
+
+      vector<uint8_t> data( static_cast<size_t>( file.tellg() ) );
+      file.seekg( 0 );
+      if ( !file.read( reinterpret_cast<char*>( data.data() ), static_cast<std::streamsize>( data.size() ) ) )
+        return;
+
+      if ( data.size() < sizeof( c_probeCacheMagic ) || memcmp( data.data(), c_probeCacheMagic, sizeof( c_probeCacheMagic ) ) != 0 )
+        return;
+
+      for ( size_t offset = sizeof( c_probeCacheMagic ); offset + sizeof( ProbeCacheEntryHeader ) <= data.size(); )
+      {
+        ProbeCacheEntryHeader header;
+        memcpy( &header, data.data() + offset, sizeof( header ) );
+        offset += sizeof( header );
+
+        auto length = static_cast<size_t>( header.pathLength ) + header.nameLength
+          + header.manufacturerLength + header.serialLength;
+
+        // A truncated file can't be trusted any further than this
+        if ( offset + length > data.size() )
+          break;
+
+        auto text = reinterpret_cast<const char*>( data.data() + offset );
+        offset += length;
+
+        utf8String devicePath( text, header.pathLength );
+        text += header.pathLength;
+
+        Entry entry;
+        entry.vid = header.vid;
+        entry.pid = header.pid;
+        entry.caps = header.caps;
+        entry.name.assign( text, header.nameLength );
+        text += header.nameLength;
+        entry.manufacturer.assign( text, header.manufacturerLength );
+        text += header.manufacturerLength;
+        entry.serial.assign( text, header.serialLength );
+
+        entries_[util::utf8ToWide( devicePath )] = std::move( entry );
+      }
+    }
+
+    const HIDProbeCache::Entry* HIDProbeCache::find( const wideString& pathKey, uint16_t vid, uint16_t pid ) const
+    {
+      auto it = entries_.find( pathKey );
+      if ( it == entries_.end() || it->second.vid != vid || it->second.pid != pid )
+        return nullptr;
+
+      return &it->second;
+    }
+
+    void HIDProbeCache::update( const HIDRecordList& records )
+    {
+      std::unordered_map<wideString, Entry> entries;
+      for ( auto& record : records )
+      {
+        if ( !record->isAvailable() )
+          continue;
+
+        Entry entry;
+        entry.vid = LOWORD( record->getIdentifier() );
+        entry.pid = HIWORD( record->getIdentifier() );
+        entry.caps = record->getCaps();
+        entry.name = record->getName();
+        entry.manufacturer = record->getManufacturer();
+        entry.serial = record->getSerialNumber();
+
+        entries[record->getPathKey()] = std::move( entry );
+      }
+
+      // Nothing new means nothing to write, which is the usual case
+      auto unchanged = ( entries.size() == entries_.size() );
+      for ( auto it = entries.begin(); unchanged && it != entries.end(); ++it )
+      {
+        auto known = entries_.find( it->first );
+        unchanged = ( known != entries_.end() && sameEntry( known->second, it->second ) );
+      }
+
+      entries_ = std::move( entries );
+      if ( unchanged )
+        return;
+
+      // Write the whole thing aside first, so that a reader never sees half of it
+      auto path = util::utf8ToWide( path_ );
+      auto temporaryPath = path + L".tmp";
+      {
+        std::ofstream file( temporaryPath, std::ios::binary | std::ios::trunc );
+        if ( !file )
+          return;
+
+        file.write( c_probeCacheMagic, sizeof( c_probeCacheMagic ) );
+
+        for ( auto& [key, entry] : entries_ )
+        {
+          auto devicePath = util::wideToUtf8( key );
+          if ( devicePath.length() > 0xFFFF )
+            continue;
+
+          ProbeCacheEntryHeader header;
+          header.vid = entry.vid;
+          header.pid = entry.pid;
+          header.pathLength = static_cast<uint16_t>( devicePath.length() );
+          header.nameLength = clampedLength( entry.name );
+          header.manufacturerLength = clampedLength( entry.manufacturer );
+          header.serialLength = clampedLength( entry.serial );
+          header.caps = entry.caps;
+
+          file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+          file.write( devicePath.data(), header.pathLength );
+          file.write( entry.name.data(), header.nameLength );
+          file.write( entry.manufacturer.data(), header.manufacturerLength );
+          file.write( entry.serial.data(), header.serialLength );
+        }
+
+        if ( !file )
+          return;
+      }
+
+      MoveFileExW( temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING );
+    }
+
+  }
+
+}
+
+#endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "nilWindowsPNP.h"
 #include "nilUtil.h"
+#include "nilHID.h"
 
 #ifdef NIL_PLATFORM_WINDOWS
 
@@ -11,12 +12,6 @@ namespace nil {
 
     // clang-format off
 
-    const vector<KnownDeviceRecord> c_predefinedControllers = {
-      { USBVendor_Sony, 0x05C4, KnownDevice_DualShock4, "DualShock 4", 18 },
-      { USBVendor_Sony, 0x09CC, KnownDevice_DualShock4, "DualShock 4", 18 },
-      { USBVendor_Sony, 0x0CE6, KnownDevice_DualSense, "DualSense", 9 }
-    };
-
     const map<uint16_t, utf8String> c_vendorNameMap = {
       { USBVendor_Microsoft, "Microsoft" },
       { USBVendor_Logitech, "Logitech" },
@@ -41,17 +36,6 @@ namespace nil {
 
     // clang-format on
 
-    inline const KnownDeviceRecord* resolveKnownDevice( uint16_t vid, uint16_t pid )
-    {
-      for ( const auto& predef : c_predefinedControllers )
-      {
-        if ( vid == predef.vid && pid == predef.pid )
-          return &predef;
-      }
-
-      return nullptr;
-    }
-
     template <class T>
     unsigned long bufSizeBytes( const vector<T>& container )
     {
@@ -60,8 +44,8 @@ namespace nil {
 
     thread_local static vector<wchar_t> s_wideBuffer( 256, L'\0' );
 
-    HIDRecord::HIDRecord( const wideString& path, HANDLE handle ):
-    path_( path )
+    HIDRecord::HIDRecord( const wideString& path, HANDLE handle, const HIDProbeCache* cache ):
+    path_( path ), pathKey_( util::canonicalDevicePath( path ) )
     {
       HIDD_ATTRIBUTES attributes = { .Size = sizeof( HIDD_ATTRIBUTES ) };
 
@@ -73,57 +57,73 @@ namespace nil {
 
         hidIdent_ = MAKELONG( usbVid_, usbPid_ );
 
-        PHIDP_PREPARSED_DATA preparsedData;
-        if ( !HidD_GetPreparsedData( handle, &preparsedData ) )
-          NIL_EXCEPT( "HidD_GetPreparsedData failed" );
+        knownDevice_ = hid::resolveKnownDevice( usbVid_, usbPid_ );
+
+        // The rest costs a round trip to the device per query,
+        // which a device we've seen before can do without
+        auto cached = ( cache ? cache->find( pathKey_, usbVid_, usbPid_ ) : nullptr );
+        if ( cached )
+        {
+          caps_ = cached->caps;
+          name_ = cached->name;
+          manufacturer_ = cached->manufacturer;
+          serial_ = cached->serial;
+        }
+        else
+          query( handle );
+
+        // wprintf_s( L"HIDRecord: vid 0x%04X pid 0x%04X %S %S serial %S (%S)\r\n", usbVid_, usbPid_, manufacturer_.c_str(), name_.c_str(), serial_.c_str(), c_hidConnectionTypeNameMap.at( connectionType() ).c_str() );
+      }
+
+      identify();
+    }
 
-        if ( HidP_GetCaps( preparsedData, &caps_ ) != HIDP_STATUS_SUCCESS )
-          NIL_EXCEPT( "HidP_GetCaps failed" );
+    void HIDRecord::query( HANDLE handle )
+    {
+      PHIDP_PREPARSED_DATA preparsedData;
+      if ( !HidD_GetPreparsedData( handle, &preparsedData ) )
+        NIL_EXCEPT( "HidD_GetPreparsedData failed" );
 
-        HidD_FreePreparsedData( preparsedData );
+      if ( HidP_GetCaps( preparsedData, &caps_ ) != HIDP_STATUS_SUCCESS )
+        NIL_EXCEPT( "HidP_GetCaps failed" );
 
-        if ( HidD_GetProductString( handle, s_wideBuffer.data(), bufSizeBytes( s_wideBuffer ) ) )
-          name_ = util::cleanupName( util::wideToUtf8( s_wideBuffer.data() ) );
+      HidD_FreePreparsedData( preparsedData );
 
-        if ( HidD_GetManufacturerString( handle, s_wideBuffer.data(), bufSizeBytes( s_wideBuffer ) ) )
-          manufacturer_ = util::cleanupName( util::wideToUtf8( s_wideBuffer.data() ) );
+      if ( HidD_GetProductString( handle, s_wideBuffer.data(), bufSizeBytes( s_wideBuffer ) ) )
+        name_ = util::cleanupName( util::wideToUtf8( s_wideBuffer.data() ) );
 
-        if ( HidD_GetSerialNumberString( handle, s_wideBuffer.data(), bufSizeBytes( s_wideBuffer ) ) )
-          serial_ = util::wideToUtf8( s_wideBuffer.data() );
+      if ( HidD_GetManufacturerString( handle, s_wideBuffer.data(), bufSizeBytes( s_wideBuffer ) ) )
+        manufacturer_ = util::cleanupName( util::wideToUtf8( s_wideBuffer.data() ) );
 
-        knownDevice_ = resolveKnownDevice( usbVid_, usbPid_ );
+      if ( HidD_GetSerialNumberString( handle, s_wideBuffer.data(), bufSizeBytes( s_wideBuffer ) ) )
+        serial_ = util::wideToUtf8( s_wideBuffer.data() );
 
-        if ( knownDevice_ )
+      if ( knownDevice_ )
+      {
+        manufacturer_ = c_vendorNameMap.at( knownDevice_->vid );
+        name_ = knownDevice_->name;
+        if ( serial_.empty() && knownDevice_->reportID_Serial && connectionType() == HIDConnection_USB )
         {
-          manufacturer_ = c_vendorNameMap.at( knownDevice_->vid );
-          name_ = knownDevice_->name;
-          if ( serial_.empty() && knownDevice_->reportID_Serial && connectionType() == HIDConnection_USB )
+          vector<uint8_t> buffer( caps_.FeatureReportByteLength, 0 );
+          buffer[0] = knownDevice_->reportID_Serial;
+          if ( HidD_GetFeature( handle, buffer.data(), static_cast<unsigned long>( buffer.size() ) ) )
           {
-            vector<uint8_t> buffer( caps_.FeatureReportByteLength, 0 );
-            buffer[0] = knownDevice_->reportID_Serial;
-            if ( HidD_GetFeature( handle, buffer.data(), static_cast<unsigned long>( buffer.size() ) ) )
-            {
-              swprintf_s( s_wideBuffer.data(), s_wideBuffer.size(), L"%02X%02X%02X%02X%02X%02X",
-                buffer[6], buffer[5], buffer[4], buffer[3], buffer[2], buffer[1] );
-              serial_ = util::wideToUtf8( s_wideBuffer.data() );
-            }
+            swprintf_s( s_wideBuffer.data(), s_wideBuffer.size(), L"%02X%02X%02X%02X%02X%02X",
+              buffer[6], buffer[5], buffer[4], buffer[3], buffer[2], buffer[1] );
+            serial_ = util::wideToUtf8( s_wideBuffer.data() );
           }
         }
-        else
-        {
-          if ( manufacturer_.empty() && c_vendorNameMap.find( usbVid_ ) != c_vendorNameMap.end() )
-            manufacturer_ = c_vendorNameMap.at( usbVid_ );
-        }
-
-        // wprintf_s( L"HIDRecord: vid 0x%04X pid 0x%04X %S %S serial %S (%S)\r\n", usbVid_, usbPid_, manufacturer_.c_str(), name_.c_str(), serial_.c_str(), c_hidConnectionTypeNameMap.at( connectionType() ).c_str() );
       }
-
-      identify();
+      else
+      {
+        if ( manufacturer_.empty() && c_vendorNameMap.find( usbVid_ ) != c_vendorNameMap.end() )
+          manufacturer_ = c_vendorNameMap.at( usbVid_ );
+      }
     }
 
     void HIDRecord::identify()
     {
-      if ( wcsstr( path_.c_str(), L"ig_" ) || wcsstr( path_.c_str(), L"IG_" ) )
+      if ( isXInputPath( path_ ) )
       {
         isXInput_ = true;
       }
@@ -177,6 +177,11 @@ namespace nil {
       return isXInput_;
     }
 
+    bool HIDRecord::isXInputPath( const wideString& path )
+    {
+      return ( wcsstr( path.c_str(), L"ig_" ) || wcsstr( path.c_str(), L"IG_" ) );
+    }
+
     bool HIDRecord::isRDP() const
     {
       return isRDP_;
@@ -197,11 +202,21 @@ namespace nil {
       return caps_.Usage;
     }
 
+    const HIDP_CAPS& HIDRecord::getCaps() const
+    {
+      return caps_;
+    }
+
     const wideString& HIDRecord::getPath() const
     {
       return path_;
     }
 
+    const wideString& HIDRecord::getPathKey() const
+    {
+      return pathKey_;
+    }
+
     const utf8String& HIDRecord::getManufacturer() const
     {
       return manufacturer_;
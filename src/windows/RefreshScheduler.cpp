@@ -0,0 +1,46 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilWindowsPNP.h"
+
+#ifdef NIL_PLATFORM_WINDOWS
+
+namespace nil {
+
+  namespace windows {
+
+    void RefreshScheduler::schedule( uint32_t targets, Timestamp now )
+    {
+      if ( targets == Target_None )
+        return;
+
+      if ( pending_ == Target_None )
+        first_ = now;
+
+      pending_ |= targets;
+      last_ = now;
+    }
+
+    uint32_t RefreshScheduler::collect( Timestamp now )
+    {
+      if ( pending_ == Target_None )
+        return Target_None;
+
+      if ( now - last_ < c_settleTime && now - first_ < c_maximumDelay )
+        return Target_None;
+
+      auto targets = pending_;
+      pending_ = Target_None;
+      return targets;
+    }
+
+    uint32_t RefreshScheduler::getPending() const
+    {
+      return pending_;
+    }
+
+  }
+
+}
+
+#endif
\ No newline at end of file
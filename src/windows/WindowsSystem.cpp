@@ -7,6 +7,27 @@
 
 namespace nil {
 
+  // Registry keys for our devices. Raw Input devices go by their HANDLE,
+  // XInput devices by user index, and DirectInput devices by instance GUID.
+
+  inline DeviceRegistry::NativeHandle rawHandleKey( HANDLE handle )
+  {
+    return reinterpret_cast<uintptr_t>( handle );
+  }
+
+  inline DeviceRegistry::NativeHandle xinputHandleKey( int index )
+  {
+    return static_cast<DeviceRegistry::NativeHandle>( index ) + 1;
+  }
+
+  inline DeviceRegistry::NativeHandle instanceHandleKey( const GUID& guid )
+  {
+    // Folded down to 64 bits, so a hit still has to be checked
+    uint64_t halves[2];
+    memcpy( halves, &guid, sizeof( GUID ) );
+    return ( ( halves[0] ^ halves[1] ) | 1 );
+  }
+
   void System::Internals::store()
   {
     swapMouseButtons = ( GetSystemMetrics( SM_SWAPBUTTON ) != 0 );
@@ -60,7 +81,7 @@ namespace nil {
   }
 
   System::System( HINSTANCE instance, HWND window, const Cooperation coop, SystemListener* listener ): 
-  instance_( instance ), window_( window ), listener_( listener ), coop_( coop )
+  listener_( listener ), coop_( coop ), instance_( instance ), window_( window )
   {
     assert( listener_ );
   }
@@ -102,7 +123,7 @@ namespace nil {
     eventMonitor_ = make_unique<windows::EventMonitor>( instance_, coop_ );
 
     // Initialize our HID manager
-    hidManager_ = make_unique<windows::HIDManager>();
+    hidManager_ = make_unique<windows::HIDManager>( probeCachePath_ );
 
     // Register the HID manager and ourselves as PnP event listeners
     eventMonitor_->registerPnPListener( hidManager_.get() );
@@ -121,11 +142,6 @@ namespace nil {
     initializing_ = false;
   }
 
-  DeviceID System::getNextID()
-  {
-    return idPool_++;
-  }
-
   bool System::getDefaultMouseButtonSwapping()
   {
     return internals_.swapMouseButtons;
@@ -133,20 +149,44 @@ namespace nil {
 
   void System::onPnPPlug( const GUID& deviceClass, const wideString& devicePath )
   {
-    UNREFERENCED_PARAMETER( deviceClass );
-    UNREFERENCED_PARAMETER( devicePath );
+    // IDirectInput8::FindDevice does nothing, so DirectInput has to be
+    // enumerated all over; but only once the burst of interfaces is over,
+    // and only if one of them could be a DirectInput device at all
+    uint32_t targets = windows::RefreshScheduler::Target_All;
+    if ( deviceClass == g_HIDInterfaceGUID )
+    {
+      auto hidRecord = hidManager_->getRecordByPath( devicePath );
+      if ( hidRecord && hidRecord->isXInput() )
+        targets = ( windows::RefreshScheduler::Target_XInput | windows::RefreshScheduler::Target_SpecialHandling );
+      else if ( hidRecord && hidRecord->getUsagePage() == USBUsagePage_Desktop
+        && ( hidRecord->getUsage() == USBDesktopUsage_Mice || hidRecord->getUsage() == USBDesktopUsage_Keyboards ) )
+        targets = windows::RefreshScheduler::Target_None; // Raw Input announces these by itself
+      else
+        targets = windows::RefreshScheduler::Target_DirectInput;
+    }
 
-    // IDirectInput8::FindDevice does nothing, so just force a full refresh
-    refreshDevices();
+    refreshScheduler_.schedule( targets, currentTimestamp() );
   }
 
   void System::onPnPUnplug( const GUID& deviceClass, const wideString& devicePath )
   {
-    UNREFERENCED_PARAMETER( deviceClass );
-    UNREFERENCED_PARAMETER( devicePath );
+    // The HID record is gone already, so go by the path alone
+    uint32_t targets = windows::RefreshScheduler::Target_All;
+    if ( deviceClass == g_HIDInterfaceGUID )
+    {
+      if ( windows::HIDRecord::isXInputPath( devicePath ) )
+        targets = ( windows::RefreshScheduler::Target_XInput | windows::RefreshScheduler::Target_SpecialHandling );
+      else
+      {
+        // Nothing to lose if no DirectInput device is connected
+        targets = windows::RefreshScheduler::Target_None;
+        for ( auto device : devices_.view<DirectInputDevice>( Device::Handler_DirectInput ) )
+          if ( device->getStatus() == Device::Status_Connected )
+            targets = windows::RefreshScheduler::Target_DirectInput;
+      }
+    }
 
-    // IDirectInput8::FindDevice does nothing, so just force a full refresh
-    refreshDevices();
+    refreshScheduler_.schedule( targets, currentTimestamp() );
   }
 
   void System::onRawArrival( HANDLE handle )
@@ -161,181 +201,188 @@ namespace nil {
     GetRawInputDeviceInfoW( handle, RIDI_DEVICENAME, &rawPath[0], &pathLength );
     rawPath.resize( rawPath.length() - 1 );
 
-    auto hidRecord = hidManager_->getRecordByPath( rawPath );
+    auto pathKey = util::canonicalDevicePath( rawPath );
 
-    for ( auto& device : devices_ )
+    // A replugged device comes back as the same Device, under a new handle
+    if ( auto known = devices_.findByPath( Device::Handler_RawInput, pathKey ) )
     {
-      if ( device->getHandler() != Device::Handler_RawInput )
-        continue;
-
-      auto rawDevice = dynamic_pointer_cast<RawInputDevice>( device );
-
-      if ( util::compareDevicePaths( rawDevice->getRawPath(), rawPath ) )
-      {
-        deviceConnect( rawDevice );
-        return;
-      }
+      auto rawDevice = static_cast<RawInputDevice*>( known );
+      rawDevice->rawHandle_ = handle;
+      devices_.setHandle( rawDevice, rawHandleKey( handle ) );
+      deviceConnect( rawDevice->ptr() );
+      return;
     }
 
-    auto device = make_shared<RawInputDevice>( ptr(), getNextID(), handle, rawPath, hidRecord )->ptr();
+    auto hidRecord = hidManager_->getRecordByPathKey( pathKey );
+
+    auto device = make_shared<RawInputDevice>( this, getNextID(), handle, rawPath, hidRecord )->ptr();
 
     if ( isInitializing() )
       device->setStatus( Device::Status_Connected );
     else
       deviceConnect( device );
 
-    devices_.push_back( device );
+    devices_.add( device );
+    devices_.setHandle( device.get(), rawHandleKey( handle ) );
+    devices_.setPath( device.get(), pathKey );
+    if ( hidRecord )
+      devices_.setProduct( device.get(), LOWORD( hidRecord->getIdentifier() ), HIWORD( hidRecord->getIdentifier() ) );
   }
 
   void System::onRawMouseInput( HANDLE handle,
-  const RAWMOUSE& input, const bool sinked )
+  const RAWMOUSE& input, const bool sinked, const Timestamp timestamp )
   {
     UNREFERENCED_PARAMETER( sinked );
 
     if ( initializing_ || !handle )
       return;
 
-    auto it = mouseMap_.find( handle );
-    if ( it != mouseMap_.end() )
-      it->second->onRawInput( input );
+    if ( auto instance = mouseMap_.find( rawHandleKey( handle ) ) )
+      ( *instance )->onRawInput( input, timestamp );
   }
 
   void System::onRawKeyboardInput( HANDLE handle,
-  const RAWKEYBOARD& input, const bool sinked )
+  const RAWKEYBOARD& input, const bool sinked, const Timestamp timestamp )
   {
     UNREFERENCED_PARAMETER( sinked );
 
     if ( initializing_ || !handle )
       return;
 
-    auto it = keyboardMap_.find( handle );
-    if ( it != keyboardMap_.end() )
-      it->second->onRawInput( input );
+    if ( auto instance = keyboardMap_.find( rawHandleKey( handle ) ) )
+      ( *instance )->onRawInput( input, timestamp );
   }
 
-  void System::onRawHIDInput( HANDLE handle, const RAWHID& input, const bool sinked )
+  void System::onRawHIDInput( HANDLE handle, const RAWHID& input, const bool sinked, const Timestamp timestamp )
   {
     UNREFERENCED_PARAMETER( sinked );
 
     if ( initializing_ || !handle )
       return;
 
-    auto it = controllerMap_.find( handle );
-    if ( it != controllerMap_.end() )
-      it->second->onRawInput( input );
+    if ( auto instance = controllerMap_.find( rawHandleKey( handle ) ) )
+      ( *instance )->onRawInput( input, timestamp );
   }
 
   void System::onRawRemoval( HANDLE handle )
   {
-    for ( auto& device : devices_ )
-    {
-      if ( device->getHandler() != Device::Handler_RawInput )
-        continue;
-
-      auto rawDevice = dynamic_pointer_cast<RawInputDevice>( device );
-
-      if ( rawDevice->getRawHandle() == handle )
-      {
-        deviceDisconnect( rawDevice );
-        return;
-      }
-    }
+    if ( auto device = devices_.findByHandle( Device::Handler_RawInput, rawHandleKey( handle ) ) )
+      deviceDisconnect( device->ptr() );
   }
 
   void System::mapMouse( HANDLE handle, RawInputMouse* mouse )
   {
-    mouseMap_[handle] = mouse;
+    mouseMap_.insert( rawHandleKey( handle ), mouse );
   }
 
   void System::unmapMouse( HANDLE handle )
   {
-    mouseMap_.erase( handle );
+    mouseMap_.erase( rawHandleKey( handle ) );
   }
 
   void System::mapKeyboard( HANDLE handle, RawInputKeyboard* keyboard )
   {
-    keyboardMap_[handle] = keyboard;
+    keyboardMap_.insert( rawHandleKey( handle ), keyboard );
   }
 
   void System::unmapKeyboard( HANDLE handle )
   {
-    keyboardMap_.erase( handle );
+    keyboardMap_.erase( rawHandleKey( handle ) );
   }
 
   void System::mapController( HANDLE handle, RawInputController* controller )
   {
-    controllerMap_[handle] = controller;
+    controllerMap_.insert( rawHandleKey( handle ), controller );
   }
 
   void System::unmapController( HANDLE handle )
   {
-    controllerMap_.erase( handle );
+    controllerMap_.erase( rawHandleKey( handle ) );
   }
 
   void System::initializeDevices()
   {
-    xinputIds_.resize( XUSER_MAX_COUNT );
     for ( int i = 0; i < XUSER_MAX_COUNT; i++ )
     {
-      xinputIds_[i] = getNextID();
-      auto device = make_shared<XInputDevice>( ptr(), xinputIds_[i], i )->ptr();
-      devices_.push_back( device );
+      auto device = make_shared<XInputDevice>( this, getNextID(), i )->ptr();
+      devices_.add( device );
+      devices_.setHandle( device.get(), xinputHandleKey( i ) );
     }
   }
 
-  void System::refreshDevices()
+  void System::refreshDevices( uint32_t targets )
   {
     // Gather devices that will be ignored in the DI enumerator callback.
     // In practice this means XInput and specific direct HID controllers.
-    identifySpecialHandlingDevices();
+    if ( targets & windows::RefreshScheduler::Target_SpecialHandling )
+      identifySpecialHandlingDevices();
 
     // DirectInput
 
-    for ( auto& device : devices_ )
-      if ( device->getHandler() == Device::Handler_DirectInput )
-      {
-        device->saveStatus();
-        device->setStatus( Device::Status_Pending );
-      }
+    if ( targets & windows::RefreshScheduler::Target_DirectInput )
+      refreshDirectInputDevices();
+
+    // XInput
+
+    if ( targets & windows::RefreshScheduler::Target_XInput )
+      refreshXInputDevices();
+  }
+
+  void System::refreshDirectInputDevices()
+  {
+    for ( auto device : devices_.view<DirectInputDevice>( Device::Handler_DirectInput ) )
+    {
+      device->saveStatus();
+      device->setStatus( Device::Status_Pending );
+    }
 
     auto hr = dinput_->EnumDevices( DI8DEVCLASS_GAMECTRL,
       diDeviceEnumCallback, this, DIEDFL_ATTACHEDONLY );
     if ( FAILED( hr ) )
       NIL_EXCEPT_DINPUT( hr, "Could not enumerate DirectInput devices" );
 
-    for ( auto& device : devices_ )
-      if ( device->getHandler() == Device::Handler_DirectInput
-        && device->getSavedStatus() == Device::Status_Connected
+    for ( auto device : devices_.view<DirectInputDevice>( Device::Handler_DirectInput ) )
+      if ( device->getSavedStatus() == Device::Status_Connected
         && device->getStatus() == Device::Status_Pending )
-        deviceDisconnect( device );
-
-    // XInput
+        deviceDisconnect( device->ptr() );
+  }
 
+  void System::refreshXInputDevices()
+  {
     XINPUT_STATE state;
-    for ( auto& device : devices_ )
+    for ( auto xDevice : devices_.view<XInputDevice>( Device::Handler_XInput ) )
     {
-      if ( device->getHandler() == Device::Handler_XInput )
+      auto status = xinput_->funcs_.pfnXInputGetState( xDevice->getXInputID(), &state );
+      if ( status == ERROR_DEVICE_NOT_CONNECTED )
+      {
+        if ( xDevice->getStatus() == Device::Status_Connected )
+          deviceDisconnect( xDevice->ptr() );
+        else if ( xDevice->getStatus() == Device::Status_Pending )
+          xDevice->setStatus( Device::Status_Disconnected );
+      }
+      else if ( status == ERROR_SUCCESS )
       {
-        auto xDevice = dynamic_pointer_cast<XInputDevice>( device );
-        auto status = xinput_->funcs_.pfnXInputGetState( xDevice->getXInputID(), &state );
-        if ( status == ERROR_DEVICE_NOT_CONNECTED )
-        {
-          if ( xDevice->getStatus() == Device::Status_Connected )
-            deviceDisconnect( xDevice );
-          else if ( xDevice->getStatus() == Device::Status_Pending )
-            xDevice->setStatus( Device::Status_Disconnected );
-        }
-        else if ( status == ERROR_SUCCESS )
-        {
-          if ( xDevice->getStatus() == Device::Status_Disconnected )
-            deviceConnect( xDevice );
-          else if ( xDevice->getStatus() == Device::Status_Pending )
-            xDevice->setStatus( Device::Status_Connected );
-        }
-        else
-          NIL_EXCEPT( "XInputGetState failed" );
+        if ( xDevice->getStatus() == Device::Status_Disconnected )
+          deviceConnect( xDevice->ptr() );
+        else if ( xDevice->getStatus() == Device::Status_Pending )
+          xDevice->setStatus( Device::Status_Connected );
       }
+      else
+        NIL_EXCEPT( "XInputGetState failed" );
     }
+
+    if ( xinputSampler_ )
+      watchXInputDevices();
+  }
+
+  void System::watchXInputDevices()
+  {
+    uint32_t mask = 0;
+    for ( auto xDevice : devices_.view<XInputDevice>( Device::Handler_XInput ) )
+      if ( xDevice->getStatus() == Device::Status_Connected && !xDevice->isDisconnectFlagged() )
+        mask |= ( 1U << xDevice->getXInputID() );
+
+    xinputSampler_->watch( mask );
   }
 
   BOOL CALLBACK System::diDeviceEnumCallback( LPCDIDEVICEINSTANCEW instance,
@@ -347,123 +394,137 @@ namespace nil {
       if ( instance->guidProduct.Data1 == identifier )
         return DIENUM_CONTINUE;
 
-    for ( auto& device : system->devices_ )
-    {
-      if ( device->getHandler() != Device::Handler_DirectInput )
-        continue;
+    auto handleKey = instanceHandleKey( instance->guidInstance );
+    auto keyHolder = static_cast<DirectInputDevice*>(
+      system->devices_.findByHandle( Device::Handler_DirectInput, handleKey ) );
 
-      auto diDevice = static_cast<DirectInputDevice*>( device.get() );
+    // Should two instance GUIDs ever fold to the same key, the first one
+    // keeps it, and the other is only found the slow way
+    auto diDevice = keyHolder;
+    if ( keyHolder && keyHolder->getInstanceID() != instance->guidInstance )
+    {
+      diDevice = nullptr;
+      for ( auto candidate : system->devices_.view<DirectInputDevice>( Device::Handler_DirectInput ) )
+        if ( candidate->getInstanceID() == instance->guidInstance )
+          diDevice = candidate;
+    }
 
-      if ( diDevice->getInstanceID() == instance->guidInstance )
-      {
-        if ( device->getSavedStatus() == Device::Status_Disconnected )
-          system->deviceConnect( device );
-        else
-          device->setStatus( Device::Status_Connected );
+    if ( diDevice )
+    {
+      if ( diDevice->getSavedStatus() == Device::Status_Disconnected )
+        system->deviceConnect( diDevice->ptr() );
+      else
+        diDevice->setStatus( Device::Status_Connected );
 
-        return DIENUM_CONTINUE;
-      }
+      return DIENUM_CONTINUE;
     }
 
-    auto device = make_shared<DirectInputDevice>( system->ptr(), system->getNextID(), instance )->ptr();
+    auto device = make_shared<DirectInputDevice>( system, system->getNextID(), instance )->ptr();
 
     if ( system->isInitializing() )
       device->setStatus( Device::Status_Connected );
     else
       system->deviceConnect( device );
 
-    system->devices_.push_back( device );
+    system->devices_.add( device );
+    if ( !keyHolder )
+      system->devices_.setHandle( device.get(), handleKey );
+    system->devices_.setProduct( device.get(),
+      LOWORD( instance->guidProduct.Data1 ), HIWORD( instance->guidProduct.Data1 ) );
 
     return DIENUM_CONTINUE;
   }
 
-  void System::deviceConnect( DevicePtr device )
-  {
-    device->onConnect();
-    listener_->onDeviceConnected( device.get() );
-  }
-
-  void System::deviceDisconnect( DevicePtr device )
-  {
-    device->onDisconnect();
-    listener_->onDeviceDisconnected( device.get() );
-  }
-
-  void System::mouseEnabled( DevicePtr device, MousePtr instance )
+  void System::identifySpecialHandlingDevices()
   {
-    listener_->onMouseEnabled( device.get(), instance.get() );
+    specialHandlingDeviceIDs_.clear();
+    for ( auto& hidRecord : hidManager_->getRecords() )
+      if ( hidRecord->isXInput() )
+        specialHandlingDeviceIDs_.insert( hidRecord->getIdentifier() );
   }
 
-  void System::mouseDisabled( DevicePtr device, MousePtr instance )
+  void System::update()
   {
-    listener_->onMouseDisabled( device.get(), instance.get() );
-  }
+    // Run PnP & raw events if there are any
+    eventMonitor_->update();
 
-  void System::keyboardEnabled( DevicePtr device, KeyboardPtr instance )
-  {
-    listener_->onKeyboardEnabled( device.get(), instance.get() );
-  }
+    // Refresh devices once Plug-n-Play has settled down
+    auto refreshTargets = refreshScheduler_.collect( currentTimestamp() );
+    if ( refreshTargets != windows::RefreshScheduler::Target_None )
+      refreshDevices( refreshTargets );
 
-  void System::keyboardDisabled( DevicePtr device, KeyboardPtr instance )
-  {
-    listener_->onKeyboardDisabled( device.get(), instance.get() );
-  }
+    // Hand over what the input thread sampled since the last update
+    if ( xinputSampler_ )
+      dispatchXInputSamples();
 
-  void System::controllerEnabled( DevicePtr device, ControllerPtr instance )
-  {
-    listener_->onControllerEnabled( device.get(), instance.get() );
+    // Make sure that we disconnect failed devices,
+    // and update the rest
+    for ( auto& device : devices_ )
+      if ( device->isDisconnectFlagged() )
+        deviceDisconnect( device );
+      else
+        device->update();
   }
 
-  void System::controllerDisabled( DevicePtr device, ControllerPtr instance )
+  void System::dispatchXInputSamples()
   {
-    listener_->onControllerDisabled( device.get(), instance.get() );
-  }
+    auto& ring = xinputSampler_->getRing();
+    while ( auto packet = ring.front() )
+    {
+      auto index = static_cast<int>( packet->source );
+      auto error = packet->error;
+      auto timestamp = packet->timestamp;
+      XINPUT_STATE state = { 0 };
+      if ( !error )
+        memcpy( &state, packet->data(), sizeof( state ) );
+      ring.pop();
+
+      auto device = devices_.findByHandle( Device::Handler_XInput, xinputHandleKey( index ) );
+      if ( !device )
+        continue;
 
-  void System::identifySpecialHandlingDevices()
-  {
-    specialHandlingDeviceIDs_.clear();
-    for ( auto& hidRecord : hidManager_->getRecords() )
-      if ( hidRecord->isXInput() )
-        specialHandlingDeviceIDs_.insert( hidRecord->getIdentifier() );
-  }
+      auto controller = static_cast<XInputController*>( device->getInstance() );
+      if ( !controller || device->isDisconnectFlagged() )
+        continue;
 
-  DeviceList& System::getDevices()
-  {
-    return devices_;
+      if ( static_cast<DWORD>( error ) == ERROR_DEVICE_NOT_CONNECTED )
+      {
+        device->flagDisconnected();
+        watchXInputDevices();
+      }
+      else if ( error )
+        NIL_EXCEPT( "XInputGetState failed" );
+      else
+        controller->onSample( state, timestamp );
+    }
   }
 
-  bool System::isInitializing() const
+  void System::enableInputThread( size_t bufferSize )
   {
-    return initializing_;
-  }
+    if ( isInitializing() )
+      NIL_EXCEPT( "Cannot start the input thread before initialization" );
 
-  int System::getNextMouseIndex()
-  {
-    return ++mouseIdPool_;
+    // Raw input & DirectInput are buffered by the OS already; XInput is not
+    if ( !xinputSampler_ )
+    {
+      xinputSampler_ = make_unique<XInputSampler>( xinput_.get(), bufferSize );
+      watchXInputDevices();
+    }
   }
 
-  int System::getNextKeyboardIndex()
+  void System::disableInputThread()
   {
-    return ++keyboardIdPool_;
-  }
+    if ( !xinputSampler_ )
+      return;
 
-  int System::getNextControllerIndex()
-  {
-    return ++controllerIdPool_;
+    xinputSampler_->stop();
+    dispatchXInputSamples();
+    xinputSampler_.reset();
   }
 
-  void System::update()
+  bool System::isInputThreaded() const
   {
-    // Run PnP & raw events if there are any
-    eventMonitor_->update();
-
-    // Make sure that we disconnect failed devices,
-    // and update the rest
-    for ( auto& device : devices_ )
-      if ( device->isDisconnectFlagged() )
-        deviceDisconnect( device );
-      else
-        device->update();
+    return ( xinputSampler_ != nullptr );
   }
 
   XInput* System::getXInput()
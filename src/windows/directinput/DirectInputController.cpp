@@ -21,7 +21,7 @@ namespace nil {
 
   DirectInputController::DirectInputController( DirectInputDevicePtr device,
   const Cooperation coop ):
-  Controller( device->getSystem()->ptr(), device ), coop_( coop )
+  Controller( device->getSystem(), device.get() ), coop_( coop )
   {
     HRESULT hr = device->getSystem()->dinput_->CreateDevice(
       device->getInstanceID(), &diDevice_, nullptr );
@@ -182,6 +182,9 @@ namespace nil {
       if ( entries < cJoystickEvents )
         done = true;
 
+      // Changes are fired once per update, so they go by the poll time
+      timestamp_ = currentTimestamp();
+
       for ( unsigned long i = 0; i < entries; i++ )
       {
         if ( (size_t)buffers[i].dwOfs >= NIL_DIJ2OFS_POV( 0 )
@@ -49,9 +49,9 @@ namespace nil {
 
   // RawInputDevice class
 
-  RawInputDevice::RawInputDevice( SystemPtr system, DeviceID id, HANDLE rawHandle, wideString& rawPath,
+  RawInputDevice::RawInputDevice( System* system, DeviceID id, HANDLE rawHandle, wideString& rawPath,
   windows::HIDRecordPtr hid ): RawInputDeviceInfo( rawHandle ), Device( system, id, rawInfoResolveType() ),
-  rawHandle_( rawHandle ), rawPath_( rawPath ), hidRecord_( hid )
+  rawHandle_( rawHandle ), rawPath_( rawPath ), rawPathKey_( util::canonicalDevicePath( rawPath ) ), hidRecord_( hid )
   {
     SafeHandle deviceHandle( CreateFileW( rawPath_.c_str(), 0,
       FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr ) );
@@ -107,6 +107,11 @@ namespace nil {
     return rawPath_;
   }
 
+  const wideString& RawInputDevice::getRawPathKey() const
+  {
+    return rawPathKey_;
+  }
+
   windows::HIDRecordPtr RawInputDevice::getHIDReccord() const
   {
     return hidRecord_;
@@ -7,22 +7,18 @@
 
 namespace nil {
 
-# define NIL_RAW_TEST_MOUSE_BUTTON_DOWN(flag,x) if ( input.usButtonFlags & flag ) \
-  { \
-  state_.buttons[x].pushed = true; \
-  for ( auto& listener : listeners_ ) \
-    listener->onMouseButtonPressed( this, state_, x ); \
-}
+  // Raw Input button transition flags, by button
+  const USHORT c_rawButtonDownFlags[] = {
+    RI_MOUSE_BUTTON_1_DOWN, RI_MOUSE_BUTTON_2_DOWN, RI_MOUSE_BUTTON_3_DOWN,
+    RI_MOUSE_BUTTON_4_DOWN, RI_MOUSE_BUTTON_5_DOWN };
+  const USHORT c_rawButtonUpFlags[] = {
+    RI_MOUSE_BUTTON_1_UP, RI_MOUSE_BUTTON_2_UP, RI_MOUSE_BUTTON_3_UP,
+    RI_MOUSE_BUTTON_4_UP, RI_MOUSE_BUTTON_5_UP };
 
-# define NIL_RAW_TEST_MOUSE_BUTTON_UP(flag,x) if ( input.usButtonFlags & flag ) \
-  { \
-  state_.buttons[x].pushed = false; \
-  for ( auto& listener : listeners_ ) \
-    listener->onMouseButtonReleased( this, state_, x ); \
-}
+  const size_t c_rawMouseButtons = 5;
 
   RawInputMouse::RawInputMouse( RawInputDevicePtr rawDevice, const bool swapButtons ):
-  Mouse( rawDevice->getSystem()->ptr(), rawDevice, swapButtons )
+  Mouse( rawDevice->getSystem(), rawDevice.get(), swapButtons )
   {
     rawDevice->getSystem()->mapMouse( rawDevice->getRawHandle(), this );
 
@@ -39,78 +35,74 @@ namespace nil {
     hasHorizontalWheel_ = rawInfo->mouse.fHasHorizontalWheel ? true : false;
   }
 
-  void RawInputMouse::onRawInput( const RAWMOUSE& input )
+  void RawInputMouse::decodeButtons( const USHORT flags, uint32_t& pressed, uint32_t& released )
   {
-    // Reset everything but the buttons
-    state_.reset();
+    pressed = 0;
+    released = 0;
 
-    if ( input.usFlags & MOUSE_MOVE_ABSOLUTE )
-    {
-      Vector2i newPosition( input.lLastX, input.lLastY );
-      state_.movement.relative = newPosition - lastPosition_;
-      lastPosition_ = newPosition;
-    }
-    else
+    for ( size_t i = 0; i < c_rawMouseButtons; i++ )
     {
-      state_.movement.relative.x = input.lLastX;
-      state_.movement.relative.y = input.lLastY;
+      if ( flags & c_rawButtonDownFlags[i] )
+        pressed |= ( 1 << i );
+      if ( flags & c_rawButtonUpFlags[i] )
+        released |= ( 1 << i );
     }
+  }
 
-    if ( state_.movement.relative.x != 0
-      || state_.movement.relative.y != 0 )
-    {
-      for ( auto& listener : listeners_ )
-        listener->onMouseMoved( this, state_ );
-    }
+  void RawInputMouse::onRawInput( const RAWMOUSE& input, const Timestamp timestamp )
+  {
+    timestamp_ = timestamp;
 
-    if ( !state_.buttons.empty() )
-    {
-      int btn = ( swapButtons_ ? 1 : 0 );
-      NIL_RAW_TEST_MOUSE_BUTTON_DOWN( RI_MOUSE_BUTTON_1_DOWN, btn );
-      NIL_RAW_TEST_MOUSE_BUTTON_UP( RI_MOUSE_BUTTON_1_UP, btn );
-    }
+    // Reset everything but the buttons, unless summing up the whole update
+    if ( !coalescing_ )
+      state_.reset();
 
-    if ( state_.buttons.size() > 1 )
+    Vector2i movement( input.lLastX, input.lLastY );
+    if ( input.usFlags & MOUSE_MOVE_ABSOLUTE )
     {
-      int btn = ( swapButtons_ ? 0 : 1 );
-      NIL_RAW_TEST_MOUSE_BUTTON_DOWN( RI_MOUSE_BUTTON_2_DOWN, btn );
-      NIL_RAW_TEST_MOUSE_BUTTON_UP( RI_MOUSE_BUTTON_2_UP, btn );
+      Vector2i newPosition = movement;
+      movement = newPosition - lastPosition_;
+      lastPosition_ = newPosition;
     }
 
-    if ( state_.buttons.size() > 2 )
-    {
-      NIL_RAW_TEST_MOUSE_BUTTON_DOWN( RI_MOUSE_BUTTON_3_DOWN, 2 );
-      NIL_RAW_TEST_MOUSE_BUTTON_UP( RI_MOUSE_BUTTON_3_UP, 2 );
-    }
+    fireMovement( movement );
 
-    if ( state_.buttons.size() > 3 )
-    {
-      NIL_RAW_TEST_MOUSE_BUTTON_DOWN( RI_MOUSE_BUTTON_4_DOWN, 3 );
-      NIL_RAW_TEST_MOUSE_BUTTON_UP( RI_MOUSE_BUTTON_4_UP, 3 );
-    }
+    uint32_t pressed, released;
+    decodeButtons( input.usButtonFlags, pressed, released );
 
-    if ( state_.buttons.size() > 4 )
+    for ( size_t i = 0; ( pressed | released ) && i < c_rawMouseButtons; i++ )
     {
-      NIL_RAW_TEST_MOUSE_BUTTON_DOWN( RI_MOUSE_BUTTON_5_DOWN, 4 );
-      NIL_RAW_TEST_MOUSE_BUTTON_UP( RI_MOUSE_BUTTON_5_UP, 4 );
+      // Only the first two buttons get swapped
+      size_t button = ( swapButtons_ && i < 2 ? i ^ 1 : i );
+      if ( button >= state_.buttons.size() )
+        continue;
+
+      if ( pressed & ( 1 << i ) )
+        fireButton( button, true );
+
+      if ( released & ( 1 << i ) )
+        fireButton( button, false );
     }
 
+    int wheel = 0;
     if ( input.usButtonFlags & RI_MOUSE_WHEEL )
     {
-      state_.wheel.relative = (short)input.usButtonData;
-      for ( auto& listener : listeners_ )
-        listener->onMouseWheelMoved( this, state_ );
+      wheel = (short)input.usButtonData;
+      fireWheel( wheel );
     }
+
+    recordSample( movement, wheel );
   }
 
   void RawInputMouse::update()
   {
-    // Nothing to update, since we process events as they come
+    // Events are processed as they come; only coalesced motion is left
+    Mouse::update();
   }
 
   RawInputMouse::~RawInputMouse()
   {
-    auto rawDevice = dynamic_pointer_cast<RawInputDevice>( device_ );
+    auto rawDevice = static_cast<RawInputDevice*>( device_ );
     rawDevice->getSystem()->unmapMouse( rawDevice->getRawHandle() );
   }
 
@@ -23,7 +23,7 @@ namespace nil {
   };
 
   XInputController::XInputController( XInputDevicePtr device ):
-  Controller( device->getSystem()->ptr(), device )
+  Controller( device->getSystem(), device.get() )
   {
     type_ = c_xinputControllerTypeMap.at( device->getCapabilities().SubType );
 
@@ -64,7 +64,11 @@ namespace nil {
 
   void XInputController::update()
   {
-    auto xDevice = dynamic_pointer_cast<XInputDevice>( device_ );
+    // With an input thread, the System hands us its samples instead
+    if ( system_->isInputThreaded() )
+      return;
+
+    auto xDevice = static_cast<XInputDevice*>( device_ );
 
     DWORD ret = system_->getXInput()->funcs_.pfnXInputGetState( xDevice->getXInputID(), &xinputState_ );
     if ( ret == ERROR_DEVICE_NOT_CONNECTED )
@@ -81,6 +85,25 @@ namespace nil {
 
     lastPacket_ = xinputState_.dwPacketNumber;
 
+    // XInput has no event times, so the best we have is when we noticed
+    applyState( currentTimestamp() );
+  }
+
+  void XInputController::onSample( const XINPUT_STATE& state, const Timestamp timestamp )
+  {
+    if ( state.dwPacketNumber == lastPacket_ )
+      return;
+
+    xinputState_ = state;
+    lastPacket_ = state.dwPacketNumber;
+
+    applyState( timestamp );
+  }
+
+  void XInputController::applyState( const Timestamp timestamp )
+  {
+    timestamp_ = timestamp;
+
     ControllerState lastState = state_;
 
     // Buttons - skip 0x400 & 0x800 as they are undefined in the API
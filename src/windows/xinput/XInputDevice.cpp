@@ -24,7 +24,7 @@ namespace nil {
     { XINPUT_DEVSUBTYPE_ARCADE_PAD, "XBOX 360 Arcade Pad" }
   };
 
-  XInputDevice::XInputDevice( SystemPtr system, DeviceID id, int xinputID ):
+  XInputDevice::XInputDevice( System* system, DeviceID id, int xinputID ):
   Device( system, id, Device_Controller ), xinputId_( xinputID )
   {
     memset( &caps_, NULL, sizeof( XINPUT_CAPABILITIES ) );
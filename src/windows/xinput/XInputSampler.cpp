@@ -0,0 +1,96 @@
+#include "nilConfig.h"
+
+#include "nil.h"
+#include "nilUtil.h"
+#include "nilWindows.h"
+
+#ifdef NIL_PLATFORM_WINDOWS
+
+namespace nil {
+
+  // Time between two polls. How close the thread gets to this depends on
+  // the system timer resolution, which is left for the application to set.
+  const auto c_xinputPollInterval = std::chrono::milliseconds( 1 );
+
+  // Polling an empty user index is slow, so those only get a look this often.
+  // Actual arrivals are picked up by the System through PnP, and watched from then on.
+  const Timestamp c_xinputProbeInterval = 1000000000ULL;
+
+  XInputSampler::XInputSampler( XInput* xinput, size_t bufferSize ):
+  xinput_( xinput )
+  {
+    ring_ = make_unique<PacketRing>( bufferSize );
+    thread_ = std::thread( &XInputSampler::threadMain, this );
+  }
+
+  void XInputSampler::threadMain()
+  {
+    DWORD lastPackets[XUSER_MAX_COUNT] = { 0 };
+    bool connected[XUSER_MAX_COUNT] = { false };
+    Timestamp nextProbe = 0;
+
+    while ( !stopping_ )
+    {
+      auto now = currentTimestamp();
+      bool probe = ( now >= nextProbe );
+      if ( probe )
+        nextProbe = now + c_xinputProbeInterval;
+
+      auto watched = watched_.load( std::memory_order_relaxed );
+
+      for ( DWORD i = 0; i < XUSER_MAX_COUNT; i++ )
+      {
+        if ( !connected[i] && !( watched & ( 1U << i ) ) && !probe )
+          continue;
+
+        XINPUT_STATE state;
+        auto ret = xinput_->funcs_.pfnXInputGetState( i, &state );
+        if ( ret != ERROR_SUCCESS )
+        {
+          // Tell about losing a controller once; if there's no room, try again next time
+          if ( connected[i] && ring_->write( i, now, nullptr, 0, static_cast<int32_t>( ret ) ) )
+            connected[i] = false;
+          continue;
+        }
+
+        if ( connected[i] && state.dwPacketNumber == lastPackets[i] )
+          continue;
+
+        // A full ring means the game thread is far behind; once there's room,
+        // it gets the latest state rather than this one.
+        if ( ring_->write( i, now, &state, sizeof( state ) ) )
+        {
+          connected[i] = true;
+          lastPackets[i] = state.dwPacketNumber;
+        }
+      }
+
+      std::this_thread::sleep_for( c_xinputPollInterval );
+    }
+  }
+
+  PacketRing& XInputSampler::getRing()
+  {
+    return *ring_;
+  }
+
+  void XInputSampler::watch( uint32_t mask )
+  {
+    watched_.store( mask, std::memory_order_relaxed );
+  }
+
+  void XInputSampler::stop()
+  {
+    stopping_ = true;
+    if ( thread_.joinable() )
+      thread_.join();
+  }
+
+  XInputSampler::~XInputSampler()
+  {
+    stop();
+  }
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,728 @@
+#include "nil.h"
+#include "nilUtil.h"
+#include "nilHID.h"
+#include "nilKeys.h"
+#include <chrono>
+#include <new>
+
+// Microbenchmarks for the per-event hot paths.
+// Build in release mode; numbers from debug builds are meaningless.
+
+// How many events each benchmark runs
+const size_t c_benchEvents = 1000000;
+
+// Every allocation made by anyone, including the library
+size_t g_allocations = 0;
+
+void* operator new( size_t size )
+{
+  g_allocations++;
+  if ( auto ptr = malloc( size ? size : 1 ) )
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete( void* ptr ) noexcept
+{
+  free( ptr );
+}
+
+void operator delete( void* ptr, size_t size ) noexcept
+{
+  free( ptr );
+}
+
+// Results end up here, so that the compiler can't throw the work away
+volatile size_t g_sink = 0;
+
+// Run a benchmark and print its per-event cost
+template <typename Fn>
+void runBench( const char* name, Fn fn )
+{
+  // Warm up caches & branch predictors
+  for ( size_t i = 0; i < c_benchEvents / 10; i++ )
+    fn( i );
+
+  auto allocations = g_allocations;
+  auto start = std::chrono::steady_clock::now();
+
+  for ( size_t i = 0; i < c_benchEvents; i++ )
+    fn( i );
+
+  auto elapsed = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+  allocations = g_allocations - allocations;
+
+  printf( "%-40s %9.2f ns/event %9.3f allocs/event\n", name,
+    elapsed / (double)c_benchEvents, (double)allocations / (double)c_benchEvents );
+}
+
+// Counts everything, prints nothing
+class BenchListener:
+  public nil::SystemListener,
+  public nil::MouseListener,
+  public nil::KeyboardListener,
+  public nil::ControllerListener,
+  public nil::HotkeyListener {
+public:
+  size_t events = 0;
+  nil::MouseListener* extraMouseListener = nullptr; //!< Also added to mice enabled, if set
+  void onDeviceConnected( nil::Device* device ) override
+  {
+    device->enable();
+  }
+  void onDeviceDisconnected( nil::Device* device ) override
+  {
+  }
+  void onMouseEnabled( nil::Device* device, nil::Mouse* instance ) override
+  {
+    instance->addListener( this );
+    if ( extraMouseListener )
+      instance->addListener( extraMouseListener );
+  }
+  void onKeyboardEnabled( nil::Device* device, nil::Keyboard* instance ) override
+  {
+    instance->addListener( this );
+  }
+  void onControllerEnabled( nil::Device* device, nil::Controller* instance ) override
+  {
+    instance->addListener( this );
+  }
+  void onMouseDisabled( nil::Device* device, nil::Mouse* instance ) override
+  {
+  }
+  void onKeyboardDisabled( nil::Device* device, nil::Keyboard* instance ) override
+  {
+  }
+  void onControllerDisabled( nil::Device* device, nil::Controller* instance ) override
+  {
+  }
+  void onMouseMoved( nil::Mouse* mouse, const nil::MouseState& state ) override
+  {
+    events++;
+  }
+  void onMouseButtonPressed( nil::Mouse* mouse, const nil::MouseState& state, size_t button ) override
+  {
+    events++;
+  }
+  void onMouseButtonReleased( nil::Mouse* mouse, const nil::MouseState& state, size_t button ) override
+  {
+    events++;
+  }
+  void onMouseWheelMoved( nil::Mouse* mouse, const nil::MouseState& state ) override
+  {
+    events++;
+  }
+  void onKeyPressed( nil::Keyboard* keyboard, const nil::VirtualKeyCode keycode ) override
+  {
+    events++;
+  }
+  void onKeyRepeat( nil::Keyboard* keyboard, const nil::VirtualKeyCode keycode ) override
+  {
+    events++;
+  }
+  void onKeyReleased( nil::Keyboard* keyboard, const nil::VirtualKeyCode keycode ) override
+  {
+    events++;
+  }
+  void onControllerButtonPressed( nil::Controller* controller, const nil::ControllerState& state, size_t button ) override
+  {
+    events++;
+  }
+  void onControllerButtonReleased( nil::Controller* controller, const nil::ControllerState& state, size_t button ) override
+  {
+    events++;
+  }
+  void onControllerAxisMoved( nil::Controller* controller, const nil::ControllerState& state, size_t axis ) override
+  {
+    events++;
+  }
+  void onControllerSliderMoved( nil::Controller* controller, const nil::ControllerState& state, size_t slider ) override
+  {
+    events++;
+  }
+  void onControllerPOVMoved( nil::Controller* controller, const nil::ControllerState& state, size_t pov ) override
+  {
+    events++;
+  }
+  void onHotkey( nil::Keyboard* keyboard, nil::HotkeyID hotkey ) override
+  {
+    events++;
+  }
+};
+
+BenchListener g_benchListener;
+
+// Handles just mouse movement, without going through any interface
+struct BenchHandler
+{
+  size_t moved = 0;
+  void onMouseMoved( const nil::Event& event )
+  {
+    moved += event.movement.x;
+  }
+};
+
+void benchDispatch( nil::SystemPtr system )
+{
+  // Virtual devices go through the same listener & fireChanges paths as real ones
+  auto mouseDevice = system->createVirtualDevice( nil::Device::Device_Mouse, "Bench Mouse" );
+  auto keyboardDevice = system->createVirtualDevice( nil::Device::Device_Keyboard, "Bench Keyboard" );
+
+  nil::VirtualDevice::Layout layout;
+  layout.buttons = 16;
+  layout.axes = 6;
+  layout.sliders = 2;
+  layout.povs = 1;
+  auto controllerDevice = system->createVirtualDevice( nil::Device::Device_Controller, "Bench Controller", layout );
+
+  auto mouse = dynamic_cast<nil::VirtualMouse*>( mouseDevice->getInstance() );
+  auto keyboard = dynamic_cast<nil::VirtualKeyboard*>( keyboardDevice->getInstance() );
+  auto controller = dynamic_cast<nil::VirtualController*>( controllerDevice->getInstance() );
+  if ( !mouse || !keyboard || !controller )
+    NIL_EXCEPT( "Virtual devices were not enabled" );
+
+  runBench( "Controller::fireChanges, idle", [controller]( size_t i )
+  {
+    controller->commit();
+  } );
+
+  runBench( "Controller::fireChanges, button+axis", [controller]( size_t i )
+  {
+    controller->setButton( i % 16, ( i & 16 ) != 0 );
+    controller->setAxis( i % 6, (nil::Real)( i & 0xFF ) / 255.0f );
+    controller->commit();
+  } );
+
+  // Same changes with 32 more listeners, each wanting presses of a single button
+  nil::ListenerToken tokens[32];
+  for ( size_t i = 0; i < 32; i++ )
+    tokens[i] = controller->addListener( &g_benchListener,
+      nil::Subscription( nil::ControllerEvent_ButtonPressed, { i % 16 } ) );
+  runBench( "Controller::fireChanges, 32 subscribed", [controller]( size_t i )
+  {
+    controller->setButton( i % 16, ( i & 16 ) != 0 );
+    controller->setAxis( i % 6, (nil::Real)( i & 0xFF ) / 255.0f );
+    controller->commit();
+  } );
+  for ( auto token : tokens )
+    controller->removeListener( token );
+
+  const auto& state = controller->getState();
+  runBench( "ControllerState copy", [&state]( size_t i )
+  {
+    nil::ControllerState copy( state );
+    g_sink = g_sink + copy.buttons.size();
+  } );
+
+  runBench( "Mouse movement dispatch", [mouse]( size_t i )
+  {
+    mouse->injectMovement( nil::Vector2i( 1, (int)( i & 1 ) ) );
+  } );
+
+  runBench( "Mouse button dispatch", [mouse]( size_t i )
+  {
+    mouse->injectButton( i % 5, ( i & 8 ) == 0 );
+  } );
+
+  runBench( "Keyboard key dispatch", [keyboard]( size_t i )
+  {
+    if ( i & 1 )
+      keyboard->injectKeyReleased( (nil::VirtualKeyCode)( 'A' + ( i >> 1 ) % 26 ) );
+    else
+      keyboard->injectKeyPressed( (nil::VirtualKeyCode)( 'A' + ( i >> 1 ) % 26 ) );
+  } );
+
+  // Gameplay code polling its bindings, with a few keys held down
+  keyboard->injectKeyPressed( 'W' );
+  keyboard->injectKeyPressed( nil::Keyboard::Key_LeftShift );
+  const nil::KeyMask sprint { 'W', nil::Keyboard::Key_LeftShift };
+  runBench( "Keyboard state query", [keyboard, &sprint]( size_t i )
+  {
+    g_sink = g_sink + keyboard->isKeyDown( (nil::VirtualKeyCode)( 'A' + i % 26 ) )
+      + keyboard->areAllKeysDown( sprint );
+  } );
+  keyboard->injectKeyReleased( 'W' );
+  keyboard->injectKeyReleased( nil::Keyboard::Key_LeftShift );
+
+  // A tool's worth of shortcuts: every modifier combination of 32 keys
+  nil::HotkeyRegistry hotkeys( &g_benchListener );
+  for ( uint32_t modifiers = 0; modifiers < 16; modifiers++ )
+    for ( nil::VirtualKeyCode key = 0x70; key < 0x70 + 32; key++ )
+      hotkeys.add( nil::Chord { modifiers, key } );
+  auto hotkeyToken = keyboard->addListener( &hotkeys );
+  keyboard->injectKeyPressed( nil::Keyboard::Key_LeftControl );
+  runBench( "Hotkey matching, 512 hotkeys", [keyboard]( size_t i )
+  {
+    if ( i & 1 )
+      keyboard->injectKeyReleased( (nil::VirtualKeyCode)( 0x70 + ( i >> 1 ) % 32 ) );
+    else
+      keyboard->injectKeyPressed( (nil::VirtualKeyCode)( 0x70 + ( i >> 1 ) % 32 ) );
+  } );
+  keyboard->injectKeyReleased( nil::Keyboard::Key_LeftControl );
+  keyboard->removeListener( hotkeyToken );
+
+  // A UI listener coming & going every frame
+  runBench( "Listener add & remove", [mouse]( size_t i )
+  {
+    auto token = mouse->addListener( &g_benchListener );
+    mouse->removeListener( token );
+  } );
+
+  // Same movement, but queued as well & drained the way an engine would, once per frame
+  system->enableEventQueue();
+  nil::Event events[256];
+  runBench( "Mouse movement, queued & polled", [&]( size_t i )
+  {
+    mouse->injectMovement( nil::Vector2i( 1, (int)( i & 1 ) ) );
+    if ( ( i & 255 ) == 255 )
+      g_sink = g_sink + system->pollEvents( events );
+  } );
+
+  system->disableEventQueue();
+
+  // Same movement, handed straight to a statically known handler instead of any listener
+  BenchHandler handler;
+  mouse->removeListener( &g_benchListener );
+  system->setEventHandler( handler );
+  runBench( "Mouse movement, static dispatch", [mouse]( size_t i )
+  {
+    mouse->injectMovement( nil::Vector2i( 1, (int)( i & 1 ) ) );
+  } );
+  system->clearEventHandler();
+  mouse->addListener( &g_benchListener );
+  g_sink = g_sink + handler.moved;
+
+  // Same movement again, summed up & fired once per 256-packet frame
+  mouse->setCoalescing( true );
+  runBench( "Mouse movement, coalesced", [&]( size_t i )
+  {
+    mouse->injectMovement( nil::Vector2i( 1, (int)( i & 1 ) ) );
+    if ( ( i & 255 ) == 255 )
+      mouse->update();
+  } );
+  mouse->setCoalescing( false );
+
+  // Same movement again, each packet also kept as a sample over a 256-packet frame
+  mouse->setSampleHistory( 256 );
+  runBench( "Mouse movement, sampled", [&]( size_t i )
+  {
+    mouse->injectMovement( nil::Vector2i( 1, (int)( i & 1 ) ) );
+    if ( ( i & 255 ) == 255 )
+      mouse->publishSnapshot();
+  } );
+  g_sink = g_sink + mouse->getSamples().size();
+  mouse->setSampleHistory( 0 );
+}
+
+void benchParsers()
+{
+  nil::ControllerState state;
+  nil::hid::setupDualSense( state );
+
+  uint8_t usbReport[nil::hid::c_dualSenseUSBReportLength] = { 0x01 };
+  runBench( "hid::parseDualSense, USB", [&]( size_t i )
+  {
+    usbReport[1 + ( i % 6 )] = (uint8_t)i;
+    usbReport[8] = (uint8_t)( i & 0xF7 );
+    nil::hid::parseDualSense( usbReport, sizeof( usbReport ), nil::HIDConnection_USB, state );
+  } );
+
+  uint8_t bluetoothReport[nil::hid::c_dualSenseBluetoothReportLength] = { 0x31 };
+  runBench( "hid::parseDualSense, Bluetooth", [&]( size_t i )
+  {
+    bluetoothReport[2 + ( i % 6 )] = (uint8_t)i;
+    bluetoothReport[9] = (uint8_t)( i & 0xF7 );
+    nil::hid::parseDualSense( bluetoothReport, sizeof( bluetoothReport ), nil::HIDConnection_Bluetooth, state );
+  } );
+}
+
+void benchRouting()
+{
+  // Raw Input handles are small, evenly spaced values; 64 devices is a big rig
+  nil::HandleTable<size_t> table;
+  for ( size_t i = 0; i < 64; i++ )
+    table.insert( 0x10041 + i * 0x40, i );
+  runBench( "HandleTable::find, 64 devices", [&table]( size_t i )
+  {
+    g_sink = g_sink + *table.find( 0x10041 + ( i & 63 ) * 0x40 );
+  } );
+
+  // Same device as seen by Raw Input and by SetupAPI
+  const nil::wideString rawPath = LR"(\\?\HID#VID_054C&PID_0CE6&MI_03#8&2ef8f18e&0&0000#{4d1e55b2-f16f-11cf-88cb-001111000030})";
+  const nil::wideString setupPath = LR"(\\?\hid#vid_054c&pid_0ce6&mi_03#8&2ef8f18e&0&0000#{4D1E55B2-F16F-11CF-88CB-001111000030})";
+  runBench( "util::compareDevicePaths", [&]( size_t i )
+  {
+    g_sink = g_sink + nil::util::compareDevicePaths( rawPath, setupPath );
+  } );
+
+  // Finding a device's record on arrival, among 64 others keyed up front
+  std::unordered_map<nil::wideString, size_t> records;
+  for ( size_t i = 0; i < 64; i++ )
+  {
+    auto path = setupPath;
+    path[33] = L"0123456789abcdef"[i >> 4];
+    path[34] = L"0123456789abcdef"[i & 15];
+    records.emplace( nil::util::canonicalDevicePath( path ), i );
+  }
+  runBench( "Device path lookup, 64 records", [&]( size_t )
+  {
+    g_sink = g_sink + records.count( nil::util::canonicalDevicePath( rawPath ) );
+  } );
+}
+
+// Scan codes of the keys that sit in the same place on every layout,
+// and what the keyboard backends have always reported for them
+const struct {
+  unsigned int scanCode;
+  nil::keys::ScanCodePrefix prefix;
+  nil::VirtualKeyCode key;
+} c_positionalKeys[] = {
+  { 0x1D, nil::keys::Prefix_None, nil::Keyboard::Key_LeftControl },
+  { 0x1D, nil::keys::Prefix_E0, nil::Keyboard::Key_RightControl },
+  { 0x2A, nil::keys::Prefix_None, nil::Keyboard::Key_LeftShift },
+  { 0x36, nil::keys::Prefix_None, nil::Keyboard::Key_RightShift },
+  { 0x38, nil::keys::Prefix_None, nil::Keyboard::Key_LeftAlt },
+  { 0x38, nil::keys::Prefix_E0, nil::Keyboard::Key_RightAlt },
+  { 0x1C, nil::keys::Prefix_E0, nil::Keyboard::Key_NumpadEnter },
+  { 0x35, nil::keys::Prefix_E0, 0x6F }, // VK_DIVIDE
+  { 0x37, nil::keys::Prefix_None, 0x6A }, // VK_MULTIPLY
+  { 0x4A, nil::keys::Prefix_None, 0x6D }, // VK_SUBTRACT
+  { 0x4E, nil::keys::Prefix_None, 0x6B }, // VK_ADD
+  { 0x47, nil::keys::Prefix_None, 0x67 }, { 0x48, nil::keys::Prefix_None, 0x68 }, // VK_NUMPAD7-8
+  { 0x49, nil::keys::Prefix_None, 0x69 }, { 0x4B, nil::keys::Prefix_None, 0x64 }, // VK_NUMPAD9, 4
+  { 0x4C, nil::keys::Prefix_None, 0x65 }, { 0x4D, nil::keys::Prefix_None, 0x66 }, // VK_NUMPAD5-6
+  { 0x4F, nil::keys::Prefix_None, 0x61 }, { 0x50, nil::keys::Prefix_None, 0x62 }, // VK_NUMPAD1-2
+  { 0x51, nil::keys::Prefix_None, 0x63 }, { 0x52, nil::keys::Prefix_None, 0x60 }, // VK_NUMPAD3, 0
+  { 0x53, nil::keys::Prefix_None, 0x6E } // VK_DECIMAL
+};
+
+// Check that the scan code table reports exactly the above as positional keys
+bool checkScanCodes()
+{
+  bool passed = true;
+  for ( auto& entry : c_positionalKeys )
+  {
+    auto key = nil::keys::translateScanCode( entry.scanCode, entry.prefix );
+    if ( key != entry.key )
+    {
+      printf( "Scan code %d:%02X translates to %02X, not %02X\n", entry.prefix, entry.scanCode, key, entry.key );
+      passed = false;
+    }
+  }
+
+  for ( auto prefix : { nil::keys::Prefix_None, nil::keys::Prefix_E0, nil::keys::Prefix_E1 } )
+    for ( unsigned int scanCode = 0; scanCode < nil::keys::c_scanCodeCount; scanCode++ )
+    {
+      auto key = nil::keys::translateScanCode( scanCode, prefix );
+      if ( !nil::keys::isLayoutIndependent( key ) )
+        continue;
+      auto listed = std::find_if( std::begin( c_positionalKeys ), std::end( c_positionalKeys ), [&]( auto& entry ) {
+        return ( entry.scanCode == scanCode && entry.prefix == prefix ); } );
+      if ( listed == std::end( c_positionalKeys ) )
+      {
+        printf( "Scan code %d:%02X unexpectedly translates to positional key %02X\n", prefix, scanCode, key );
+        passed = false;
+      }
+    }
+
+  return passed;
+}
+
+#ifdef NIL_PLATFORM_WINDOWS
+
+// Check that modifiers come out sided even without a scan code to go by
+bool checkPlatform()
+{
+  const struct {
+    RAWKEYBOARD input;
+    nil::VirtualKeyCode key;
+  } modifiers[] = {
+    { { 0, 0, 0, VK_SHIFT, WM_KEYDOWN, 0 }, nil::Keyboard::Key_LeftShift },
+    { { 0x36, 0, 0, VK_SHIFT, WM_KEYDOWN, 0 }, nil::Keyboard::Key_RightShift },
+    { { 0, 0, 0, VK_CONTROL, WM_KEYDOWN, 0 }, nil::Keyboard::Key_LeftControl },
+    { { 0, RI_KEY_E0, 0, VK_CONTROL, WM_KEYDOWN, 0 }, nil::Keyboard::Key_RightControl },
+    { { 0, 0, 0, VK_MENU, WM_KEYDOWN, 0 }, nil::Keyboard::Key_LeftAlt },
+    { { 0, RI_KEY_E0, 0, VK_MENU, WM_KEYDOWN, 0 }, nil::Keyboard::Key_RightAlt }
+  };
+
+  bool passed = true;
+  for ( auto& modifier : modifiers )
+  {
+    auto key = nil::RawInputKeyboard::translateKey( modifier.input );
+    if ( key != modifier.key )
+    {
+      printf( "Virtual key %02X translates to %02X, not %02X\n", modifier.input.VKey, key, modifier.key );
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+void benchPlatform()
+{
+  // A mix of plain keys, and keys needing left/right or numpad fixups
+  RAWKEYBOARD keys[] = {
+    { 0x1E, 0, 0, 'A', WM_KEYDOWN, 0 },
+    { 0x2A, 0, 0, VK_SHIFT, WM_KEYDOWN, 0 },
+    { 0x1D, RI_KEY_E0, 0, VK_CONTROL, WM_KEYDOWN, 0 },
+    { 0x47, 0, 0, VK_HOME, WM_KEYDOWN, 0 },
+    { 0x47, RI_KEY_E0, 0, VK_HOME, WM_KEYDOWN, 0 },
+    { 0x1C, RI_KEY_E0, 0, VK_RETURN, WM_KEYDOWN, 0 },
+    { 0x45, 0, 0, VK_NUMLOCK, WM_KEYDOWN, 0 },
+    { 0x1D, RI_KEY_E1, 0, VK_PAUSE, WM_KEYDOWN, 0 }
+  };
+  runBench( "RawInputKeyboard::translateKey", [&keys]( size_t i )
+  {
+    g_sink = g_sink + nil::RawInputKeyboard::translateKey( keys[i % 8] );
+  } );
+
+  const USHORT buttonFlags[] = {
+    RI_MOUSE_BUTTON_1_DOWN, RI_MOUSE_BUTTON_1_UP,
+    RI_MOUSE_BUTTON_2_DOWN | RI_MOUSE_BUTTON_3_DOWN, RI_MOUSE_BUTTON_2_UP | RI_MOUSE_BUTTON_3_UP,
+    0, RI_MOUSE_WHEEL, RI_MOUSE_BUTTON_5_DOWN, RI_MOUSE_BUTTON_5_UP
+  };
+  runBench( "RawInputMouse::decodeButtons", [&buttonFlags]( size_t i )
+  {
+    uint32_t pressed, released;
+    nil::RawInputMouse::decodeButtons( buttonFlags[i % 8], pressed, released );
+    g_sink = g_sink + pressed + released;
+  } );
+}
+
+#elif defined( NIL_PLATFORM_LINUX )
+
+// clang-format off
+
+// Evdev key codes, and what EvdevKeyboard has always reported for them
+const std::map<unsigned int, nil::VirtualKeyCode> c_evdevKeys = {
+  { KEY_ESC, 0x1B }, // VK_ESCAPE
+  { KEY_1, '1' }, { KEY_2, '2' }, { KEY_3, '3' }, { KEY_4, '4' }, { KEY_5, '5' },
+  { KEY_6, '6' }, { KEY_7, '7' }, { KEY_8, '8' }, { KEY_9, '9' }, { KEY_0, '0' },
+  { KEY_MINUS, 0xBD }, // VK_OEM_MINUS
+  { KEY_EQUAL, 0xBB }, // VK_OEM_PLUS
+  { KEY_BACKSPACE, 0x08 }, // VK_BACK
+  { KEY_TAB, 0x09 }, // VK_TAB
+  { KEY_Q, 'Q' }, { KEY_W, 'W' }, { KEY_E, 'E' }, { KEY_R, 'R' }, { KEY_T, 'T' },
+  { KEY_Y, 'Y' }, { KEY_U, 'U' }, { KEY_I, 'I' }, { KEY_O, 'O' }, { KEY_P, 'P' },
+  { KEY_LEFTBRACE, 0xDB }, // VK_OEM_4
+  { KEY_RIGHTBRACE, 0xDD }, // VK_OEM_6
+  { KEY_ENTER, 0x0D }, // VK_RETURN
+  { KEY_LEFTCTRL, nil::Keyboard::Key_LeftControl },
+  { KEY_A, 'A' }, { KEY_S, 'S' }, { KEY_D, 'D' }, { KEY_F, 'F' }, { KEY_G, 'G' },
+  { KEY_H, 'H' }, { KEY_J, 'J' }, { KEY_K, 'K' }, { KEY_L, 'L' },
+  { KEY_SEMICOLON, 0xBA }, // VK_OEM_1
+  { KEY_APOSTROPHE, 0xDE }, // VK_OEM_7
+  { KEY_GRAVE, 0xC0 }, // VK_OEM_3
+  { KEY_LEFTSHIFT, nil::Keyboard::Key_LeftShift },
+  { KEY_BACKSLASH, 0xDC }, // VK_OEM_5
+  { KEY_Z, 'Z' }, { KEY_X, 'X' }, { KEY_C, 'C' }, { KEY_V, 'V' }, { KEY_B, 'B' },
+  { KEY_N, 'N' }, { KEY_M, 'M' },
+  { KEY_COMMA, 0xBC }, // VK_OEM_COMMA
+  { KEY_DOT, 0xBE }, // VK_OEM_PERIOD
+  { KEY_SLASH, 0xBF }, // VK_OEM_2
+  { KEY_RIGHTSHIFT, nil::Keyboard::Key_RightShift },
+  { KEY_KPASTERISK, 0x6A }, // VK_MULTIPLY
+  { KEY_LEFTALT, nil::Keyboard::Key_LeftAlt },
+  { KEY_SPACE, 0x20 }, // VK_SPACE
+  { KEY_CAPSLOCK, 0x14 }, // VK_CAPITAL
+  { KEY_F1, 0x70 }, { KEY_F2, 0x71 }, { KEY_F3, 0x72 }, { KEY_F4, 0x73 },
+  { KEY_F5, 0x74 }, { KEY_F6, 0x75 }, { KEY_F7, 0x76 }, { KEY_F8, 0x77 },
+  { KEY_F9, 0x78 }, { KEY_F10, 0x79 }, { KEY_F11, 0x7A }, { KEY_F12, 0x7B },
+  { KEY_F13, 0x7C }, { KEY_F14, 0x7D }, { KEY_F15, 0x7E }, { KEY_F16, 0x7F },
+  { KEY_F17, 0x80 }, { KEY_F18, 0x81 }, { KEY_F19, 0x82 }, { KEY_F20, 0x83 },
+  { KEY_F21, 0x84 }, { KEY_F22, 0x85 }, { KEY_F23, 0x86 }, { KEY_F24, 0x87 },
+  { KEY_NUMLOCK, 0x90 }, // VK_NUMLOCK
+  { KEY_SCROLLLOCK, 0x91 }, // VK_SCROLL
+  { KEY_KP7, 0x67 }, { KEY_KP8, 0x68 }, { KEY_KP9, 0x69 }, // VK_NUMPAD7-9
+  { KEY_KPMINUS, 0x6D }, // VK_SUBTRACT
+  { KEY_KP4, 0x64 }, { KEY_KP5, 0x65 }, { KEY_KP6, 0x66 }, // VK_NUMPAD4-6
+  { KEY_KPPLUS, 0x6B }, // VK_ADD
+  { KEY_KP1, 0x61 }, { KEY_KP2, 0x62 }, { KEY_KP3, 0x63 }, // VK_NUMPAD1-3
+  { KEY_KP0, 0x60 }, // VK_NUMPAD0
+  { KEY_KPDOT, 0x6E }, // VK_DECIMAL
+  { KEY_102ND, 0xE2 }, // VK_OEM_102
+  { KEY_KPENTER, nil::Keyboard::Key_NumpadEnter },
+  { KEY_RIGHTCTRL, nil::Keyboard::Key_RightControl },
+  { KEY_KPSLASH, 0x6F }, // VK_DIVIDE
+  { KEY_SYSRQ, 0x2C }, // VK_SNAPSHOT
+  { KEY_RIGHTALT, nil::Keyboard::Key_RightAlt },
+  { KEY_HOME, 0x24 }, // VK_HOME
+  { KEY_UP, 0x26 }, // VK_UP
+  { KEY_PAGEUP, 0x21 }, // VK_PRIOR
+  { KEY_LEFT, 0x25 }, // VK_LEFT
+  { KEY_RIGHT, 0x27 }, // VK_RIGHT
+  { KEY_END, 0x23 }, // VK_END
+  { KEY_DOWN, 0x28 }, // VK_DOWN
+  { KEY_PAGEDOWN, 0x22 }, // VK_NEXT
+  { KEY_INSERT, 0x2D }, // VK_INSERT
+  { KEY_DELETE, 0x2E }, // VK_DELETE
+  { KEY_PAUSE, 0x13 }, // VK_PAUSE
+  { KEY_LEFTMETA, 0x5B }, // VK_LWIN
+  { KEY_RIGHTMETA, 0x5C }, // VK_RWIN
+  { KEY_COMPOSE, 0x5D }, // VK_APPS
+  { KEY_SLEEP, 0x5F }, // VK_SLEEP
+  { KEY_MUTE, 0xAD }, // VK_VOLUME_MUTE
+  { KEY_VOLUMEDOWN, 0xAE }, // VK_VOLUME_DOWN
+  { KEY_VOLUMEUP, 0xAF }, // VK_VOLUME_UP
+  { KEY_NEXTSONG, 0xB0 }, // VK_MEDIA_NEXT_TRACK
+  { KEY_PREVIOUSSONG, 0xB1 }, // VK_MEDIA_PREV_TRACK
+  { KEY_STOPCD, 0xB2 }, // VK_MEDIA_STOP
+  { KEY_PLAYPAUSE, 0xB3 } // VK_MEDIA_PLAY_PAUSE
+};
+
+// clang-format on
+
+// Check that the evdev table reports exactly the above, and nothing for any other code
+bool checkPlatform()
+{
+  bool passed = true;
+  for ( unsigned int code = 0; code < KEY_CNT; code++ )
+  {
+    auto it = c_evdevKeys.find( code );
+    nil::VirtualKeyCode expected = nil::Keyboard::Key_Invalid;
+    if ( it != c_evdevKeys.end() )
+      expected = it->second;
+    auto key = nil::keys::translateEvdevCode( code );
+    if ( key != expected )
+    {
+      printf( "Evdev code %u translates to %02X, not %02X\n", code, key, expected );
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+void benchPlatform()
+{
+  const unsigned int keys[] = {
+    KEY_A, KEY_LEFTSHIFT, KEY_RIGHTCTRL, KEY_HOME, KEY_KP7, KEY_KPENTER, KEY_NUMLOCK, KEY_PAUSE
+  };
+  runBench( "EvdevKeyboard::translateKey", [&keys]( size_t i )
+  {
+    g_sink = g_sink + nil::EvdevKeyboard::translateKey( keys[i % 8] );
+  } );
+}
+
+#endif
+
+// Collects the movement of one mouse, by name
+class MovementCollector: public nil::MouseListener {
+public:
+  nil::utf8String name;
+  std::vector<nil::Vector2i> movements;
+  void onMouseMoved( nil::Mouse* mouse, const nil::MouseState& state ) override
+  {
+    if ( mouse->getDevice()->getName() == name )
+      movements.push_back( state.movement.relative );
+  }
+  void onMouseButtonPressed( nil::Mouse* mouse, const nil::MouseState& state, size_t button ) override
+  {
+  }
+  void onMouseButtonReleased( nil::Mouse* mouse, const nil::MouseState& state, size_t button ) override
+  {
+  }
+  void onMouseWheelMoved( nil::Mouse* mouse, const nil::MouseState& state ) override
+  {
+  }
+};
+
+// Check that a capture keeps every mouse delta, even when the mouse coalesces them
+bool checkCapture( nil::SystemPtr system )
+{
+  const char* path = "nil_capture_check.bin";
+
+  MovementCollector collector;
+  collector.name = "Capture Check Mouse";
+
+  auto device = system->createVirtualDevice( nil::Device::Device_Mouse, collector.name );
+  auto mouse = static_cast<nil::VirtualMouse*>( device->getInstance() );
+  mouse->setCoalescing( true );
+  mouse->addListener( &collector );
+
+  system->startCapture( path );
+  for ( int i = 1; i <= 5; i++ )
+    mouse->injectMovement( nil::Vector2i( i, -i ) );
+  system->update();
+  system->stopCapture();
+
+  mouse->removeListener( &collector );
+  bool passed = ( collector.movements.size() == 1 );
+  collector.movements.clear();
+
+  // The replayed mouse doesn't coalesce, so every delta comes out on its own
+  g_benchListener.extraMouseListener = &collector;
+  {
+    nil::CaptureReplay replay( system, path );
+    replay.runToEnd();
+  }
+  g_benchListener.extraMouseListener = nullptr;
+  std::remove( path );
+
+  passed = ( passed && collector.movements.size() == 5 );
+  for ( size_t i = 0; passed && i < collector.movements.size(); i++ )
+  {
+    auto expected = static_cast<int>( i + 1 );
+    passed = ( collector.movements[i] == nil::Vector2i( expected, -expected ) );
+  }
+
+  if ( !passed )
+    printf( "Capture lost mouse deltas to coalescing\n" );
+
+  return passed;
+}
+
+int runAll()
+{
+  // Benchmarks are no use if the tables they run on are wrong
+  bool checkedScanCodes = checkScanCodes();
+  if ( !checkPlatform() || !checkedScanCodes )
+    return EXIT_FAILURE;
+
+#ifdef NIL_PLATFORM_WINDOWS
+  auto system = nil::System::create(
+    GetModuleHandleW( nullptr ),
+    GetConsoleWindow(),
+    nil::Cooperation::Background,
+    &g_benchListener );
+#elif defined( NIL_PLATFORM_LINUX )
+  auto system = nil::System::create( nil::Cooperation::Background, &g_benchListener );
+#endif
+
+  system->initialize();
+
+  if ( !checkCapture( system ) )
+    return EXIT_FAILURE;
+
+  printf( "%zu events per benchmark\n\n", c_benchEvents );
+
+  benchDispatch( system );
+  benchParsers();
+  benchRouting();
+  benchPlatform();
+
+  printf( "\n%zu listener callbacks\n", g_benchListener.events );
+
+  return EXIT_SUCCESS;
+}
+
+#ifdef NIL_PLATFORM_WINDOWS
+int wmain( int argc, wchar_t* argv[], wchar_t* envp[] )
+#else
+int main( int argc, char* argv[] )
+#endif
+{
+  try
+  {
+    return runAll();
+  }
+  catch ( nil::Exception& e )
+  {
+    printf( "Exception: %s\n", e.getFullDescription().c_str() );
+    return EXIT_FAILURE;
+  }
+  catch ( std::exception& e )
+  {
+    printf( "Exception: %s\n", e.what() );
+    return EXIT_FAILURE;
+  }
+}
\ No newline at end of file